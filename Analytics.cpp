@@ -0,0 +1,329 @@
+#include "Analytics.hpp"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+// Rows handled per pass in the per-priority counts (fits in L1 as int8)
+const std::size_t PRIORITY_BLOCK = 4096;
+
+template <typename T>
+bool writeArray(const std::string& path, const T* data, std::size_t count) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    return static_cast<bool>(out);
+}
+
+/**
+ * Collects the column files of one export and the manifest rows describing them.
+ */
+class ExportWriter {
+public:
+    explicit ExportWriter(std::string directory) : dir(std::move(directory)), ok(true) {
+        manifest = "Table,Column,Encoding,Rows,Files\n";
+    }
+
+    template <typename T>
+    void array(const std::string& table, const std::string& column, const char* encoding,
+               const char* extension, const std::vector<T>& values) {
+        std::string file = table + "." + column + "." + extension;
+        ok = writeArray(dir + "/" + file, values.data(), values.size()) && ok;
+        row(table, column, encoding, values.size(), file);
+    }
+
+    void strings(const std::string& table, const std::string& column, const StringColumn& values) {
+        std::string offsets = table + "." + column + ".offsets.u64";
+        std::string bytes = table + "." + column + ".bytes";
+        ok = writeArray(dir + "/" + offsets, values.offsetArray().data(), values.offsetArray().size()) && ok;
+        ok = writeArray(dir + "/" + bytes, values.byteArray().data(), values.byteArray().size()) && ok;
+        row(table, column, "string", values.size(), offsets + ";" + bytes);
+    }
+
+    void dictionary(const std::string& table, const std::string& column, const DictionaryColumn& values) {
+        std::string codes = table + "." + column + ".codes.u32";
+        std::string dict = table + "." + column + ".dict.txt";
+        ok = writeArray(dir + "/" + codes, values.codes().data(), values.codes().size()) && ok;
+        std::ofstream out(dir + "/" + dict, std::ios::binary | std::ios::trunc);
+        for (const std::string& value : values.dictionary()) {
+            out << value << '\n';
+        }
+        ok = static_cast<bool>(out) && ok;
+        row(table, column, "dictionary", values.size(), codes + ";" + dict);
+    }
+
+    bool finish() {
+        std::ofstream out(dir + "/manifest.csv", std::ios::binary | std::ios::trunc);
+        out << manifest;
+        return static_cast<bool>(out) && ok;
+    }
+
+private:
+    void row(const std::string& table, const std::string& column, const char* encoding,
+             std::size_t rows, const std::string& files) {
+        manifest += table + "," + column + "," + encoding + "," + std::to_string(rows) + "," + files + "\n";
+    }
+
+    std::string dir;
+    std::string manifest;
+    bool ok;
+};
+
+template <typename Value>
+std::vector<std::pair<std::string, Value>> ranked(const std::vector<std::string>& names,
+                                                  const std::vector<Value>& totals) {
+    std::vector<std::pair<std::string, Value>> result;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        result.emplace_back(names[i], totals[i]);
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return result;
+}
+
+} // namespace
+
+std::unique_ptr<StoreSnapshot> captureStores(const PatientQueue& patients, const SupplyStack& supplies,
+                                             const EmergencyDepartmentSystem& emergencies) {
+    std::unique_ptr<StoreSnapshot> snapshot(new StoreSnapshot());
+    snapshot->takenAt = static_cast<std::int64_t>(std::time(nullptr));
+    patients.snapshotRecords(snapshot->patients, snapshot->strings);
+    supplies.snapshotRecords(snapshot->supplies, snapshot->strings);
+    emergencies.snapshotPending(snapshot->cases, snapshot->strings);
+    return snapshot;
+}
+
+void DictionaryColumn::add(const char* text, std::size_t length) {
+    key.assign(text, length);
+    auto found = lookup.find(key);
+    if (found == lookup.end()) {
+        found = lookup.emplace(key, static_cast<std::uint32_t>(values.size())).first;
+        values.push_back(key);
+    }
+    rows.push_back(found->second);
+}
+
+ColumnarSnapshot encodeSnapshot(const StoreSnapshot& snapshot) {
+    ColumnarSnapshot columns;
+    columns.takenAt = snapshot.takenAt;
+
+    PatientColumns& patients = columns.patients;
+    patients.conditionType.reserve(snapshot.patients.size());
+    patients.admittedAt.reserve(snapshot.patients.size());
+    for (const PatientRecord& record : snapshot.patients) {
+        patients.id.add(record.id.data(), record.id.size());
+        patients.name.add(record.name.data(), record.name.size());
+        patients.conditionType.add(record.conditionType.data(), record.conditionType.size());
+        patients.admittedAt.push_back(record.admittedAt);
+    }
+
+    SupplyColumns& supplies = columns.supplies;
+    supplies.type.reserve(snapshot.supplies.size());
+    supplies.quantity.reserve(snapshot.supplies.size());
+    for (const SupplyRecord& record : snapshot.supplies) {
+        supplies.type.add(record.type.data(), record.type.size());
+        supplies.batch.add(record.batch.data(), record.batch.size());
+        supplies.quantity.push_back(record.quantity);
+    }
+
+    TriageColumns& triage = columns.triage;
+    triage.emergencyType.reserve(snapshot.cases.size());
+    for (const CaseRecord& record : snapshot.cases) {
+        triage.id.push_back(record.id);
+        triage.patientName.add(record.patientName.data(), record.patientName.size());
+        triage.emergencyType.add(record.emergencyType.data(), record.emergencyType.size());
+        triage.priority.push_back(static_cast<std::int8_t>(record.priority));
+        triage.loggedAtNs.push_back(record.loggedAtNs);
+    }
+    return columns;
+}
+
+bool writeColumnarExport(const ColumnarSnapshot& snapshot, const std::string& directory) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    const std::string staging = directory + ".tmp";
+    const std::string previous = directory + ".old";
+    fs::remove_all(staging, error);
+    if (!fs::create_directories(staging, error)) {
+        return false;
+    }
+
+    ExportWriter writer(staging);
+    writer.array("snapshot", "taken_at", "int64", "i64", std::vector<std::int64_t>(1, snapshot.takenAt));
+    writer.strings("patients", "id", snapshot.patients.id);
+    writer.strings("patients", "name", snapshot.patients.name);
+    writer.dictionary("patients", "condition_type", snapshot.patients.conditionType);
+    writer.array("patients", "admitted_at", "int64", "i64", snapshot.patients.admittedAt);
+    writer.dictionary("supplies", "type", snapshot.supplies.type);
+    writer.strings("supplies", "batch", snapshot.supplies.batch);
+    writer.array("supplies", "quantity", "int32", "i32", snapshot.supplies.quantity);
+    writer.array("triage", "id", "int32", "i32", snapshot.triage.id);
+    writer.strings("triage", "patient_name", snapshot.triage.patientName);
+    writer.dictionary("triage", "emergency_type", snapshot.triage.emergencyType);
+    writer.array("triage", "priority", "int8", "i8", snapshot.triage.priority);
+    writer.array("triage", "logged_at_ns", "int64", "i64", snapshot.triage.loggedAtNs);
+    if (!writer.finish()) {
+        return false;
+    }
+
+    // Swap the finished export in; a crash in between leaves the .old or .tmp copy
+    fs::remove_all(previous, error);
+    if (fs::exists(directory)) {
+        fs::rename(directory, previous, error);
+        if (error) {
+            return false;
+        }
+    }
+    fs::rename(staging, directory, error);
+    if (error) {
+        return false;
+    }
+    fs::remove_all(previous, error);
+    return true;
+}
+
+// Four interleaved histograms, so consecutive equal codes do not serialize on one counter
+std::vector<std::uint64_t> countByCode(const DictionaryColumn& keys) {
+    const std::size_t width = keys.dictionary().size();
+    const std::uint32_t* codes = keys.codes().data();
+    const std::size_t count = keys.size();
+    std::vector<std::uint64_t> partial(width * 4, 0);
+    std::uint64_t* first = partial.data();
+    std::uint64_t* second = first + width;
+    std::uint64_t* third = second + width;
+    std::uint64_t* fourth = third + width;
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        ++first[codes[i]];
+        ++second[codes[i + 1]];
+        ++third[codes[i + 2]];
+        ++fourth[codes[i + 3]];
+    }
+    for (; i < count; ++i) {
+        ++first[codes[i]];
+    }
+
+    std::vector<std::uint64_t> totals(width);
+    for (std::size_t code = 0; code < width; ++code) {
+        totals[code] = first[code] + second[code] + third[code] + fourth[code];
+    }
+    return totals;
+}
+
+std::vector<std::int64_t> sumByCode(const DictionaryColumn& keys, const std::vector<std::int32_t>& values) {
+    const std::size_t width = keys.dictionary().size();
+    const std::uint32_t* codes = keys.codes().data();
+    const std::int32_t* amounts = values.data();
+    const std::size_t count = std::min(keys.size(), values.size());
+    std::vector<std::int64_t> partial(width * 2, 0);
+    std::int64_t* even = partial.data();
+    std::int64_t* odd = even + width;
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        even[codes[i]] += amounts[i];
+        odd[codes[i + 1]] += amounts[i + 1];
+    }
+    if (i < count) {
+        even[codes[i]] += amounts[i];
+    }
+
+    std::vector<std::int64_t> totals(width);
+    for (std::size_t code = 0; code < width; ++code) {
+        totals[code] = even[code] + odd[code];
+    }
+    return totals;
+}
+
+// One compare-and-add pass per level over each cache-sized block; the inner
+// loop has no stores and vectorizes to byte compares
+std::array<std::uint64_t, MAX_PRIORITY + 1> countByPriority(const std::vector<std::int8_t>& priorities) {
+    std::array<std::uint64_t, MAX_PRIORITY + 1> totals{};
+    const std::int8_t* values = priorities.data();
+    for (std::size_t start = 0; start < priorities.size(); start += PRIORITY_BLOCK) {
+        const std::size_t end = std::min(priorities.size(), start + PRIORITY_BLOCK);
+        for (int level = MIN_PRIORITY; level <= MAX_PRIORITY; ++level) {
+            const std::int8_t wanted = static_cast<std::int8_t>(level);
+            std::uint32_t matches = 0;
+            for (std::size_t i = start; i < end; ++i) {
+                matches += (values[i] == wanted);
+            }
+            totals[static_cast<std::size_t>(level)] += matches;
+        }
+    }
+    return totals;
+}
+
+AnalyticsReport summarize(const ColumnarSnapshot& snapshot) {
+    AnalyticsReport report;
+    report.patientsByCondition = ranked(snapshot.patients.conditionType.dictionary(),
+                                        countByCode(snapshot.patients.conditionType));
+    report.suppliesByType = ranked(snapshot.supplies.type.dictionary(),
+                                   sumByCode(snapshot.supplies.type, snapshot.supplies.quantity));
+    report.casesByPriority = countByPriority(snapshot.triage.priority);
+    return report;
+}
+
+AnalyticsSnapshotter::AnalyticsSnapshotter(std::string directory)
+    : dir(std::move(directory)), busy(false), stopping(false), exportOk(false),
+      worker(&AnalyticsSnapshotter::run, this) {}
+
+AnalyticsSnapshotter::~AnalyticsSnapshotter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void AnalyticsSnapshotter::submit(std::unique_ptr<StoreSnapshot> snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued = std::move(snapshot);
+    }
+    wake.notify_one();
+}
+
+void AnalyticsSnapshotter::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !queued && !busy; });
+}
+
+std::shared_ptr<const ColumnarSnapshot> AnalyticsSnapshotter::latest() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+bool AnalyticsSnapshotter::lastExportOk() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return exportOk;
+}
+
+void AnalyticsSnapshotter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return queued || stopping; });
+        if (!queued) {
+            return; // stopping, nothing left to export
+        }
+        std::unique_ptr<StoreSnapshot> snapshot = std::move(queued);
+        busy = true;
+        lock.unlock();
+
+        std::shared_ptr<const ColumnarSnapshot> encoded =
+            std::make_shared<const ColumnarSnapshot>(encodeSnapshot(*snapshot));
+        snapshot.reset();
+        bool ok = writeColumnarExport(*encoded, dir);
+
+        lock.lock();
+        current = encoded;
+        exportOk = ok;
+        busy = false;
+        idle.notify_all();
+    }
+}
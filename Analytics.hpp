@@ -0,0 +1,168 @@
+#ifndef ANALYTICS_HPP
+#define ANALYTICS_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CompactRecords.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+
+/**
+ * Columnar analytics over the role stores.
+ *
+ * A StoreSnapshot is a plain copy of the store records, taken on the thread
+ * that owns the stores. The AnalyticsSnapshotter turns it into a
+ * ColumnarSnapshot on a background thread (one contiguous array per field,
+ * low-cardinality strings dictionary-encoded) and writes the columns to
+ * disk. The aggregations below run over those arrays in tight loops the
+ * compiler can vectorize.
+ */
+
+// Default export directory
+const char* const ANALYTICS_DIR = "data/analytics";
+
+// Copy of the store contents, safe to hand to another thread
+struct StoreSnapshot {
+    std::int64_t takenAt = 0; // Unix seconds
+    std::vector<PatientRecord> patients;   // front first
+    std::vector<SupplyRecord> supplies;    // bottom first
+    std::vector<CaseRecord> cases;         // pending triage cases
+    StringArena strings;                   // spilled strings of all the above
+};
+
+std::unique_ptr<StoreSnapshot> captureStores(const PatientQueue& patients, const SupplyStack& supplies,
+                                             const EmergencyDepartmentSystem& emergencies);
+
+// Strings replaced by codes into a dictionary of distinct values (first seen = 0)
+class DictionaryColumn {
+public:
+    void add(const char* text, std::size_t length);
+
+    const std::vector<std::string>& dictionary() const { return values; }
+    const std::vector<std::uint32_t>& codes() const { return rows; }
+    std::size_t size() const { return rows.size(); }
+    void reserve(std::size_t count) { rows.reserve(count); }
+
+private:
+    std::vector<std::string> values;
+    std::vector<std::uint32_t> rows;
+    std::unordered_map<std::string, std::uint32_t> lookup;
+    std::string key; // reused lookup buffer
+};
+
+// Variable-length strings: row i is bytes[offsets[i], offsets[i + 1])
+class StringColumn {
+public:
+    StringColumn() : offsets(1, 0) {}
+
+    void add(const char* text, std::size_t length) {
+        bytes.append(text, length);
+        offsets.push_back(bytes.size());
+    }
+
+    const std::vector<std::uint64_t>& offsetArray() const { return offsets; }
+    const std::string& byteArray() const { return bytes; }
+    std::size_t size() const { return offsets.size() - 1; }
+
+private:
+    std::vector<std::uint64_t> offsets;
+    std::string bytes;
+};
+
+struct PatientColumns {
+    StringColumn id;
+    StringColumn name;
+    DictionaryColumn conditionType;
+    std::vector<std::int64_t> admittedAt;
+};
+
+struct SupplyColumns {
+    DictionaryColumn type;
+    StringColumn batch;
+    std::vector<std::int32_t> quantity;
+};
+
+struct TriageColumns {
+    std::vector<std::int32_t> id;
+    StringColumn patientName;
+    DictionaryColumn emergencyType;
+    std::vector<std::int8_t> priority;
+    std::vector<std::int64_t> loggedAtNs;
+};
+
+struct ColumnarSnapshot {
+    std::int64_t takenAt = 0;
+    PatientColumns patients;
+    SupplyColumns supplies;
+    TriageColumns triage;
+};
+
+ColumnarSnapshot encodeSnapshot(const StoreSnapshot& snapshot);
+
+/**
+ * Writes one file per column array into directory, plus manifest.csv
+ * ("Table,Column,Encoding,Rows,Files"). Arrays are raw host-order values;
+ * dictionaries are one value per line. The directory is replaced as a
+ * whole, so readers never see a half-written export.
+ */
+bool writeColumnarExport(const ColumnarSnapshot& snapshot, const std::string& directory);
+
+// Aggregations; each is one pass over contiguous arrays
+std::vector<std::uint64_t> countByCode(const DictionaryColumn& keys);
+std::vector<std::int64_t> sumByCode(const DictionaryColumn& keys, const std::vector<std::int32_t>& values);
+std::array<std::uint64_t, MAX_PRIORITY + 1> countByPriority(const std::vector<std::int8_t>& priorities);
+
+struct AnalyticsReport {
+    std::vector<std::pair<std::string, std::uint64_t>> patientsByCondition; // most first
+    std::vector<std::pair<std::string, std::int64_t>> suppliesByType;       // quantity, most first
+    std::array<std::uint64_t, MAX_PRIORITY + 1> casesByPriority{};          // [0] unused
+};
+
+AnalyticsReport summarize(const ColumnarSnapshot& snapshot);
+
+/**
+ * Encodes and exports snapshots on a worker thread. submit() only queues
+ * the snapshot; one submitted while another is still waiting replaces it,
+ * since only the newest state is worth exporting.
+ */
+class AnalyticsSnapshotter {
+public:
+    explicit AnalyticsSnapshotter(std::string directory);
+    ~AnalyticsSnapshotter(); // finishes the queued snapshot first
+
+    AnalyticsSnapshotter(const AnalyticsSnapshotter&) = delete;
+    AnalyticsSnapshotter& operator=(const AnalyticsSnapshotter&) = delete;
+
+    void submit(std::unique_ptr<StoreSnapshot> snapshot);
+    void waitIdle();
+
+    // Newest encoded snapshot (null before the first), and whether its export was written
+    std::shared_ptr<const ColumnarSnapshot> latest() const;
+    bool lastExportOk() const;
+
+private:
+    void run();
+
+    std::string dir;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::unique_ptr<StoreSnapshot> queued;
+    std::shared_ptr<const ColumnarSnapshot> current;
+    bool busy;
+    bool stopping;
+    bool exportOk;
+    std::thread worker;
+};
+
+#endif // ANALYTICS_HPP
@@ -0,0 +1,334 @@
+#include "BulkImport.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "HospitalState.hpp"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Parsed and normalized patient row waiting for insertion
+struct PatientRow {
+    std::string id;
+    std::string name;
+    std::string conditionType;
+    std::time_t admittedAt;
+};
+
+// Parsed and validated supply row waiting for insertion
+struct SupplyRow {
+    std::string type;
+    int quantity;
+    std::string batch;
+};
+
+// What the header row says about the rows below it
+struct ImportLayout {
+    bool leadingColumn = false; // a Position or Depth column comes before the data
+    bool topFirst = false;      // "Position": supply rows are listed top of the stack first
+};
+
+// Split a CSV line (no quoted commas) into reusable column strings.
+// Returns the number of columns found.
+std::size_t splitColumns(const std::string& line, std::vector<std::string>& columns) {
+    std::size_t count = 0;
+    std::size_t start = 0;
+    while (true) {
+        std::size_t comma = line.find(',', start);
+        std::size_t end = (comma == std::string::npos) ? line.size() : comma;
+        if (count == columns.size()) {
+            columns.emplace_back();
+        }
+        columns[count++].assign(line, start, end - start);
+        if (comma == std::string::npos) {
+            return count;
+        }
+        start = comma + 1;
+    }
+}
+
+// Parse a strictly positive integer that fills the whole field
+bool parsePositiveInt(const std::string& text, int& value) {
+    if (text.empty()) {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < 1 || parsed > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Parse an "Admitted At" cell: Unix seconds, or empty (or 0) when the store
+// did not know the time, which is kept as 0
+bool parseAdmittedAt(const std::string& text, std::time_t& value) {
+    if (text.empty()) {
+        value = 0;
+        return true;
+    }
+    errno = 0;
+    char* end = nullptr;
+    long long parsed = std::strtoll(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < 0) {
+        return false;
+    }
+    value = static_cast<std::time_t>(parsed);
+    return true;
+}
+
+/**
+ * Streams an import file through a bounded three-stage pipeline:
+ * parse (line -> row), validate/normalize (done by parseRow) and insert.
+ * At most IMPORT_BATCH_SIZE rows are held in memory at once, so the
+ * file size only affects run time, not peak memory. layout is filled in
+ * from the header before the first batch is inserted. insertBatch returns
+ * how many rows of the batch it kept.
+ */
+template <typename Row, typename ParseRow, typename InsertBatch>
+bool streamRows(const std::string& filename, ImportLayout& layout, ParseRow parseRow,
+                InsertBatch insertBatch, ImportReport& report) {
+    std::ifstream inFile(filename);
+    if (!inFile) {
+        std::cout << "Error: Unable to open import file '" << filename << "'.\n";
+        return false;
+    }
+
+    std::string line;
+    std::vector<std::string> columns;
+    std::vector<Row> batch(IMPORT_BATCH_SIZE);
+    std::size_t filled = 0;
+
+    // Header row decides whether a leading Position (or supply Depth) column must be skipped
+    if (std::getline(inFile, line)) {
+        std::size_t headerColumns = splitColumns(line, columns);
+        std::string leading = headerColumns > 0 ? PatientQueue::trim(columns[0]) : std::string();
+        layout.leadingColumn = leading == "Position" || leading == "Depth";
+        layout.topFirst = leading == "Position";
+    }
+
+    while (std::getline(inFile, line)) {
+        if (line.empty() || line.find_first_not_of(" \t\r\n") == std::string::npos) {
+            continue;
+        }
+        if (line.find("No patients in queue") != std::string::npos) {
+            continue;
+        }
+
+        ++report.recordsRead;
+        std::size_t count = splitColumns(line, columns);
+        std::size_t first = layout.leadingColumn ? 1 : 0;
+        if (count < first || !parseRow(columns, first, count, batch[filled])) {
+            ++report.recordsRejected;
+            continue;
+        }
+
+        if (++filled == batch.size()) {
+            report.recordsImported += insertBatch(batch, filled);
+            filled = 0;
+        }
+    }
+
+    if (filled > 0) {
+        report.recordsImported += insertBatch(batch, filled);
+    }
+    return true;
+}
+
+// Print the outcome of an import run
+void printReport(const std::string& what, const ImportReport& report) {
+    double rate = (report.seconds > 0.0) ? report.recordsImported / report.seconds : 0.0;
+    std::cout << "Imported " << report.recordsImported << " " << what
+              << " (" << report.recordsRejected << " rejected";
+    if (report.duplicateIds > 0) {
+        std::cout << " and " << report.duplicateIds << " duplicate IDs";
+    }
+    std::cout << " of " << report.recordsRead << " rows) in " << report.seconds << " s"
+              << " -> " << static_cast<long long>(rate) << " records/sec\n";
+    if (!report.committed) {
+        std::cout << "Warning: store file was not updated.\n";
+    }
+}
+
+} // namespace
+
+ImportKind detectImportKind(const std::string& filename) {
+    std::ifstream inFile(filename);
+    std::string header;
+    if (!inFile || !std::getline(inFile, header)) {
+        return ImportKind::Unknown;
+    }
+    if (header.find("Patient ID") != std::string::npos) {
+        return ImportKind::Patients;
+    }
+    if (header.find("Quantity") != std::string::npos) {
+        return ImportKind::Supplies;
+    }
+    return ImportKind::Unknown;
+}
+
+bool importPatients(const std::string& filename, PatientQueue& queue, ImportReport& report) {
+    auto started = std::chrono::steady_clock::now();
+
+    auto parseRow = [](const std::vector<std::string>& columns, std::size_t first,
+                       std::size_t count, PatientRow& row) {
+        if (count - first < 3) {
+            return false;
+        }
+        row.id = PatientQueue::trim(columns[first]);
+        row.name = PatientQueue::toUpperCase(PatientQueue::trim(columns[first + 1]));
+        row.conditionType = PatientQueue::toUpperCase(PatientQueue::trim(columns[first + 2]));
+        if (count - first < 4) {
+            row.admittedAt = std::time(nullptr); // no Admitted At column: admitted now
+        } else if (!parseAdmittedAt(PatientQueue::trim(columns[first + 3]), row.admittedAt)) {
+            return false;
+        }
+        return !row.id.empty() && !row.name.empty() && !row.conditionType.empty();
+    };
+    auto insertBatch = [&queue, &report](std::vector<PatientRow>& batch, std::size_t filled) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < filled; ++i) {
+            if (queue.appendPatient(batch[i].id, batch[i].name, batch[i].conditionType, batch[i].admittedAt)) {
+                ++kept;
+            } else {
+                ++report.duplicateIds;
+            }
+        }
+        return kept;
+    };
+
+    ImportLayout layout; // Position lists patients front first, the queue's own order
+    bool ok = streamRows<PatientRow>(filename, layout, parseRow, insertBatch, report);
+    if (ok && report.recordsImported > 0) {
+        // Single persistence commit for the whole import
+        report.committed = queue.saveToFile(queue.getFilename());
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return ok;
+}
+
+bool importSupplies(const std::string& filename, SupplyStack& stack,
+                    const std::string& storeFilename, ImportReport& report) {
+    auto started = std::chrono::steady_clock::now();
+
+    auto parseRow = [](const std::vector<std::string>& columns, std::size_t first,
+                       std::size_t count, SupplyRow& row) {
+        if (count - first < 3) {
+            return false;
+        }
+        row.type = PatientQueue::trim(columns[first]);
+        row.batch = PatientQueue::trim(columns[first + 2]);
+        return !row.type.empty() && !row.batch.empty() &&
+               parsePositiveInt(PatientQueue::trim(columns[first + 1]), row.quantity);
+    };
+    // Top-first files are pushed last row first, as SupplyStack::loadFromCsv
+    // does. To keep memory bounded their batches are staged to a scratch file
+    // next to the store and read back one batch at a time, last batch first.
+    // Bottom-first rows go straight on.
+    ImportLayout layout;
+    const std::string staging = storeFilename + ".import.tmp";
+    std::fstream staged;
+    std::vector<std::pair<std::streamoff, std::size_t>> stagedBatches; // offset and row count
+    bool stagingFailed = false;
+    auto insertBatch = [&](std::vector<SupplyRow>& batch, std::size_t filled) -> std::size_t {
+        if (!layout.topFirst) {
+            for (std::size_t i = 0; i < filled; ++i) {
+                stack.addSupplyStock(batch[i].type, batch[i].quantity, batch[i].batch);
+            }
+            return filled;
+        }
+        if (!staged.is_open() && !stagingFailed) {
+            staged.open(staging, std::ios::in | std::ios::out | std::ios::trunc);
+        }
+        std::streamoff offset = staged ? static_cast<std::streamoff>(staged.tellp()) : -1;
+        for (std::size_t i = 0; i < filled && staged; ++i) {
+            staged << batch[i].type << ',' << batch[i].quantity << ',' << batch[i].batch << '\n';
+        }
+        if (!staged) {
+            stagingFailed = true;
+            return 0;
+        }
+        stagedBatches.emplace_back(offset, filled);
+        return filled;
+    };
+
+    bool ok = streamRows<SupplyRow>(filename, layout, parseRow, insertBatch, report);
+    if (stagingFailed) {
+        std::cout << "Error: Unable to stage rows in '" << staging << "'.\n";
+        ok = false;
+    } else if (!stagedBatches.empty()) {
+        std::vector<SupplyRow> batch(IMPORT_BATCH_SIZE);
+        std::vector<std::string> columns;
+        std::string line;
+        for (std::size_t b = stagedBatches.size(); b > 0; --b) {
+            staged.seekg(stagedBatches[b - 1].first);
+            std::size_t count = stagedBatches[b - 1].second;
+            for (std::size_t i = 0; i < count; ++i) {
+                // Rows were validated before staging: three columns, positive quantity
+                if (!std::getline(staged, line) || splitColumns(line, columns) != 3) {
+                    std::cout << "Error: Unable to read staged rows from '" << staging << "'.\n";
+                    ok = false;
+                    break;
+                }
+                batch[i].type = columns[0];
+                batch[i].quantity = std::atoi(columns[1].c_str());
+                batch[i].batch = columns[2];
+            }
+            if (!ok) {
+                break;
+            }
+            for (std::size_t i = count; i > 0; --i) {
+                stack.addSupplyStock(batch[i - 1].type, batch[i - 1].quantity, batch[i - 1].batch);
+            }
+        }
+    }
+    if (staged.is_open()) {
+        staged.close();
+        std::remove(staging.c_str());
+    }
+    if (ok && report.recordsImported > 0) {
+        report.committed = stack.saveToCsv(storeFilename);
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return ok;
+}
+
+int runBulkImport(const std::string& filename) {
+    ImportReport report;
+    switch (detectImportKind(filename)) {
+        case ImportKind::Patients: {
+            PatientQueue& queue = HospitalState::instance().patients();
+            if (!importPatients(filename, queue, report)) {
+                return 1;
+            }
+            printReport("patients", report);
+            break;
+        }
+        case ImportKind::Supplies: {
+            SupplyStack& stack = HospitalState::instance().supplies();
+            if (!importSupplies(filename, stack, SUPPLIES_FILENAME, report)) {
+                return 1;
+            }
+            printReport("supplies", report);
+            break;
+        }
+        case ImportKind::Unknown:
+            std::cout << "Error: '" << filename << "' is not a patient or supply CSV "
+                      << "(expected a header with 'Patient ID' or 'Quantity').\n";
+            return 1;
+    }
+    if (report.recordsRead > 0 && report.recordsImported == 0) {
+        return 1; // every row was rejected or already there
+    }
+    return (report.recordsImported == 0 || report.committed) ? 0 : 1;
+}
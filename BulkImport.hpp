@@ -0,0 +1,52 @@
+#ifndef BULKIMPORT_HPP
+#define BULKIMPORT_HPP
+
+#include <cstddef>
+#include <string>
+
+class PatientQueue;
+class SupplyStack;
+
+// Number of parsed records buffered between the parse and insert stages
+const std::size_t IMPORT_BATCH_SIZE = 4096;
+
+// Kind of records found in an import file (decided from its header row)
+enum class ImportKind {
+    Unknown,
+    Patients,
+    Supplies
+};
+
+// Outcome of one bulk import run
+struct ImportReport {
+    std::size_t recordsRead = 0;      // data rows seen in the file
+    std::size_t recordsImported = 0;  // rows that passed validation
+    std::size_t recordsRejected = 0;  // malformed rows that were skipped
+    std::size_t duplicateIds = 0;     // rows skipped because their id was already there (not in recordsRejected)
+    double seconds = 0.0;             // wall time including the final save
+    bool committed = false;           // true once the store file was written
+};
+
+// Inspect the header row of an import file
+ImportKind detectImportKind(const std::string& filename);
+
+// Stream patient rows ("Patient ID,Name,Condition Type[,Admitted At]",
+// optionally prefixed with a Position column) into the queue, then save the
+// queue once. Admitted At (Unix seconds, empty when unknown) is kept; rows
+// without that column are admitted now. A row whose id is already waiting
+// (or came earlier in the file) is skipped.
+bool importPatients(const std::string& filename, PatientQueue& queue, ImportReport& report);
+
+// Stream supply rows ("Type,Quantity,Batch", optionally prefixed with a
+// Position or Depth column) onto the stack, then save once to storeFilename.
+// Rows go on in file order, except under a Position header: those files list
+// the top first, so their rows are staged in batches to storeFilename +
+// ".import.tmp" and pushed in reverse at the end.
+bool importSupplies(const std::string& filename, SupplyStack& stack,
+                    const std::string& storeFilename, ImportReport& report);
+
+// Command line entry for "--import <file>"; returns a process exit code
+// (non-zero also when rows were read but none was imported)
+int runBulkImport(const std::string& filename);
+
+#endif // BULKIMPORT_HPP
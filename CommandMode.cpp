@@ -0,0 +1,585 @@
+#include "CommandMode.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+#include "HospitalState.hpp"
+#include "Metrics.hpp"
+#include "Analytics.hpp"
+#include "TableRenderer.hpp"
+#include "SiteShards.hpp"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Changes remembered for UNDO; the stores keep fewer versions anyway
+const std::size_t CHANGE_LOG_LIMIT = 1 << 16;
+
+const char* const STORE_NAMES[] = {"PATIENTS", "SUPPLIES", "AMBULANCES"};
+
+// Commands about the whole session, never forwarded to a site
+bool isSessionCommand(const std::string& command) {
+    return command == "SITE" || command == "SITES" || command == "SAVE" ||
+           command == "METRICS" || command == "QUIT";
+}
+
+// p,s,c,a totals of a site summary
+std::string formatTotals(const SiteSummary& totals) {
+    return std::to_string(totals.patientsWaiting) + ',' + std::to_string(totals.supplyUnits) + ',' +
+           std::to_string(totals.pendingCases) + ',' + std::to_string(totals.ambulances);
+}
+
+// Comma separated labels of the items of a version inside the listing page;
+// returns the number of items
+template <typename Version, typename Label>
+std::size_t listItems(const Version& version, Label label, std::string& out) {
+    const ListingPage& page = listingPage();
+    std::size_t index = 0;
+    version.forEach([&](const auto& item) {
+        if (page.contains(index++)) {
+            out += out.empty() ? "" : ",";
+            out += label(item);
+        }
+    });
+    return index;
+}
+
+// Parse an integer in [minVal, maxVal] that fills the whole field
+bool parseIntInRange(const std::string& text, int minVal, int maxVal, int& value) {
+    if (text.empty()) {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < minVal || parsed > maxVal) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Split comma separated arguments into at most maxArgs trimmed strings.
+// Returns the number of arguments, or maxArgs + 1 when there are too many.
+int splitArgs(const std::string& text, std::string* args, int maxArgs) {
+    if (text.empty()) {
+        return 0;
+    }
+    int count = 0;
+    std::size_t start = 0;
+    while (true) {
+        if (count == maxArgs) {
+            return maxArgs + 1;
+        }
+        std::size_t comma = text.find(',', start);
+        std::size_t end = (comma == std::string::npos) ? text.size() : comma;
+        args[count++] = PatientQueue::trim(text.substr(start, end - start));
+        if (comma == std::string::npos) {
+            return count;
+        }
+        start = comma + 1;
+    }
+}
+
+} // namespace
+
+CommandProcessor::CommandProcessor(PatientQueue& patients, SupplyStack& supplies,
+                                   EmergencyDepartmentSystem& emergencies, AmbulanceScheduler& ambulances,
+                                   const std::string& suppliesFilename, const std::string& scheduleFilename)
+    : patients(patients), supplies(supplies), emergencies(emergencies), ambulances(ambulances),
+      suppliesFilename(suppliesFilename), scheduleFilename(scheduleFilename), snapshotter(nullptr),
+      sites(nullptr), session(&ownSession), patientsDirty(false), suppliesDirty(false), scheduleDirty(false), queuedSaves(false), executed(0) {}
+
+bool CommandProcessor::execute(const std::string& line, std::string& out) {
+    DeferredResponse deferred;
+    bool keepGoing = execute(line, out, deferred);
+    if (deferred) {
+        out += deferred();
+    }
+    return keepGoing;
+}
+
+bool CommandProcessor::execute(const std::string& line, std::string& out, DeferredResponse& deferred) {
+    std::size_t start = line.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos || line[start] == '#') {
+        return true;
+    }
+    std::size_t end = line.find_last_not_of(" \t\r\n");
+    ++executed;
+    SiteShard* target = session->selected;
+    if (line[start] == '@') {
+        std::size_t gap = line.find_first_of(" \t", start);
+        if (gap > end) {
+            gap = end + 1;
+        }
+        std::string site = PatientQueue::toUpperCase(line.substr(start + 1, gap - start - 1));
+        target = sites ? sites->open(site) : nullptr;
+        start = line.find_first_not_of(" \t", gap);
+        if (!target || start > end) {
+            out += !sites ? "ERR @ sites disabled\n"
+                 : !target ? "ERR @ invalid site " + site + "\n"
+                           : "ERR @" + site + " expects a command\n";
+            return true;
+        }
+    }
+    std::size_t space = line.find(' ', start);
+    if (space > end) {
+        space = end + 1;
+    }
+    std::string command = PatientQueue::toUpperCase(line.substr(start, space - start));
+    if (target && !isSessionCommand(command)) {
+        sites->execute(*target, line.substr(start, end - start + 1), out);
+        return true;
+    }
+    std::string rest = (space <= end) ? line.substr(space + 1, end - space) : std::string();
+    int argc = splitArgs(rest, args, 3);
+
+    if (command == "ADMIT") {
+        if (argc != 3 || args[0].empty() || args[1].empty() || args[2].empty()) {
+            out += "ERR ADMIT expects id,name,condition\n";
+            return true;
+        }
+        if (!patients.appendPatient(args[0], PatientQueue::toUpperCase(args[1]),
+                                    PatientQueue::toUpperCase(args[2]))) {
+            out += "ERR ADMIT ";
+            out += args[0];
+            out += " is already waiting\n";
+            return true;
+        }
+        changed(Store::Patients);
+        out += "OK ADMIT ";
+        out += args[0];
+        out += '\n';
+    } else if (command == "DISCHARGE") {
+        if (!patients.removeFront(args[0], args[1], args[2])) {
+            out += "ERR DISCHARGE queue is empty\n";
+            return true;
+        }
+        changed(Store::Patients);
+        out += "OK DISCHARGE ";
+        out += args[0];
+        out += ',';
+        out += args[1];
+        out += '\n';
+    } else if (command == "HISTORY") {
+        int days = 0;
+        DischargeArchive* archive = patients.dischargeArchive();
+        if (argc < 1 || argc > 2 || !parseIntInRange(args[0], 1, 36500, days)) {
+            out += "ERR HISTORY expects days[,condition]\n";
+            return true;
+        }
+        if (!archive) {
+            out += "ERR HISTORY no discharge archive\n";
+            return true;
+        }
+        std::int64_t now = static_cast<std::int64_t>(std::time(nullptr));
+        DischargeArchive::Query query = archive->prepareQuery(now - static_cast<std::int64_t>(days) * 24 * 3600,
+                                                              now + 1,
+                                                              argc == 2 ? PatientQueue::toUpperCase(args[1])
+                                                                        : std::string());
+        deferred = [query] {
+            std::size_t found = query.run([](const DischargeRecord&) {});
+            return "OK HISTORY " + std::to_string(found) + "\n";
+        };
+    } else if (command == "ADD") {
+        int quantity = 0;
+        if (argc != 3 || args[0].empty() || args[2].empty() ||
+            !parseIntInRange(args[1], 1, INT_MAX, quantity)) {
+            out += "ERR ADD expects type,quantity,batch\n";
+            return true;
+        }
+        supplies.addSupplyStock(args[0], quantity, args[2]);
+        changed(Store::Supplies);
+        out += "OK ADD\n";
+    } else if (command == "USE") {
+        if (supplies.isEmpty()) {
+            out += "ERR USE no supplies available\n";
+            return true;
+        }
+        Supply used = supplies.useLastAddedSupply();
+        changed(Store::Supplies);
+        out += "OK USE ";
+        out += used.type;
+        out += ',';
+        out += std::to_string(used.quantity);
+        out += ',';
+        out += used.batch;
+        out += '\n';
+    } else if (command == "LOG") {
+        int priority = 0;
+        if (argc != 3 || args[0].empty() || args[1].empty() ||
+            !parseIntInRange(args[2], 1, 5, priority)) {
+            out += "ERR LOG expects name,type,priority(1-5)\n";
+            return true;
+        }
+        int id = emergencies.enqueueCase(args[0], args[1], priority);
+        out += "OK LOG ";
+        out += std::to_string(id);
+        out += '\n';
+    } else if (command == "PROCESS") {
+        EmergencyCase c;
+        if (!emergencies.takeMostCriticalCase(c)) {
+            out += "ERR PROCESS no pending cases\n";
+            return true;
+        }
+        out += "OK PROCESS ";
+        out += std::to_string(c.id);
+        out += ',';
+        out += c.patientName;
+        out += ',';
+        out += c.emergencyType;
+        out += ',';
+        out += std::to_string(c.priority);
+        out += '\n';
+    } else if (command == "REGISTER") {
+        Ambulance ambulance{};
+        if (argc < 1 || argc > 2 || args[0].empty() ||
+            (argc == 2 && !parseIntInRange(args[1], 1, MAX_SHIFT_HOURS, ambulance.shiftHours))) {
+            out += "ERR REGISTER expects driver[,shift hours]\n";
+            return true;
+        }
+        ambulance.driverName = args[0];
+        std::string id = ambulances.registerAmbulance(ambulance);
+        if (id.empty()) {
+            out += "ERR REGISTER rotation is full\n";
+            return true;
+        }
+        changed(Store::Schedule);
+        out += "OK REGISTER ";
+        out += id;
+        out += '\n';
+    } else if (command == "ROTATE") {
+        if (!ambulances.rotateShift()) {
+            out += "ERR ROTATE no standby ambulance\n";
+            return true;
+        }
+        changed(Store::Schedule);
+        out += "OK ROTATE ";
+        out += ambulances.currentDutyId();
+        out += '\n';
+    } else if (command == "CREWS") {
+        int count = 0;
+        if (argc != 1 || !parseIntInRange(args[0], 1, MAX_AMBULANCES, count)) {
+            out += "ERR CREWS expects count(1-" + std::to_string(MAX_AMBULANCES) + ")\n";
+            return true;
+        }
+        ambulances.setCrewsPerShift(count);
+        changed(Store::Schedule);
+        out += "OK CREWS ";
+        out += args[0];
+        out += '\n';
+    } else if (command == "ONDUTY") {
+        std::time_t at;
+        if (argc != 1 || !AmbulanceScheduler::parseDateTime(args[0], at)) {
+            out += "ERR ONDUTY expects YYYY-MM-DD HH:MM\n";
+            return true;
+        }
+        const DutyTimeline& timeline = ambulances.dutyTimeline(at + 1);
+        std::vector<DutyInterval> onDuty;
+        timeline.onDutyAt(at, onDuty);
+        out += "OK ONDUTY ";
+        out += std::to_string(onDuty.size());
+        for (const DutyInterval& shift : onDuty) {
+            out += ' ';
+            out += timeline.unitId(shift.unit);
+        }
+        out += '\n';
+    } else if (command == "GAPS") {
+        int days = DEFAULT_TIMELINE_DAYS;
+        if (argc > 1 || (argc == 1 && !parseIntInRange(args[0], 1, 366, days))) {
+            out += "ERR GAPS expects [days(1-366)]\n";
+            return true;
+        }
+        std::time_t from = ambulances.dutyTimeline(0).origin();
+        std::time_t to = from + static_cast<std::time_t>(days) * 24 * SECONDS_PER_HOUR;
+        std::vector<CoverageGap> gaps;
+        ambulances.dutyTimeline(to).coverageGaps(from, to, gaps);
+        out += "OK GAPS ";
+        out += std::to_string(gaps.size());
+        for (const CoverageGap& gap : gaps) {
+            out += ' ';
+            out += AmbulanceScheduler::formatDateTime(gap.start);
+            out += '/';
+            out += AmbulanceScheduler::formatDateTime(gap.end);
+            out += '=';
+            out += std::to_string(gap.crews);
+        }
+        out += '\n';
+    } else if (command == "SNAPSHOT") {
+        if (!snapshotter) {
+            out += "ERR SNAPSHOT analytics disabled\n";
+            return true;
+        }
+        std::unique_ptr<StoreSnapshot> snapshot = captureStores(patients, supplies, emergencies);
+        out += "OK SNAPSHOT ";
+        out += std::to_string(snapshot->patients.size());
+        out += ',';
+        out += std::to_string(snapshot->supplies.size());
+        out += ',';
+        out += std::to_string(snapshot->cases.size());
+        out += '\n';
+        snapshotter->submit(std::move(snapshot));
+    } else if (command == "REPORT") {
+        if (!snapshotter) {
+            out += "ERR REPORT analytics disabled\n";
+            return true;
+        }
+        snapshotter->waitIdle();
+        std::shared_ptr<const ColumnarSnapshot> snapshot = snapshotter->latest();
+        if (!snapshot) {
+            out += "ERR REPORT no snapshot taken\n";
+            return true;
+        }
+        AnalyticsReport report = summarize(*snapshot);
+        out += "OK REPORT patients";
+        for (const auto& entry : report.patientsByCondition) {
+            out += ' ' + entry.first + '=' + std::to_string(entry.second);
+        }
+        out += " supplies";
+        for (const auto& entry : report.suppliesByType) {
+            out += ' ' + entry.first + '=' + std::to_string(entry.second);
+        }
+        out += " cases";
+        for (int level = MIN_PRIORITY; level <= MAX_PRIORITY; ++level) {
+            out += ' ' + std::to_string(level) + '=' + std::to_string(report.casesByPriority[level]);
+        }
+        out += '\n';
+    } else if (command == "UNDO" || command == "REDO") {
+        bool forward = (command == "REDO");
+        std::vector<Store>& from = forward ? session->undone : session->changes;
+        if (from.empty()) {
+            out += "ERR " + command + (forward ? " nothing to redo\n" : " nothing to undo\n");
+            return true;
+        }
+        Store store = from.back();
+        from.pop_back();
+        if (!step(store, forward)) {
+            // Older than the store keeps; nothing before it can be reached either
+            from.clear();
+            out += "ERR " + command + " history does not reach that far\n";
+            return true;
+        }
+        (forward ? session->changes : session->undone).push_back(store);
+        std::uint64_t version = (store == Store::Patients) ? patients.versions()->currentNumber()
+                              : (store == Store::Supplies) ? supplies.versions()->currentNumber()
+                              : ambulances.versions()->currentNumber();
+        out += "OK " + command + " ";
+        out += STORE_NAMES[static_cast<int>(store)];
+        out += ' ';
+        out += std::to_string(version);
+        out += '\n';
+    } else if (command == "ASOF") {
+        int version = 0;
+        std::string store = (argc >= 1) ? PatientQueue::toUpperCase(args[0]) : std::string();
+        if (argc != 2 || !parseIntInRange(args[1], 0, INT_MAX, version)) {
+            out += "ERR ASOF expects store,version\n";
+            return true;
+        }
+        std::string items;
+        std::size_t count = 0;
+        bool found = false;
+        const std::uint64_t number = static_cast<std::uint64_t>(version);
+        if (store == "PATIENTS" && patients.versions()) {
+            if (const PatientVersion* contents = patients.versions()->at(number)) {
+                count = listItems(*contents, [](const PatientRecord& record) { return record.id.str(); }, items);
+                found = true;
+            }
+        } else if (store == "SUPPLIES" && supplies.versions()) {
+            if (const SupplyVersion* contents = supplies.versions()->at(number)) {
+                count = listItems(*contents, [](const Supply& supply) { return supply.batch; }, items);
+                found = true;
+            }
+        } else if (store == "AMBULANCES" && ambulances.versions()) {
+            if (const RotationVersion* contents = ambulances.versions()->at(number)) {
+                count = listItems(*contents, [](const Ambulance& unit) { return unit.id; }, items);
+                found = true;
+            }
+        }
+        if (!found) {
+            out += "ERR ASOF no version " + args[1] + " of " + store + "\n";
+            return true;
+        }
+        out += "OK ASOF " + store + " " + args[1] + " " + std::to_string(count);
+        if (!items.empty()) {
+            out += ' ';
+            out += items;
+        }
+        out += '\n';
+    } else if (command == "SITE") {
+        if (!sites) {
+            out += "ERR SITE sites disabled\n";
+            return true;
+        }
+        if (argc > 1) {
+            out += "ERR SITE expects [id]\n";
+            return true;
+        }
+        if (argc == 0) {
+            session->selected = nullptr;
+            out += "OK SITE\n";
+            return true;
+        }
+        std::string site = PatientQueue::toUpperCase(args[0]);
+        SiteShard* shard = sites->open(site);
+        if (!shard) {
+            out += "ERR SITE invalid site " + site + "\n";
+            return true;
+        }
+        session->selected = shard;
+        out += "OK SITE " + site + "\n";
+    } else if (command == "SITES") {
+        if (!sites) {
+            out += "ERR SITES sites disabled\n";
+            return true;
+        }
+        std::vector<SiteSummary> summaries = sites->summarize();
+        SiteSummary total;
+        for (const SiteSummary& summary : summaries) {
+            total.patientsWaiting += summary.patientsWaiting;
+            total.supplyUnits += summary.supplyUnits;
+            total.pendingCases += summary.pendingCases;
+            total.ambulances += summary.ambulances;
+        }
+        out += "OK SITES " + std::to_string(summaries.size()) + " total=" + formatTotals(total);
+        for (const SiteSummary& summary : summaries) {
+            out += ' ' + summary.site + '=' + formatTotals(summary);
+        }
+        out += '\n';
+    } else if (command == "SAVE") {
+        if (queuedSaves) {
+            commitLater();
+            out += "OK SAVE\n";
+        } else {
+            out += commit() ? "OK SAVE\n" : "ERR SAVE write failed\n";
+        }
+    } else if (command == "METRICS") {
+        if (metricsOutput().empty()) {
+            out += "ERR METRICS no --metrics-out file configured\n";
+        } else if (dumpMetrics(metricsOutput())) {
+            out += "OK METRICS " + metricsOutput() + "\n";
+        } else {
+            out += "ERR METRICS write failed\n";
+        }
+    } else if (command == "QUIT") {
+        out += "OK QUIT\n";
+        return false;
+    } else {
+        out += "ERR unknown command ";
+        out += command;
+        out += '\n';
+    }
+    return true;
+}
+
+void CommandProcessor::changed(Store store) {
+    (store == Store::Patients ? patientsDirty : store == Store::Supplies ? suppliesDirty : scheduleDirty) = true;
+    session->undone.clear();
+    std::vector<Store>& changes = session->changes;
+    changes.push_back(store);
+    if (changes.size() > CHANGE_LOG_LIMIT) {
+        changes.erase(changes.begin(), changes.begin() + CHANGE_LOG_LIMIT / 2);
+    }
+}
+
+// Undoes (or redoes) one change of store and marks it for saving
+bool CommandProcessor::step(Store store, bool forward) {
+    bool ok;
+    if (store == Store::Patients) {
+        ok = forward ? patients.redo() : patients.undo();
+        patientsDirty = patientsDirty || ok;
+    } else if (store == Store::Supplies) {
+        ok = forward ? supplies.redo() : supplies.undo();
+        suppliesDirty = suppliesDirty || ok;
+    } else {
+        ok = forward ? ambulances.redo() : ambulances.undo();
+        scheduleDirty = scheduleDirty || ok;
+    }
+    return ok;
+}
+
+bool CommandProcessor::commit() {
+    bool ok = true;
+    if (patientsDirty) {
+        ok = patients.persist() && ok;
+        patientsDirty = false;
+    }
+    if (suppliesDirty) {
+        ok = supplies.saveToCsv(suppliesFilename) && ok;
+        suppliesDirty = false;
+    }
+    if (scheduleDirty) {
+        ok = ambulances.saveScheduleToCsv(scheduleFilename) && ok;
+        scheduleDirty = false;
+    }
+    if (sites) {
+        ok = sites->commitAll() && ok;
+    }
+    return ok;
+}
+
+void CommandProcessor::commitLater() {
+    if (patientsDirty) {
+        patients.persistLater();
+        patientsDirty = false;
+    }
+    if (suppliesDirty) {
+        supplies.saveToCsvLater(suppliesFilename); // changed rows here, full rewrites on the writer
+        suppliesDirty = false;
+    }
+    if (scheduleDirty) {
+        ambulances.saveScheduleLater(scheduleFilename);
+        scheduleDirty = false;
+    }
+    if (sites) {
+        sites->commitAllLater();
+    }
+}
+
+int runCommandMode(std::istream& in) {
+    std::ios::sync_with_stdio(false);
+
+    HospitalState& state = HospitalState::instance();
+    state.preloadInBackground();
+    CommandProcessor processor(state.patients(), state.supplies(), state.emergencies(),
+                               state.ambulances(), SUPPLIES_FILENAME, SCHEDULE_FILENAME);
+    processor.setSnapshotter(&state.analytics());
+    state.sites().openExisting(); // each site loads on its own thread
+    processor.setSiteRouter(&state.sites());
+
+    auto started = std::chrono::steady_clock::now();
+    std::string line;
+    std::string out;
+    out.reserve(COMMAND_OUTPUT_CHUNK * 2);
+
+    while (std::getline(in, line)) {
+        bool keepGoing = processor.execute(line, out);
+        if (out.size() >= COMMAND_OUTPUT_CHUNK) {
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+        if (!keepGoing) {
+            break;
+        }
+    }
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+
+    bool saved = processor.commit();
+    state.analytics().waitIdle(); // let a pending export finish before exit
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double rate = (seconds > 0.0) ? processor.commandsExecuted() / seconds : 0.0;
+    std::cerr << processor.commandsExecuted() << " commands in " << seconds << " s ("
+              << static_cast<long long>(rate) << " ops/sec)\n";
+    if (!saved) {
+        std::cerr << "Error: failed to persist one or more stores.\n";
+        return 1;
+    }
+    return 0;
+}
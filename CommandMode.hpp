@@ -0,0 +1,147 @@
+#ifndef COMMANDMODE_HPP
+#define COMMANDMODE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class PatientQueue;
+class SupplyStack;
+class EmergencyDepartmentSystem;
+class AmbulanceScheduler;
+class AnalyticsSnapshotter;
+class SiteRouter;
+class SiteShard;
+
+// Output is handed to the stream once this many bytes are buffered
+const std::size_t COMMAND_OUTPUT_CHUNK = 64 * 1024;
+
+// Rest of a command that reads files, safe to run on another thread; returns the response line
+typedef std::function<std::string()> DeferredResponse;
+
+enum class CommandStore : unsigned char { Patients, Supplies, Schedule };
+
+// What one client of a CommandProcessor has selected and changed: the SITE
+// it sends commands to, and the stores UNDO and REDO step through
+struct CommandSession {
+    SiteShard* selected = nullptr;        // null for the processor's own stores
+    std::vector<CommandStore> changes;    // store of each undoable change, oldest first
+    std::vector<CommandStore> undone;     // store of each undone change, for REDO
+};
+
+/**
+ * Line-oriented command protocol over the four role stores.
+ *
+ * One command per line, arguments comma separated:
+ *   ADMIT id,name,condition     DISCHARGE
+ *   HISTORY days[,condition]    (discharges archived in the last days)
+ *   ADD type,quantity,batch     USE
+ *   LOG name,type,priority      PROCESS
+ *   REGISTER driver[,hours]     ROTATE
+ *   CREWS count (on duty at once)
+ *   ONDUTY YYYY-MM-DD HH:MM     GAPS [days] (coverage gaps from the current shift)
+ *   SNAPSHOT (export columns in the background)
+ *   REPORT (aggregates of the newest snapshot)
+ *   UNDO                        REDO (the last patient, supply or ambulance change;
+ *                               the reply names the store and its version now)
+ *   ASOF store,version (PATIENTS, SUPPLIES or AMBULANCES contents at that version)
+ *   SITE [id] (send later commands to that site's stores; no id: back to these)
+ *   SITES (waiting patients, supply units, pending cases and ambulances per site)
+ *   SAVE                        METRICS (write the --metrics-out file)
+ *   QUIT
+ * A line "@id command" runs one command at site id. SITE, SITES, SAVE,
+ * METRICS and QUIT always act on the whole session, never on one site.
+ * Blank lines and lines starting with '#' are ignored.
+ * Every command produces exactly one response line starting with OK or ERR.
+ *
+ * Commands only touch memory; stores (those of the sites included) are
+ * written by SAVE or commit().
+ */
+class CommandProcessor {
+public:
+    CommandProcessor(PatientQueue& patients, SupplyStack& supplies,
+                     EmergencyDepartmentSystem& emergencies, AmbulanceScheduler& ambulances,
+                     const std::string& suppliesFilename, const std::string& scheduleFilename);
+
+    /**
+     * Executes one command line and appends its response line to out.
+     * Returns false once QUIT has been received.
+     */
+    bool execute(const std::string& line, std::string& out);
+
+    /**
+     * Same, except that HISTORY only takes what it needs from the stores and
+     * leaves the file reads in deferred, appending nothing. The caller runs
+     * deferred (on any thread) and sends its response before the next one.
+     */
+    bool execute(const std::string& line, std::string& out, DeferredResponse& deferred);
+
+    /**
+     * Writes every store modified since the last commit. Returns false on I/O failure.
+     */
+    bool commit();
+
+    // Enables SNAPSHOT and REPORT; null disables them
+    void setSnapshotter(AnalyticsSnapshotter* exporter) { snapshotter = exporter; }
+
+    /**
+     * When on, SAVE only copies the modified stores and leaves the writes
+     * to their background writers (see HospitalState::enableBackgroundWrites),
+     * so it answers without waiting on disk and cannot report write errors.
+     * Supplies still write a few changed rows in place.
+     * commit() always writes before returning.
+     */
+    void setQueuedSaves(bool queued) { queuedSaves = queued; }
+
+    // Enables SITE, SITES and @id; null disables them
+    void setSiteRouter(SiteRouter* router) { sites = router; session->selected = nullptr; }
+
+    /**
+     * Session the following commands run in, for a processor shared by
+     * several clients (null: the processor's own). The stores, what is
+     * waiting to be saved and the command count stay shared: UNDO picks the
+     * store this client changed last, but steps back that store's newest
+     * change, whoever made it.
+     */
+    void setSession(CommandSession* active) { session = active ? active : &ownSession; }
+
+    CommandProcessor(const CommandProcessor&) = delete;
+    CommandProcessor& operator=(const CommandProcessor&) = delete;
+
+    std::size_t commandsExecuted() const { return executed; }
+
+private:
+    typedef CommandStore Store;
+
+    void changed(Store store); // marks it dirty and the next UNDO target
+    bool step(Store store, bool forward);
+    void commitLater(); // commit() through the stores' background writers
+
+    PatientQueue& patients;
+    SupplyStack& supplies;
+    EmergencyDepartmentSystem& emergencies;
+    AmbulanceScheduler& ambulances;
+    std::string suppliesFilename;
+    std::string scheduleFilename;
+    AnalyticsSnapshotter* snapshotter;
+    SiteRouter* sites;
+    CommandSession ownSession;
+    CommandSession* session; // ownSession unless setSession() picked another
+
+    bool patientsDirty;
+    bool suppliesDirty;
+    bool scheduleDirty;
+    bool queuedSaves;
+    std::size_t executed;
+    std::string args[3]; // reused argument buffers
+};
+
+/**
+ * Runs commands from in until end of input or QUIT, buffering responses
+ * and persisting the stores once at the end. Returns a process exit code.
+ */
+int runCommandMode(std::istream& in);
+
+#endif // COMMANDMODE_HPP
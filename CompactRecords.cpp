@@ -0,0 +1,45 @@
+#include "CompactRecords.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+const std::size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+} // namespace
+
+const char* StringArena::store(const char* text, std::size_t length) {
+    if (length > available) {
+        // Oversized strings get a chunk of their own
+        std::size_t size = std::max(length, ARENA_CHUNK_SIZE);
+        chunks.emplace_back(new char[size]);
+        used = 0;
+        available = size;
+    }
+    char* destination = chunks.back().get() + used;
+    std::memcpy(destination, text, length);
+    used += length;
+    available -= length;
+    stored += length;
+    live += length;
+    return destination;
+}
+
+bool StringArena::wantsCompaction() const {
+    std::size_t dead = stored - live;
+    return dead > ARENA_CHUNK_SIZE && dead > live;
+}
+
+void StringArena::clear() {
+    chunks.clear();
+    used = available = 0;
+    stored = live = 0;
+}
+
+void StringArena::swap(StringArena& other) {
+    std::swap(chunks, other.chunks);
+    std::swap(used, other.used);
+    std::swap(available, other.available);
+    std::swap(stored, other.stored);
+    std::swap(live, other.live);
+}
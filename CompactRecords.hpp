@@ -0,0 +1,249 @@
+#ifndef COMPACTRECORDS_HPP
+#define COMPACTRECORDS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Building blocks for the fixed-width records the stores keep in memory.
+ *
+ * Hot records (PatientRecord, SupplyRecord, CaseRecord) hold their text in
+ * InlineString fields: short values live inside the record, and the rare
+ * long one spills into a StringArena owned by the store. Records are
+ * trivially copyable, so containers move them with memcpy and the binary
+ * persistence path writes them to disk as they are.
+ */
+
+/**
+ * Bump allocator for spilled strings. Strings are never freed one by one;
+ * the owner reports dropped strings with release() and rebuilds the arena
+ * (see InlineString::moveTo) once wantsCompaction() says most of it is dead.
+ */
+class StringArena {
+public:
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // Copies length bytes and returns their stable address
+    const char* store(const char* text, std::size_t length);
+
+    void release(std::size_t length) { live -= length; }
+    bool wantsCompaction() const;
+    void clear();
+    void swap(StringArena& other);
+
+    std::size_t liveBytes() const { return live; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::size_t used = 0;      // bytes taken from the last chunk
+    std::size_t available = 0; // bytes left in the last chunk
+    std::size_t stored = 0;    // bytes handed out since the last clear
+    std::size_t live = 0;      // of which still referenced
+};
+
+/**
+ * Fixed-capacity string field of N bytes. Up to N - 1 characters are kept
+ * inline with the length in the last byte; longer values keep a pointer and
+ * length into a StringArena instead. Trivially copyable; default-constructed
+ * (value-initialized) fields are empty.
+ */
+template <std::size_t N>
+struct InlineString {
+    static_assert(N >= 16 && N <= 128, "InlineString needs room for a pointer and a length");
+
+    static constexpr std::size_t INLINE_CAPACITY = N - 1;
+
+    void assign(const char* text, std::size_t length, StringArena& arena) {
+        if (length <= INLINE_CAPACITY) {
+            std::memcpy(bytes, text, length);
+            bytes[N - 1] = static_cast<unsigned char>(length);
+            return;
+        }
+        setSpill(arena.store(text, length), length);
+    }
+
+    void assign(const std::string& text, StringArena& arena) { assign(text.data(), text.size(), arena); }
+
+    bool spilled() const { return bytes[N - 1] == SPILLED; }
+
+    std::size_t size() const {
+        if (!spilled()) return bytes[N - 1];
+        std::uint32_t length;
+        std::memcpy(&length, bytes + sizeof(const char*), sizeof(length));
+        return length;
+    }
+
+    const char* data() const {
+        if (!spilled()) return reinterpret_cast<const char*>(bytes);
+        const char* pointer;
+        std::memcpy(&pointer, bytes, sizeof(pointer));
+        return pointer;
+    }
+
+    std::string str() const { return std::string(data(), size()); }
+    bool empty() const { return size() == 0; }
+
+    // Reports a spilled value as dead before the field is dropped
+    void release(StringArena& arena) const {
+        if (spilled()) arena.release(size());
+    }
+
+    // Re-stores a spilled value in another arena (compaction)
+    void moveTo(StringArena& arena) {
+        if (spilled()) setSpill(arena.store(data(), size()), size());
+    }
+
+    // On disk a spilled field holds an offset into the file's spill section
+    void toFileForm(std::uint64_t offset) {
+        if (spilled()) std::memcpy(bytes, &offset, sizeof(offset));
+    }
+
+    bool validFileForm(std::uint64_t spillSize) const {
+        if (!spilled()) return bytes[N - 1] <= INLINE_CAPACITY;
+        std::uint64_t offset = fileOffset();
+        return offset <= spillSize && size() <= spillSize - offset;
+    }
+
+    // Only for fields that passed validFileForm
+    void fromFileForm(const char* spill, StringArena& arena) {
+        if (spilled()) setSpill(arena.store(spill + fileOffset(), size()), size());
+    }
+
+    unsigned char bytes[N];
+
+private:
+    static constexpr unsigned char SPILLED = 0xFF;
+
+    std::uint64_t fileOffset() const {
+        std::uint64_t offset;
+        std::memcpy(&offset, bytes, sizeof(offset));
+        return offset;
+    }
+
+    void setSpill(const char* pointer, std::size_t length) {
+        std::uint32_t stored = static_cast<std::uint32_t>(length);
+        std::memcpy(bytes, &pointer, sizeof(pointer));
+        std::memcpy(bytes + sizeof(pointer), &stored, sizeof(stored));
+        bytes[N - 1] = SPILLED;
+    }
+};
+
+/**
+ * Binary record files: a header, the records exactly as laid out in memory
+ * (spilled strings replaced by offsets), then the spill section.
+ * Files use the host's byte order and are meant for the machine that wrote them;
+ * the record size in the header guards against layout changes.
+ */
+struct RecordFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    std::uint64_t spillBytes;
+};
+
+// Bumped whenever a record layout changes without changing its size
+const std::uint32_t RECORD_FILE_VERSION = 2;
+const std::size_t RECORD_FILE_CHUNK = 64 * 1024; // records are written in chunks this big
+
+/**
+ * Writes count records, taking record i from at(i). Record must be trivially
+ * copyable and provide forEachString(f) visiting its InlineString fields.
+ */
+template <typename Record, typename At>
+bool writeRecordFile(const std::string& filename, const char (&magic)[5], std::size_t count, At at) {
+    static_assert(std::is_trivially_copyable<Record>::value, "records are written with memcpy");
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    RecordFileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = RECORD_FILE_VERSION;
+    header.recordSize = static_cast<std::uint32_t>(sizeof(Record));
+    header.count = count;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header)); // rewritten once spill size is known
+
+    const std::size_t perChunk = RECORD_FILE_CHUNK / sizeof(Record) + 1;
+    std::vector<Record> chunk;
+    chunk.reserve(perChunk);
+    std::string spill;
+    for (std::size_t i = 0; i < count; ++i) {
+        chunk.push_back(at(i));
+        chunk.back().forEachString([&spill](auto& field) {
+            if (field.spilled()) {
+                std::uint64_t offset = spill.size();
+                spill.append(field.data(), field.size());
+                field.toFileForm(offset);
+            }
+        });
+        if (chunk.size() == perChunk) {
+            out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(Record)));
+            chunk.clear();
+        }
+    }
+    out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(Record)));
+    out.write(spill.data(), static_cast<std::streamsize>(spill.size()));
+
+    header.spillBytes = spill.size();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(out);
+}
+
+/**
+ * Reads a file written by writeRecordFile, re-homing spilled strings in arena,
+ * and hands each record to sink in file order. Returns false (calling sink for
+ * nothing) if the file is missing, truncated or has another layout.
+ */
+template <typename Record, typename Sink>
+bool readRecordFile(const std::string& filename, const char (&magic)[5], StringArena& arena, Sink sink) {
+    static_assert(std::is_trivially_copyable<Record>::value, "records are read with memcpy");
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    std::uint64_t fileSize = static_cast<std::uint64_t>(in.tellg());
+    in.seekg(0);
+    RecordFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 ||
+        header.version != RECORD_FILE_VERSION || header.recordSize != sizeof(Record) ||
+        header.count > fileSize / sizeof(Record) ||
+        header.spillBytes != fileSize - sizeof(header) - header.count * sizeof(Record)) {
+        return false;
+    }
+
+    std::vector<Record> records(static_cast<std::size_t>(header.count));
+    std::string spill(static_cast<std::size_t>(header.spillBytes), '\0');
+    if (!in.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record))) ||
+        !in.read(&spill[0], static_cast<std::streamsize>(spill.size()))) {
+        return false;
+    }
+
+    // Validate every field before anything is stored or handed out
+    bool valid = true;
+    for (Record& record : records) {
+        record.forEachString([&](const auto& field) { valid = valid && field.validFileForm(spill.size()); });
+    }
+    if (!valid) {
+        return false;
+    }
+    for (Record& record : records) {
+        record.forEachString([&](auto& field) { field.fromFileForm(spill.data(), arena); });
+        sink(record);
+    }
+    return true;
+}
+
+#endif // COMPACTRECORDS_HPP
@@ -0,0 +1,553 @@
+#ifndef CONTAINERS_HPP
+#define CONTAINERS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Generic containers behind the role stores.
+ *
+ * Queue and Stack keep their elements contiguous (a growable ring and a
+ * vector), so walking a store touches consecutive memory instead of chasing
+ * one heap node per record. RingBuffer has its capacity in the type: index
+ * wrapping compiles to a mask for power-of-two sizes and to a compare for
+ * the rest, and loops over it can be unrolled. PriorityQueue is a binary
+ * heap with the same ordering rules as std::priority_queue. Slab hands out
+ * numbered slots that never move, for records looked up by index.
+ *
+ * PersistentStack and PersistentQueue never change a version in place:
+ * every change returns a new version in O(1) that shares its unchanged
+ * part with the old one, so keeping many versions costs about one element
+ * per change. The undo histories of the stores are built on them.
+ */
+
+/**
+ * FIFO queue over a power-of-two ring that doubles when full.
+ * operator[] indexes from the front (0 = next to leave).
+ */
+template <typename T, typename Alloc = std::allocator<T>>
+class Queue {
+public:
+    Queue() = default;
+    explicit Queue(const Alloc& allocator) : alloc(allocator) {}
+
+    Queue(const Queue& other) : alloc(Traits::select_on_container_copy_construction(other.alloc)) {
+        reserve(other.count);
+        for (std::size_t i = 0; i < other.count; ++i) {
+            push_back(other[i]);
+        }
+    }
+
+    Queue(Queue&& other) noexcept
+        : alloc(std::move(other.alloc)), slots(other.slots), head(other.head), count(other.count), mask(other.mask) {
+        other.slots = nullptr;
+        other.head = other.count = 0;
+        other.mask = 0;
+    }
+
+    Queue& operator=(Queue other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~Queue() {
+        clear();
+        release();
+    }
+
+    void swap(Queue& other) noexcept {
+        using std::swap;
+        swap(alloc, other.alloc);
+        swap(slots, other.slots);
+        swap(head, other.head);
+        swap(count, other.count);
+        swap(mask, other.mask);
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (count == capacity()) {
+            return growAndEmplace(false, std::forward<Args>(args)...);
+        }
+        T* slot = slots + ((head + count) & mask);
+        Traits::construct(alloc, slot, std::forward<Args>(args)...);
+        ++count;
+        return *slot;
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        if (count == capacity()) {
+            return growAndEmplace(true, std::forward<Args>(args)...);
+        }
+        head = (head - 1) & mask;
+        T* slot = slots + head;
+        Traits::construct(alloc, slot, std::forward<Args>(args)...);
+        ++count;
+        return *slot;
+    }
+
+    // Back element; the queue must not be empty
+    T& back() { return slots[(head + count - 1) & mask]; }
+    const T& back() const { return slots[(head + count - 1) & mask]; }
+
+    void pop_back() {
+        Traits::destroy(alloc, slots + ((head + count - 1) & mask));
+        --count;
+    }
+
+    // Front element; the queue must not be empty
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+
+    void pop_front() {
+        Traits::destroy(alloc, slots + head);
+        head = (head + 1) & mask;
+        --count;
+    }
+
+    // Moves the front element into out; returns false when empty
+    bool pop_front(T& out) {
+        if (count == 0) {
+            return false;
+        }
+        out = std::move(slots[head]);
+        pop_front();
+        return true;
+    }
+
+    T& operator[](std::size_t index) { return slots[(head + index) & mask]; }
+    const T& operator[](std::size_t index) const { return slots[(head + index) & mask]; }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    std::size_t capacity() const { return slots == nullptr ? 0 : mask + 1; }
+
+    void reserve(std::size_t wanted) {
+        if (wanted <= capacity()) {
+            return;
+        }
+        std::size_t rounded = MIN_CAPACITY;
+        while (rounded < wanted) {
+            rounded *= 2;
+        }
+        grow(rounded);
+    }
+
+    void clear() {
+        while (count > 0) {
+            pop_front();
+        }
+        head = 0;
+    }
+
+private:
+    typedef std::allocator_traits<Alloc> Traits;
+    static constexpr std::size_t MIN_CAPACITY = 16;
+
+    /**
+     * Full ring: builds the new element in a ring of twice the size before
+     * the old elements move over, so args may refer to one of them, as in
+     * q.push_back(q.front()).
+     */
+    template <typename... Args>
+    T& growAndEmplace(bool atFront, Args&&... args) {
+        std::size_t newCapacity = count == 0 ? MIN_CAPACITY : capacity() * 2;
+        T* fresh = Traits::allocate(alloc, newCapacity);
+        T* slot = fresh + (atFront ? newCapacity - 1 : count);
+        try {
+            Traits::construct(alloc, slot, std::forward<Args>(args)...);
+        } catch (...) {
+            Traits::deallocate(alloc, fresh, newCapacity);
+            throw;
+        }
+        adopt(fresh, newCapacity);
+        if (atFront) {
+            head = newCapacity - 1;
+        }
+        ++count;
+        return *slot;
+    }
+
+    void grow(std::size_t newCapacity) {
+        adopt(Traits::allocate(alloc, newCapacity), newCapacity);
+    }
+
+    // Moves the elements into fresh, a ring of newCapacity slots, front at index 0
+    void adopt(T* fresh, std::size_t newCapacity) {
+        for (std::size_t i = 0; i < count; ++i) {
+            T* old = slots + ((head + i) & mask);
+            Traits::construct(alloc, fresh + i, std::move_if_noexcept(*old));
+            Traits::destroy(alloc, old);
+        }
+        release();
+        slots = fresh;
+        head = 0;
+        mask = newCapacity - 1;
+    }
+
+    void release() {
+        if (slots != nullptr) {
+            Traits::deallocate(alloc, slots, mask + 1);
+            slots = nullptr;
+        }
+    }
+
+    Alloc alloc;
+    T* slots = nullptr;
+    std::size_t head = 0;
+    std::size_t count = 0;
+    std::size_t mask = 0;
+};
+
+/**
+ * LIFO stack over a contiguous vector.
+ * fromTop(0) is the most recently pushed element.
+ */
+template <typename T, typename Alloc = std::allocator<T>>
+class Stack {
+public:
+    Stack() = default;
+    explicit Stack(const Alloc& allocator) : items(allocator) {}
+
+    template <typename... Args>
+    T& emplace(Args&&... args) {
+        items.emplace_back(std::forward<Args>(args)...);
+        return items.back();
+    }
+
+    void push(const T& value) { items.push_back(value); }
+    void push(T&& value) { items.push_back(std::move(value)); }
+
+    // Top element; the stack must not be empty
+    T& top() { return items.back(); }
+    const T& top() const { return items.back(); }
+
+    void pop() { items.pop_back(); }
+
+    // Moves the top element into out; returns false when empty
+    bool pop(T& out) {
+        if (items.empty()) {
+            return false;
+        }
+        out = std::move(items.back());
+        items.pop_back();
+        return true;
+    }
+
+    T& fromTop(std::size_t index) { return items[items.size() - 1 - index]; }
+    const T& fromTop(std::size_t index) const { return items[items.size() - 1 - index]; }
+
+    std::size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void reserve(std::size_t wanted) { items.reserve(wanted); }
+    void clear() { items.clear(); }
+
+private:
+    std::vector<T, Alloc> items;
+};
+
+/**
+ * Bounded FIFO with N slots held inline (no allocation).
+ * operator[] indexes from the front.
+ */
+template <typename T, std::size_t N>
+class RingBuffer {
+    static_assert(N > 0, "RingBuffer needs at least one slot");
+
+public:
+    static constexpr std::size_t capacity() { return N; }
+
+    // Appends a copy of value; returns false when full
+    bool push_back(const T& value) {
+        if (count == N) {
+            return false;
+        }
+        slots[wrap(head + count)] = value;
+        ++count;
+        return true;
+    }
+
+    // Copies the front element into out and removes it; returns false when empty
+    bool pop_front(T& out) {
+        if (count == 0) {
+            return false;
+        }
+        out = slots[head];
+        head = wrap(head + 1);
+        --count;
+        return true;
+    }
+
+    // Moves the front element to the back
+    void rotate() {
+        if (count == N) {
+            head = wrap(head + 1); // a full ring rotates without copying
+        } else if (count > 1) {
+            slots[wrap(head + count)] = slots[head];
+            head = wrap(head + 1);
+        }
+    }
+
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+    T& operator[](std::size_t index) { return slots[wrap(head + index)]; }
+    const T& operator[](std::size_t index) const { return slots[wrap(head + index)]; }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+private:
+    // index is always below 2N here
+    static constexpr std::size_t wrap(std::size_t index) {
+        if constexpr ((N & (N - 1)) == 0) {
+            return index & (N - 1);
+        } else {
+            return index < N ? index : index - N;
+        }
+    }
+
+    std::array<T, N> slots{};
+    std::size_t head = 0;
+    std::size_t count = 0;
+};
+
+/**
+ * Binary heap; top() is the greatest element under Cmp (as in std::priority_queue).
+ */
+template <typename T, typename Cmp = std::less<T>>
+class PriorityQueue {
+public:
+    PriorityQueue() = default;
+    explicit PriorityQueue(const Cmp& compare) : cmp(compare) {}
+
+    // Builds the heap from existing elements in O(n)
+    PriorityQueue(std::vector<T> elements, const Cmp& compare = Cmp())
+        : items(std::move(elements)), cmp(compare) {
+        std::make_heap(items.begin(), items.end(), cmp);
+    }
+
+    void push(const T& value) {
+        items.push_back(value);
+        std::push_heap(items.begin(), items.end(), cmp);
+    }
+
+    void push(T&& value) {
+        items.push_back(std::move(value));
+        std::push_heap(items.begin(), items.end(), cmp);
+    }
+
+    // Greatest element; the queue must not be empty
+    const T& top() const { return items.front(); }
+
+    void pop() {
+        std::pop_heap(items.begin(), items.end(), cmp);
+        items.pop_back();
+    }
+
+    std::size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void reserve(std::size_t wanted) { items.reserve(wanted); }
+    void clear() { items.clear(); }
+
+private:
+    std::vector<T> items;
+    Cmp cmp;
+};
+
+/**
+ * Numbered slots of T in chunks of ChunkSize, so growing never moves or
+ * copies an element. Released slots are reused, newest first, before a new
+ * one is taken; a released slot keeps its old contents until reused.
+ */
+template <typename T, std::size_t ChunkSize = 1024>
+class Slab {
+    static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0, "Slab chunks must be a power of two");
+
+public:
+    std::uint32_t allocate() {
+        if (!freeSlots.empty()) {
+            std::uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (used == chunks.size() * ChunkSize) {
+            chunks.emplace_back(new T[ChunkSize]());
+        }
+        return static_cast<std::uint32_t>(used++);
+    }
+
+    void release(std::uint32_t slot) { freeSlots.push_back(slot); }
+
+    T& operator[](std::uint32_t slot) { return chunks[slot / ChunkSize][slot % ChunkSize]; }
+    const T& operator[](std::uint32_t slot) const { return chunks[slot / ChunkSize][slot % ChunkSize]; }
+
+    // Slots handed out so far, released ones included
+    std::size_t extent() const { return used; }
+
+    // Releases every slot; the chunks are kept for reuse
+    void clear() {
+        used = 0;
+        freeSlots.clear();
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    std::vector<std::uint32_t> freeSlots;
+    std::size_t used = 0;
+};
+
+/**
+ * Immutable LIFO list. push() and pop() return a new stack sharing the
+ * rest of the nodes; the stack they were called on is unchanged.
+ */
+template <typename T>
+class PersistentStack {
+public:
+    PersistentStack() = default;
+    PersistentStack(const PersistentStack&) = default;
+    PersistentStack(PersistentStack&&) noexcept = default;
+
+    PersistentStack& operator=(PersistentStack other) noexcept {
+        std::swap(head, other.head);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    // Frees the nodes no other version uses one at a time, so a long
+    // list does not unwind recursively
+    ~PersistentStack() {
+        while (head && head.use_count() == 1) {
+            std::shared_ptr<const Node> next = head->next;
+            head = std::move(next);
+        }
+    }
+
+    PersistentStack push(T value) const {
+        return PersistentStack(std::make_shared<const Node>(Node{std::move(value), head}), count + 1);
+    }
+
+    // The stack without its top element (an empty stack stays empty)
+    PersistentStack pop() const {
+        return head ? PersistentStack(head->next, count - 1) : *this;
+    }
+
+    // Top element; the stack must not be empty
+    const T& top() const { return head->value; }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Calls visit(element) from the top down
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (const Node* node = head.get(); node != nullptr; node = node->next.get()) {
+            visit(node->value);
+        }
+    }
+
+private:
+    struct Node {
+        T value;
+        std::shared_ptr<const Node> next;
+    };
+
+    PersistentStack(std::shared_ptr<const Node> top, std::size_t size) : head(std::move(top)), count(size) {}
+
+    std::shared_ptr<const Node> head;
+    std::size_t count = 0;
+};
+
+/**
+ * FIFO versions over one shared append-only log. A version is the range
+ * [first, last) of log positions, so push_back() and pop_front() return a
+ * new version in O(1) without copying anything but the pushed element.
+ *
+ * Versions are persistent along one line of history: every version stays
+ * readable, but pushing onto a version that is not the newest overwrites
+ * the log positions of the versions made after it. That is what an undo
+ * history needs (a change after an undo discards the redo versions) and
+ * lets a version share storage with the next instead of copying nodes.
+ */
+template <typename T>
+class PersistentQueue {
+public:
+    PersistentQueue() : log(std::make_shared<Log>()) {}
+
+    PersistentQueue push_back(T value) const {
+        log->truncate(last);
+        log->append(std::move(value));
+        PersistentQueue next(*this);
+        ++next.last;
+        return next;
+    }
+
+    // The queue without its front element (an empty queue stays empty)
+    PersistentQueue pop_front() const {
+        PersistentQueue next(*this);
+        next.first += (first < last) ? 1 : 0;
+        return next;
+    }
+
+    // Front and back elements; the queue must not be empty
+    const T& front() const { return log->at(first); }
+    const T& back() const { return log->at(last - 1); }
+
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+    bool empty() const { return first == last; }
+
+    // Calls visit(element) from the front to the back
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (std::uint64_t position = first; position < last; ++position) {
+            visit(log->at(position));
+        }
+    }
+
+    // Frees the log before this version's front; only for the oldest version still kept
+    void releaseOlder() const { log->dropBefore(first); }
+
+private:
+    struct Log {
+        std::deque<T> items;
+        std::uint64_t offset = 0; // log position of items.front()
+
+        const T& at(std::uint64_t position) const { return items[static_cast<std::size_t>(position - offset)]; }
+        void append(T value) { items.push_back(std::move(value)); }
+
+        void truncate(std::uint64_t end) {
+            while (offset + items.size() > end) {
+                items.pop_back();
+            }
+        }
+
+        void dropBefore(std::uint64_t position) {
+            while (offset < position && !items.empty()) {
+                items.pop_front();
+                ++offset;
+            }
+        }
+    };
+
+    std::shared_ptr<Log> log;
+    std::uint64_t first = 0;
+    std::uint64_t last = 0;
+};
+
+#endif // CONTAINERS_HPP
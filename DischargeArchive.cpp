@@ -0,0 +1,388 @@
+#include "DischargeArchive.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+
+namespace {
+
+const char* const SEGMENT_HEADER = "Discharged At,Admitted At,Patient ID,Condition Type\n";
+const std::size_t SEGMENT_NUMBER_DIGITS = 6;
+
+std::string segmentName(std::size_t number, const char* extension) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "segment-%0*zu.%s",
+                  static_cast<int>(SEGMENT_NUMBER_DIGITS), number, extension);
+    return buffer;
+}
+
+// Number of a "segment-NNNNNN.csv" file name, or 0
+std::size_t segmentNumber(const std::string& name) {
+    const std::string prefix = "segment-";
+    const std::string suffix = ".csv";
+    if (name.size() != prefix.size() + SEGMENT_NUMBER_DIGITS + suffix.size() ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return 0;
+    }
+    std::size_t number = 0;
+    for (std::size_t i = prefix.size(); i < prefix.size() + SEGMENT_NUMBER_DIGITS; ++i) {
+        if (name[i] < '0' || name[i] > '9') {
+            return 0;
+        }
+        number = number * 10 + static_cast<std::size_t>(name[i] - '0');
+    }
+    return number;
+}
+
+// Parses "discharged,admitted,id,condition"; false for malformed rows
+bool parseRow(const std::string& line, DischargeRecord& record) {
+    std::size_t first = line.find(',');
+    std::size_t second = (first == std::string::npos) ? first : line.find(',', first + 1);
+    std::size_t third = (second == std::string::npos) ? second : line.find(',', second + 1);
+    if (third == std::string::npos) {
+        return false;
+    }
+    char* end = nullptr;
+    record.dischargedAt = std::strtoll(line.c_str(), &end, 10);
+    if (end != line.c_str() + first) {
+        return false;
+    }
+    record.admittedAt = std::strtoll(line.c_str() + first + 1, &end, 10);
+    if (end != line.c_str() + second) {
+        return false;
+    }
+    record.id.assign(line, second + 1, third - second - 1);
+    record.conditionType.assign(line, third + 1, std::string::npos);
+    return !record.id.empty();
+}
+
+// Discharge time only, for rows that are skipped or end the scan
+bool parseTime(const std::string& line, std::int64_t& time) {
+    char* end = nullptr;
+    time = std::strtoll(line.c_str(), &end, 10);
+    return end != line.c_str() && *end == ',';
+}
+
+} // namespace
+
+// Buffered rows handed over by the archive, written out in order by drain().
+// Only drain() touches the files, under fileMutex, so a queued write and a
+// query on another thread never interleave.
+struct DischargeArchive::WriteQueue {
+    struct Chunk {
+        std::string path;
+        std::string indexPath;
+        std::string rows;
+        std::string index;
+        bool fresh; // create the files (the rows start with the header)
+    };
+
+    std::mutex mutex; // guards chunks
+    std::vector<Chunk> chunks;
+    std::mutex fileMutex;
+    std::ofstream rowsOut;
+    std::ofstream indexOut;
+    std::string openPath;
+    std::atomic<bool> ok{true}; // false after any failed write
+
+    void push(Chunk chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.push_back(std::move(chunk));
+    }
+
+    // Rows go out before the index entries that point at them
+    bool drain() {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        std::vector<Chunk> taken;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            taken.swap(chunks);
+        }
+        for (const Chunk& chunk : taken) {
+            if (chunk.fresh || chunk.path != openPath) {
+                rowsOut.close();
+                indexOut.close();
+                rowsOut.clear();
+                indexOut.clear();
+                std::ios::openmode mode = std::ios::binary | (chunk.fresh ? std::ios::trunc : std::ios::app);
+                rowsOut.open(chunk.path, mode);
+                indexOut.open(chunk.indexPath, mode);
+                openPath = chunk.path;
+            }
+            rowsOut.write(chunk.rows.data(), static_cast<std::streamsize>(chunk.rows.size()));
+            rowsOut.flush();
+            indexOut.write(chunk.index.data(), static_cast<std::streamsize>(chunk.index.size()));
+            indexOut.flush();
+            if (!rowsOut || !indexOut) {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+};
+
+DischargeArchive::DischargeArchive(const std::string& directory)
+    : dir(directory), freshSegment(false), writes(std::make_shared<WriteQueue>()), lastTime(0), total(0) {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+
+    std::vector<std::size_t> numbers;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+        std::size_t number = segmentNumber(entry.path().filename().string());
+        if (number > 0) {
+            numbers.push_back(number);
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    for (std::size_t number : numbers) {
+        Segment segment;
+        segment.path = dir + "/" + segmentName(number, "csv");
+        segment.indexPath = dir + "/" + segmentName(number, "idx");
+        recover(segment);
+        total += segment.records;
+        segments.push_back(segment);
+    }
+
+    if (segments.empty()) {
+        openSegment(1);
+    } else if (segments.back().records >= ARCHIVE_SEGMENT_RECORDS) {
+        openSegment(numbers.back() + 1);
+    }
+}
+
+DischargeArchive::~DischargeArchive() {
+    flush();
+}
+
+bool DischargeArchive::append(DischargeRecord record) {
+    if (segments.back().records >= ARCHIVE_SEGMENT_RECORDS) {
+        openSegment(segmentNumber(std::filesystem::path(segments.back().path).filename().string()) + 1);
+    }
+
+    Segment& segment = segments.back();
+    record.dischargedAt = std::max(record.dischargedAt, lastTime);
+    lastTime = record.dischargedAt;
+
+    if (segment.records % ARCHIVE_INDEX_STRIDE == 0) {
+        segment.index.push_back(IndexEntry{record.dischargedAt, segment.bytes});
+        index += std::to_string(record.dischargedAt);
+        index += ',';
+        index += std::to_string(segment.bytes);
+        index += '\n';
+    }
+
+    std::size_t rowStart = rows.size();
+    rows += std::to_string(record.dischargedAt);
+    rows += ',';
+    rows += std::to_string(record.admittedAt);
+    rows += ',';
+    rows += record.id;
+    rows += ',';
+    rows += record.conditionType;
+    rows += '\n';
+
+    segment.bytes += rows.size() - rowStart;
+    ++segment.records;
+    ++total;
+    return writes->ok;
+}
+
+bool DischargeArchive::flush() {
+    handOver();
+    return writes->drain();
+}
+
+// The task only drains the shared queue, so a newer flush replacing a
+// waiting one loses nothing
+void DischargeArchive::flushLater(WorkStealingPool* pool) {
+    if (!pool) {
+        flush();
+        return;
+    }
+    handOver();
+    std::shared_ptr<WriteQueue> queue = writes;
+    pool->submitLatest(dir, [queue] { queue->drain(); });
+}
+
+void DischargeArchive::handOver() {
+    if (rows.empty() && index.empty() && !freshSegment) {
+        return;
+    }
+    const Segment& segment = segments.back();
+    writes->push(WriteQueue::Chunk{segment.path, segment.indexPath, std::move(rows), std::move(index), freshSegment});
+    rows.clear();
+    index.clear();
+    freshSegment = false;
+}
+
+std::size_t DischargeArchive::query(std::int64_t from, std::int64_t to, const std::string& condition,
+                                    const std::function<void(const DischargeRecord&)>& visit) {
+    return prepareQuery(from, to, condition).run(visit);
+}
+
+DischargeArchive::Query DischargeArchive::prepareQuery(std::int64_t from, std::int64_t to,
+                                                       const std::string& condition) {
+    Query query;
+    query.from = from;
+    query.to = to;
+    query.condition = condition;
+    query.writes = writes;
+    if (from >= to || total == 0) {
+        return query;
+    }
+    handOver(); // run() writes these out before reading
+
+    // Last segment starting before from (rows equal to from may end the previous one)
+    auto segmentIt = std::lower_bound(segments.begin(), segments.end(), from,
+                                      [](const Segment& segment, std::int64_t time) {
+                                          return !segment.index.empty() && segment.index.front().time < time;
+                                      });
+    if (segmentIt != segments.begin()) {
+        --segmentIt;
+    }
+    query.segments.assign(segmentIt, segments.end());
+    return query;
+}
+
+std::size_t DischargeArchive::Query::run(const std::function<void(const DischargeRecord&)>& visit) const {
+    if (segments.empty()) {
+        return 0;
+    }
+    writes->drain();
+
+    std::size_t visited = 0;
+    std::string line;
+    DischargeRecord record;
+    bool first = true;
+    for (const Segment& segment : segments) {
+        if (segment.index.empty()) {
+            continue;
+        }
+        // Last stride starting before from; every row before it is earlier
+        std::uint64_t offset = segment.index.front().offset;
+        if (first) {
+            auto entry = std::lower_bound(segment.index.begin(), segment.index.end(), from,
+                                          [](const IndexEntry& e, std::int64_t time) { return e.time < time; });
+            if (entry != segment.index.begin()) {
+                offset = std::prev(entry)->offset;
+            }
+            first = false;
+        }
+
+        std::ifstream in(segment.path, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(offset));
+        while (offset < segment.bytes && std::getline(in, line)) {
+            offset += line.size() + 1;
+            std::int64_t time;
+            if (!parseTime(line, time) || time < from) {
+                continue;
+            }
+            if (time >= to) {
+                return visited;
+            }
+            if (!parseRow(line, record)) {
+                continue;
+            }
+            if (condition.empty() || record.conditionType == condition) {
+                visit(record);
+                ++visited;
+            }
+        }
+    }
+    return visited;
+}
+
+// The files are created by the first write of the new segment
+void DischargeArchive::openSegment(std::size_t number) {
+    handOver();
+    Segment segment;
+    segment.path = dir + "/" + segmentName(number, "csv");
+    segment.indexPath = dir + "/" + segmentName(number, "idx");
+    rows = SEGMENT_HEADER;
+    segment.bytes = rows.size();
+    segments.push_back(segment);
+    freshSegment = true;
+}
+
+/**
+ * Loads a segment's index, drops entries past the end of its rows, and
+ * scans the rows after the last entry to count them and index any stride
+ * the .idx file missed. A torn last row is cut off.
+ */
+void DischargeArchive::recover(Segment& segment) {
+    std::error_code error;
+    std::uint64_t fileSize = std::filesystem::file_size(segment.path, error);
+    if (error) {
+        fileSize = 0;
+    }
+
+    std::ifstream indexIn(segment.indexPath, std::ios::binary);
+    std::string line;
+    while (std::getline(indexIn, line)) {
+        char* end = nullptr;
+        IndexEntry entry;
+        entry.time = std::strtoll(line.c_str(), &end, 10);
+        if (*end != ',') {
+            break;
+        }
+        entry.offset = std::strtoull(end + 1, nullptr, 10);
+        if (entry.offset >= fileSize || (!segment.index.empty() && entry.offset <= segment.index.back().offset)) {
+            break;
+        }
+        segment.index.push_back(entry);
+    }
+    indexIn.close();
+    const std::size_t indexed = segment.index.size();
+
+    std::ifstream in(segment.path, std::ios::binary);
+    std::uint64_t offset = 0;
+    if (!segment.index.empty()) {
+        offset = segment.index.back().offset;
+        segment.records = (segment.index.size() - 1) * ARCHIVE_INDEX_STRIDE;
+        in.seekg(static_cast<std::streamoff>(offset));
+    } else if (std::getline(in, line) && !in.eof()) {
+        offset = line.size() + 1; // header
+    } else {
+        // Empty or header only: start over with a clean header
+        in.close();
+        std::ofstream reset(segment.path, std::ios::binary | std::ios::trunc);
+        reset << SEGMENT_HEADER;
+        segment.bytes = std::char_traits<char>::length(SEGMENT_HEADER);
+        std::ofstream(segment.indexPath, std::ios::binary | std::ios::trunc);
+        return;
+    }
+
+    while (std::getline(in, line) && !in.eof()) {
+        std::uint64_t rowOffset = offset;
+        offset += line.size() + 1;
+        std::int64_t time;
+        if (!parseTime(line, time)) {
+            continue;
+        }
+        if (segment.records % ARCHIVE_INDEX_STRIDE == 0 &&
+            segment.records / ARCHIVE_INDEX_STRIDE >= segment.index.size()) {
+            segment.index.push_back(IndexEntry{time, rowOffset});
+        }
+        ++segment.records;
+        lastTime = std::max(lastTime, time);
+    }
+    segment.bytes = offset;
+    in.close();
+
+    if (fileSize > segment.bytes) {
+        std::filesystem::resize_file(segment.path, segment.bytes, error);
+    }
+    if (segment.index.size() != indexed) {
+        std::ofstream rewrite(segment.indexPath, std::ios::binary | std::ios::trunc);
+        for (const IndexEntry& entry : segment.index) {
+            rewrite << entry.time << ',' << entry.offset << '\n';
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef DISCHARGEARCHIVE_HPP
+#define DISCHARGEARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class WorkStealingPool;
+
+// Directory holding the discharge history of the default patient queue
+const char* const DISCHARGE_ARCHIVE_DIR = "data/discharges";
+
+// A segment is closed after this many records and a new one started
+const std::uint64_t ARCHIVE_SEGMENT_RECORDS = 1 << 16;
+// One sparse index entry per this many records
+const std::uint64_t ARCHIVE_INDEX_STRIDE = 256;
+
+// One discharged patient; times are Unix seconds, admittedAt 0 if unknown
+struct DischargeRecord {
+    std::int64_t dischargedAt;
+    std::int64_t admittedAt;
+    std::string id;
+    std::string conditionType;
+};
+
+/**
+ * Append-only history of discharged patients, ordered by discharge time.
+ *
+ * Records go to CSV segments (segment-NNNNNN.csv) of ARCHIVE_SEGMENT_RECORDS
+ * rows. Next to each segment, a .idx file keeps the discharge time and byte
+ * offset of every ARCHIVE_INDEX_STRIDE-th row; all index entries are held
+ * in memory. A time-range query binary-searches them for the first stride
+ * that can contain matches and then reads rows sequentially until the range
+ * ends, so its cost follows the number of rows in range, not the archive size.
+ *
+ * Discharge times never decrease: a clock that steps back is clamped to the
+ * last archived time. On open, the newest segment is re-scanned from its last
+ * index entry, so a missing or stale index tail is rebuilt.
+ *
+ * Appended rows stay in memory until a flush. flushLater() hands them to a
+ * write queue drained on a WorkStealingPool, so the caller never waits on
+ * the disk; flush() and queries drain that queue first, in order.
+ */
+class DischargeArchive {
+public:
+    explicit DischargeArchive(const std::string& directory);
+    ~DischargeArchive();
+
+    DischargeArchive(const DischargeArchive&) = delete;
+    DischargeArchive& operator=(const DischargeArchive&) = delete;
+
+    class Query;
+
+    // Appends one record (buffered until flush); false once a write has failed
+    bool append(DischargeRecord record);
+    bool flush();                            // writes every buffered row now; false on failure
+    void flushLater(WorkStealingPool* pool); // same on pool, keyed by the directory; null: flush()
+
+    /**
+     * Calls visit for each record discharged in [from, to) whose condition
+     * equals condition (any condition when empty), in discharge order.
+     * Flushes pending appends first. Returns the number of records visited.
+     */
+    std::size_t query(std::int64_t from, std::int64_t to, const std::string& condition,
+                      const std::function<void(const DischargeRecord&)>& visit);
+
+    // The same query as of now, to run later on any thread (see Query)
+    Query prepareQuery(std::int64_t from, std::int64_t to, const std::string& condition);
+
+    std::uint64_t size() const { return total; }
+    const std::string& directory() const { return dir; }
+
+private:
+    struct IndexEntry {
+        std::int64_t time;
+        std::uint64_t offset;
+    };
+
+    struct Segment {
+        std::string path;
+        std::string indexPath;
+        std::vector<IndexEntry> index; // by time; the first entry is the first row
+        std::uint64_t records = 0;
+        std::uint64_t bytes = 0;       // end of the last complete row
+    };
+
+    // Rows and index lines not yet on disk, oldest segment first (defined in the .cpp)
+    struct WriteQueue;
+
+    void openSegment(std::size_t number);
+    void handOver(); // moves the buffered rows of the newest segment to writes
+    void recover(Segment& segment);
+
+    std::string dir;
+    std::vector<Segment> segments;
+    std::string rows;   // buffered rows of the newest segment
+    std::string index;  // and of its .idx
+    bool freshSegment;  // newest segment not created on disk yet
+    std::shared_ptr<WriteQueue> writes; // shared with queued writes and queries
+    std::int64_t lastTime;
+    std::uint64_t total;
+};
+
+/**
+ * A time-range query over a copy of the archive's segment list, taken by
+ * prepareQuery(). run() may be called on any thread while the archive keeps
+ * appending: it first writes out whatever the archive has handed to its write
+ * queue, then reads only the rows that existed when the query was prepared.
+ */
+class DischargeArchive::Query {
+public:
+    std::size_t run(const std::function<void(const DischargeRecord&)>& visit) const;
+
+private:
+    friend class DischargeArchive;
+
+    std::vector<Segment> segments; // from the first that can hold a match
+    std::int64_t from = 0;
+    std::int64_t to = 0;
+    std::string condition;
+    std::shared_ptr<WriteQueue> writes;
+};
+
+#endif // DISCHARGEARCHIVE_HPP
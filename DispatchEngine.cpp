@@ -0,0 +1,177 @@
+#include "DispatchEngine.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Metrics.hpp"
+
+DispatchEngine::DispatchEngine(double widthKm, double heightKm, double cellKm)
+    : width(widthKm > 0.0 ? widthKm : DEFAULT_SERVICE_AREA_KM),
+      height(heightKm > 0.0 ? heightKm : DEFAULT_SERVICE_AREA_KM),
+      cellSize(cellKm > 0.0 ? cellKm : DEFAULT_DISPATCH_CELL_KM),
+      available(0) {
+    columns = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+    cells.resize(static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows));
+}
+
+std::size_t DispatchEngine::addUnit(const Ambulance& unit) {
+    std::size_t index = units.size();
+    units.push_back(unit);
+    Ambulance& added = units.back();
+    clamp(added.x, added.y);
+    cellOf.push_back(static_cast<std::uint32_t>(cellFor(added.x, added.y)));
+    slotOf.push_back(0);
+    if (!added.id.empty()) {
+        indexById[added.id] = index;
+    }
+    if (added.available) {
+        insertFree(index);
+    }
+    return index;
+}
+
+bool DispatchEngine::findUnit(const std::string& id, std::size_t& index) const {
+    auto found = indexById.find(id);
+    if (found == indexById.end()) {
+        return false;
+    }
+    index = found->second;
+    return true;
+}
+
+void DispatchEngine::moveUnit(std::size_t index, double x, double y) {
+    Ambulance& unit = units[index];
+    clamp(x, y);
+    std::uint32_t cell = static_cast<std::uint32_t>(cellFor(x, y));
+    if (unit.available && cell != cellOf[index]) {
+        removeFree(index);
+        cellOf[index] = cell;
+        insertFree(index);
+    } else {
+        cellOf[index] = cell;
+    }
+    unit.x = x;
+    unit.y = y;
+}
+
+void DispatchEngine::setAvailable(std::size_t index, bool isAvailable) {
+    if (units[index].available == isAvailable) {
+        return;
+    }
+    if (isAvailable) {
+        insertFree(index);
+    } else {
+        removeFree(index);
+    }
+}
+
+bool DispatchEngine::nearestAvailable(DispatchPoint call, std::size_t& index, double& distanceKm) const {
+    if (available == 0) {
+        return false;
+    }
+    clamp(call.x, call.y);
+    const int cx = std::min(columns - 1, static_cast<int>(call.x / cellSize));
+    const int cy = std::min(rows - 1, static_cast<int>(call.y / cellSize));
+    const int maxRing = std::max(std::max(cx, columns - 1 - cx), std::max(cy, rows - 1 - cy));
+
+    double bestSquared = std::numeric_limits<double>::infinity();
+    std::size_t best = 0;
+    auto scanCell = [&](int column, int row) {
+        if (column < 0 || column >= columns || row < 0 || row >= rows) {
+            return;
+        }
+        for (std::uint32_t candidate : cells[static_cast<std::size_t>(row) * columns + column]) {
+            const Ambulance& unit = units[candidate];
+            double dx = unit.x - call.x;
+            double dy = unit.y - call.y;
+            double squared = dx * dx + dy * dy;
+            if (squared < bestSquared || (squared == bestSquared && candidate < best)) {
+                bestSquared = squared;
+                best = candidate;
+            }
+        }
+    };
+
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        if (ring == 0) {
+            scanCell(cx, cy);
+        } else {
+            for (int column = cx - ring; column <= cx + ring; ++column) {
+                scanCell(column, cy - ring);
+                scanCell(column, cy + ring);
+            }
+            for (int row = cy - ring + 1; row <= cy + ring - 1; ++row) {
+                scanCell(cx - ring, row);
+                scanCell(cx + ring, row);
+            }
+        }
+        // Every cell beyond this ring is at least ring * cellSize away
+        double reach = ring * cellSize;
+        if (bestSquared <= reach * reach) {
+            break;
+        }
+    }
+
+    index = best;
+    distanceKm = std::sqrt(bestSquared);
+    return true;
+}
+
+bool DispatchEngine::assign(DispatchPoint call, DispatchAssignment& out) {
+    HOSPITAL_METRIC_SCOPE(MetricId::DispatchAssign);
+    std::size_t index;
+    double distance;
+    if (!nearestAvailable(call, index, distance)) {
+        return false;
+    }
+    removeFree(index);
+    out.caseId = -1;
+    out.unit = index;
+    out.distanceKm = distance;
+    return true;
+}
+
+std::size_t DispatchEngine::dispatchBacklog(EmergencyDepartmentSystem& emergencies, const CallLocator& locate,
+                                            std::vector<DispatchAssignment>& out) {
+    std::size_t assigned = 0;
+    EmergencyCase emergency;
+    while (available > 0 && emergencies.takeMostCriticalCase(emergency)) {
+        DispatchAssignment assignment;
+        assign(locate(emergency), assignment);
+        assignment.caseId = emergency.id;
+        out.push_back(assignment);
+        ++assigned;
+    }
+    return assigned;
+}
+
+std::size_t DispatchEngine::cellFor(double x, double y) const {
+    int column = std::min(columns - 1, static_cast<int>(x / cellSize));
+    int row = std::min(rows - 1, static_cast<int>(y / cellSize));
+    return static_cast<std::size_t>(row) * columns + column;
+}
+
+void DispatchEngine::clamp(double& x, double& y) const {
+    // NaN compares false everywhere, so it is mapped to the corner explicitly
+    x = (x > 0.0) ? std::min(x, width) : 0.0;
+    y = (y > 0.0) ? std::min(y, height) : 0.0;
+}
+
+// Swap-remove keeps each cell a dense array; slotOf tracks the positions
+void DispatchEngine::insertFree(std::size_t index) {
+    std::vector<std::uint32_t>& cell = cells[cellOf[index]];
+    slotOf[index] = static_cast<std::uint32_t>(cell.size());
+    cell.push_back(static_cast<std::uint32_t>(index));
+    units[index].available = true;
+    ++available;
+}
+
+void DispatchEngine::removeFree(std::size_t index) {
+    std::vector<std::uint32_t>& cell = cells[cellOf[index]];
+    std::uint32_t slot = slotOf[index];
+    cell[slot] = cell.back();
+    slotOf[cell[slot]] = slot;
+    cell.pop_back();
+    units[index].available = false;
+    --available;
+}
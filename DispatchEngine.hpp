@@ -0,0 +1,97 @@
+#ifndef DISPATCHENGINE_HPP
+#define DISPATCHENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ambulance_dispatcher.hpp"
+#include "functionality.hpp"
+
+// Default service area (km) and grid cell edge; about one cell per unit
+// for a few thousand units
+const double DEFAULT_SERVICE_AREA_KM = 100.0;
+const double DEFAULT_DISPATCH_CELL_KM = 2.0;
+
+// A point in the service area, in km from its south-west corner
+struct DispatchPoint {
+    double x;
+    double y;
+};
+
+// One call handed to a unit
+struct DispatchAssignment {
+    int caseId;          // EmergencyCase id, or -1 for a bare call
+    std::size_t unit;    // index into the engine's units
+    double distanceKm;   // straight-line distance from unit to call
+};
+
+// Where a case should be attended; supplied by the caller
+typedef std::function<DispatchPoint(const EmergencyCase&)> CallLocator;
+
+/**
+ * Assigns calls to the nearest available ambulance.
+ *
+ * Available units are indexed in a uniform grid over the service area; a
+ * lookup scans rings of cells around the call and stops as soon as no
+ * unscanned cell can hold a closer unit, so its cost depends on how many
+ * free units are nearby rather than on the fleet size. Positions outside
+ * the area are clamped to its edge. Ties go to the lower unit index.
+ *
+ * Units are addressed by the index addUnit() returned. Like the role
+ * stores, an engine is used from one thread at a time.
+ */
+class DispatchEngine {
+public:
+    explicit DispatchEngine(double widthKm = DEFAULT_SERVICE_AREA_KM,
+                            double heightKm = DEFAULT_SERVICE_AREA_KM,
+                            double cellKm = DEFAULT_DISPATCH_CELL_KM);
+
+    // Adds a unit at its x/y with its availability; returns its index
+    std::size_t addUnit(const Ambulance& unit);
+    bool findUnit(const std::string& id, std::size_t& index) const;
+
+    const Ambulance& unit(std::size_t index) const { return units[index]; }
+    std::size_t unitCount() const { return units.size(); }
+    std::size_t availableCount() const { return available; }
+
+    void moveUnit(std::size_t index, double x, double y);
+    void setAvailable(std::size_t index, bool isAvailable);
+
+    // Nearest available unit to a point; false when none is free
+    bool nearestAvailable(DispatchPoint call, std::size_t& index, double& distanceKm) const;
+
+    // nearestAvailable, then marks the unit busy
+    bool assign(DispatchPoint call, DispatchAssignment& out);
+
+    /**
+     * Takes pending cases from the emergency department in processing order
+     * and assigns each to the nearest free unit, until either runs out.
+     * Cases are only taken while a unit is free. Returns the number assigned.
+     */
+    std::size_t dispatchBacklog(EmergencyDepartmentSystem& emergencies, const CallLocator& locate,
+                                std::vector<DispatchAssignment>& out);
+
+private:
+    std::size_t cellFor(double x, double y) const;
+    void clamp(double& x, double& y) const;
+    void insertFree(std::size_t index);
+    void removeFree(std::size_t index);
+
+    double width;
+    double height;
+    double cellSize;
+    int columns;
+    int rows;
+
+    std::vector<Ambulance> units;
+    std::vector<std::uint32_t> cellOf;        // per unit
+    std::vector<std::uint32_t> slotOf;        // per unit: position in its cell while free
+    std::vector<std::vector<std::uint32_t>> cells; // free unit indices per cell
+    std::size_t available;
+    std::unordered_map<std::string, std::size_t> indexById;
+};
+
+#endif // DISPATCHENGINE_HPP
@@ -0,0 +1,185 @@
+#include "DuplicateFilter.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+const int BLOOM_HASHES = 7;
+
+std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Splits a "<letter?><digits>" id below DENSE_ID_LIMIT into its prefix
+// ('\0' if none), digit count and number
+bool parseNumericId(std::string_view id, char& prefix, std::size_t& digits, std::uint64_t& value) {
+    std::size_t start = (!id.empty() && (id[0] < '0' || id[0] > '9')) ? 1 : 0;
+    digits = id.size() - start;
+    if (digits == 0 || digits > 8) {
+        return false;
+    }
+    value = 0;
+    for (std::size_t i = start; i < id.size(); ++i) {
+        if (id[i] < '0' || id[i] > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<std::uint64_t>(id[i] - '0');
+    }
+    prefix = start ? id[0] : '\0';
+    return value < DENSE_ID_LIMIT;
+}
+
+} // namespace
+
+DuplicateIdFilter::DuplicateIdFilter(std::size_t expectedIds) : bloomIds(0) {
+    std::uint64_t bits = 64;
+    while (bits < static_cast<std::uint64_t>(expectedIds) * BLOOM_BITS_PER_ID) {
+        bits <<= 1;
+    }
+    bloom.assign(static_cast<std::size_t>(bits / 64), 0);
+    bloomMask = bits - 1;
+}
+
+// Classes are only added in pass 1 (create), so pass 2 routes every id the
+// same way; past MAX_DENSE_ID_CLASSES new classes take the string path
+DuplicateIdFilter::DenseClass* DuplicateIdFilter::denseClass(char prefix, std::size_t digits, bool create) {
+    for (DenseClass& candidate : dense) {
+        if (candidate.prefix == prefix && candidate.digits == digits) {
+            return &candidate;
+        }
+    }
+    if (!create || dense.size() == MAX_DENSE_ID_CLASSES) {
+        return nullptr;
+    }
+    dense.push_back(DenseClass{prefix, digits, {}});
+    return &dense.back();
+}
+
+const DuplicateIdFilter::DenseClass* DuplicateIdFilter::findDenseClass(char prefix, std::size_t digits) const {
+    for (const DenseClass& candidate : dense) {
+        if (candidate.prefix == prefix && candidate.digits == digits) {
+            return &candidate;
+        }
+    }
+    return nullptr;
+}
+
+bool DuplicateIdFilter::bloomInsert(std::string_view id) {
+    std::uint64_t hash = static_cast<std::uint64_t>(std::hash<std::string_view>()(id));
+    std::uint64_t step = mix(hash) | 1;
+    bool present = true;
+    for (int i = 0; i < BLOOM_HASHES; ++i) {
+        std::uint64_t position = (hash + static_cast<std::uint64_t>(i) * step) & bloomMask;
+        std::uint64_t& word = bloom[static_cast<std::size_t>(position >> 6)];
+        std::uint64_t bit = std::uint64_t(1) << (position & 63);
+        present = present && (word & bit) != 0;
+        word |= bit;
+    }
+    return present;
+}
+
+bool DuplicateIdFilter::bloomTest(std::string_view id) const {
+    std::uint64_t hash = static_cast<std::uint64_t>(std::hash<std::string_view>()(id));
+    std::uint64_t step = mix(hash) | 1;
+    for (int i = 0; i < BLOOM_HASHES; ++i) {
+        std::uint64_t position = (hash + static_cast<std::uint64_t>(i) * step) & bloomMask;
+        if ((bloom[static_cast<std::size_t>(position >> 6)] & (std::uint64_t(1) << (position & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DuplicateIdFilter::firstSighting(std::string_view id) {
+    char prefix;
+    std::size_t digits;
+    std::uint64_t value;
+    if (parseNumericId(id, prefix, digits, value)) {
+        if (DenseClass* target = denseClass(prefix, digits, true)) {
+            std::size_t word = static_cast<std::size_t>(value >> 6);
+            if (word >= target->bits.size()) {
+                target->bits.resize(std::max(word + 1, target->bits.size() * 2), 0);
+            }
+            std::uint64_t bit = std::uint64_t(1) << (value & 63);
+            bool seen = (target->bits[word] & bit) != 0;
+            target->bits[word] |= bit;
+            return !seen;
+        }
+    }
+
+    if (bloomInsert(id) && candidates.count(id) == 0) {
+        candidateText.emplace_back(id);
+        candidates.insert(candidateText.back());
+    }
+    return true;
+}
+
+bool DuplicateIdFilter::verify(std::string_view id) {
+    char prefix;
+    std::size_t digits;
+    std::uint64_t value;
+    if (parseNumericId(id, prefix, digits, value) && denseClass(prefix, digits, false)) {
+        return true; // decided exactly in pass 1
+    }
+    auto candidate = candidates.find(id);
+    if (candidate == candidates.end()) {
+        return true;
+    }
+    return verified.insert(*candidate).second;
+}
+
+// Numeric ids take the bitmap of their class, created on first use as in
+// pass 1; an id whose class could not be created goes to the Bloom filter,
+// and lookup finds no class for it either, since classes are never removed
+void DuplicateIdFilter::insert(std::string_view id) {
+    char prefix;
+    std::size_t digits;
+    std::uint64_t value;
+    if (parseNumericId(id, prefix, digits, value)) {
+        if (DenseClass* target = denseClass(prefix, digits, true)) {
+            std::size_t word = static_cast<std::size_t>(value >> 6);
+            if (word >= target->bits.size()) {
+                target->bits.resize(std::max(word + 1, target->bits.size() * 2), 0);
+            }
+            target->bits[word] |= std::uint64_t(1) << (value & 63);
+            return;
+        }
+    }
+    bloomInsert(id);
+    ++bloomIds;
+}
+
+void DuplicateIdFilter::erase(std::string_view id) {
+    char prefix;
+    std::size_t digits;
+    std::uint64_t value;
+    if (parseNumericId(id, prefix, digits, value)) {
+        if (DenseClass* target = denseClass(prefix, digits, false)) {
+            std::size_t word = static_cast<std::size_t>(value >> 6);
+            if (word < target->bits.size()) {
+                target->bits[word] &= ~(std::uint64_t(1) << (value & 63));
+            }
+        }
+    }
+}
+
+DuplicateIdFilter::Lookup DuplicateIdFilter::lookup(std::string_view id) const {
+    char prefix;
+    std::size_t digits;
+    std::uint64_t value;
+    if (parseNumericId(id, prefix, digits, value)) {
+        if (const DenseClass* target = findDenseClass(prefix, digits)) {
+            std::size_t word = static_cast<std::size_t>(value >> 6);
+            bool present = word < target->bits.size() && (target->bits[word] >> (value & 63)) & 1;
+            return present ? Lookup::Present : Lookup::Absent;
+        }
+    }
+    return bloomTest(id) ? Lookup::Maybe : Lookup::Absent;
+}
+
+bool DuplicateIdFilter::saturated() const {
+    return bloomIds * BLOOM_BITS_PER_ID > bloom.size() * 64;
+}
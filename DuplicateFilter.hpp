@@ -0,0 +1,82 @@
+#ifndef DUPLICATEFILTER_HPP
+#define DUPLICATEFILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Numbers below this use a bitmap; larger ones take the string path
+const std::uint64_t DENSE_ID_LIMIT = 1 << 24;
+// Bitmaps kept at most (one per prefix letter and digit count)
+const std::size_t MAX_DENSE_ID_CLASSES = 8;
+// Bloom filter size per expected string id; about 1% false positives
+const std::size_t BLOOM_BITS_PER_ID = 10;
+
+/**
+ * Finds repeated ids in one or two linear passes over a sequence.
+ *
+ * Ids of the form "<letter?><digits>" (like "P00123" or "A05") go to a
+ * bitmap per prefix letter and digit count, indexed by the number: exact
+ * and decided on the first pass. Other ids go through a Bloom filter; an
+ * id it reports as possibly seen becomes a candidate, and a second pass
+ * over the same sequence settles the candidates exactly. Only candidates
+ * are ever stored as strings, so memory stays near BLOOM_BITS_PER_ID bits
+ * per id.
+ *
+ *   DuplicateIdFilter filter(expected);
+ *   pass 1: drop every id for which firstSighting(id) is false
+ *   if (filter.needsVerify())
+ *       pass 2 over the ids kept in pass 1, in the same order:
+ *       drop every id for which verify(id) is false
+ *
+ * The first occurrence of an id is always the one kept.
+ *
+ * The same structure also tracks a changing set of ids (insert, erase,
+ * lookup), e.g. the patients waiting in a queue. Numeric ids are exact and
+ * can be erased. A string id stays in the Bloom filter once inserted, so
+ * lookup can only answer Maybe for it: the owner settles that against its
+ * own records, and rebuilds the filter once saturated() says the stale bits
+ * make such answers common.
+ */
+class DuplicateIdFilter {
+public:
+    enum class Lookup { Absent, Present, Maybe };
+
+    explicit DuplicateIdFilter(std::size_t expectedIds);
+
+    bool firstSighting(std::string_view id); // false: certainly seen before
+    bool needsVerify() const { return !candidates.empty(); }
+    bool verify(std::string_view id);        // false: a later copy of a candidate
+
+    // Set use; not to be mixed with the passes above on one filter
+    void insert(std::string_view id);
+    void erase(std::string_view id);         // no-op for string ids
+    Lookup lookup(std::string_view id) const;
+    bool saturated() const;                  // more string ids inserted than the filter is sized for
+
+private:
+    struct DenseClass {
+        char prefix;
+        std::size_t digits;
+        std::vector<std::uint64_t> bits;
+    };
+
+    DenseClass* denseClass(char prefix, std::size_t digits, bool create);
+    const DenseClass* findDenseClass(char prefix, std::size_t digits) const;
+    bool bloomInsert(std::string_view id);      // true if every bit was already set
+    bool bloomTest(std::string_view id) const;
+
+    std::vector<DenseClass> dense;
+    std::vector<std::uint64_t> bloom;
+    std::uint64_t bloomMask; // bit count - 1 (a power of two)
+    std::size_t bloomIds;    // string ids inserted in set use
+    std::deque<std::string> candidateText;            // owns the candidate ids
+    std::unordered_set<std::string_view> candidates;  // possibly repeated string ids
+    std::unordered_set<std::string_view> verified;    // candidates met in pass 2
+};
+
+#endif // DUPLICATEFILTER_HPP
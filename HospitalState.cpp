@@ -0,0 +1,123 @@
+#include "HospitalState.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+#include "Analytics.hpp"
+#include "SiteShards.hpp"
+#include "WorkStealingPool.hpp"
+
+HospitalState::HospitalState() : suppliesFound(false), scheduleReady(false), undoDepth(DEFAULT_UNDO_DEPTH),
+      backgroundWrites(false), backgroundStarted(false) {}
+
+HospitalState::~HospitalState() {
+    for (std::thread& loader : preloaders) {
+        loader.join();
+    }
+}
+
+HospitalState& HospitalState::instance() {
+    static HospitalState state;
+    return state;
+}
+
+PatientQueue& HospitalState::patients() {
+    // PatientQueue loads its default file in the constructor
+    std::call_once(patientsOnce, [this] {
+        patientStore.reset(new PatientQueue());
+        dischargeStore.reset(new DischargeArchive(DISCHARGE_ARCHIVE_DIR));
+        patientStore->setDischargeArchive(dischargeStore.get());
+        patientStore->enableHistory(undoDepth);
+        if (backgroundWrites) {
+            patientStore->setBackgroundWriter(&background());
+        }
+    });
+    return *patientStore;
+}
+
+SupplyStack& HospitalState::supplies() {
+    std::call_once(suppliesOnce, [this] {
+        supplyStore.reset(new SupplyStack());
+        suppliesFound = supplyStore->loadFromCsv(SUPPLIES_FILENAME);
+        supplyStore->enableHistory(undoDepth);
+        if (backgroundWrites) {
+            supplyStore->setBackgroundWriter(&background());
+        }
+    });
+    return *supplyStore;
+}
+
+EmergencyDepartmentSystem& HospitalState::emergencies() {
+    std::call_once(emergenciesOnce, [this] {
+        emergencyStore.reset(new EmergencyDepartmentSystem());
+        emergencyStore->loadAgingPolicies(AGING_FILENAME); // optional; defaults apply without it
+    });
+    return *emergencyStore;
+}
+
+AmbulanceScheduler& HospitalState::ambulances() {
+    std::call_once(ambulancesOnce, [this] {
+        ambulanceStore.reset(new AmbulanceScheduler());
+        scheduleReady = ambulanceStore->loadScheduleFromCsv(SCHEDULE_FILENAME);
+        ambulanceStore->enableHistory(undoDepth);
+        if (backgroundWrites) {
+            ambulanceStore->setBackgroundWriter(&background());
+        }
+    });
+    return *ambulanceStore;
+}
+
+AnalyticsSnapshotter& HospitalState::analytics() {
+    std::call_once(analyticsOnce, [this] {
+        analyticsStore.reset(new AnalyticsSnapshotter(ANALYTICS_DIR));
+    });
+    return *analyticsStore;
+}
+
+SiteRouter& HospitalState::sites() {
+    std::call_once(sitesOnce, [this] {
+        siteRouter.reset(new SiteRouter(SITES_DIR, undoDepth));
+    });
+    return *siteRouter;
+}
+
+WorkStealingPool& HospitalState::background() {
+    std::call_once(backgroundOnce, [this] {
+        backgroundPool.reset(new WorkStealingPool());
+        backgroundStarted = true;
+    });
+    return *backgroundPool;
+}
+
+void HospitalState::enableBackgroundWrites() {
+    backgroundWrites = true;
+}
+
+void HospitalState::flushBackground() {
+    if (backgroundStarted) {
+        backgroundPool->flush();
+    }
+}
+
+void HospitalState::setUndoDepth(std::size_t depth) {
+    undoDepth = depth;
+}
+
+bool HospitalState::suppliesFileFound() {
+    supplies();
+    return suppliesFound;
+}
+
+bool HospitalState::scheduleFileReady() {
+    ambulances();
+    return scheduleReady;
+}
+
+void HospitalState::preloadInBackground() {
+    std::call_once(preloadOnce, [this] {
+        preloaders.emplace_back([this] { patients(); });
+        preloaders.emplace_back([this] { supplies(); });
+        preloaders.emplace_back([this] { ambulances(); });
+        preloaders.emplace_back([this] { emergencies(); });
+    });
+}
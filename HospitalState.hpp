@@ -0,0 +1,109 @@
+#ifndef HOSPITALSTATE_HPP
+#define HOSPITALSTATE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PatientQueue;
+class SupplyStack;
+class EmergencyDepartmentSystem;
+class AmbulanceScheduler;
+class DischargeArchive;
+class AnalyticsSnapshotter;
+class SiteRouter;
+class WorkStealingPool;
+
+/**
+ * Process-wide registry owning one instance of each role store.
+ *
+ * Each store is created and loaded from its data file the first time it is
+ * requested (or by preloadInBackground()) and then stays in memory for the
+ * rest of the process, so switching between menus costs nothing.
+ * Loading is guarded by std::call_once: a caller that arrives while the
+ * background preload is still reading a file simply waits for it.
+ * After loading, the stores are meant to be used from one thread at a time.
+ */
+class HospitalState {
+public:
+    static HospitalState& instance();
+
+    PatientQueue& patients();
+    SupplyStack& supplies();
+    EmergencyDepartmentSystem& emergencies();
+    AmbulanceScheduler& ambulances();
+
+    // Background exporter writing columnar snapshots to ANALYTICS_DIR
+    AnalyticsSnapshotter& analytics();
+
+    // Shards of the other sites under SITES_DIR, each with its own stores
+    SiteRouter& sites();
+
+    // Pool for file writes and metric dumps off the calling thread
+    WorkStealingPool& background();
+
+    /**
+     * Makes the menu save paths of the patient, supply and ambulance stores
+     * created after the call write through background(); supply saves that
+     * only touch the changed rows stay on the calling thread. Waiting for
+     * those writes is up to the caller
+     * (flushBackground(), or the pool itself when the process exits).
+     */
+    void enableBackgroundWrites();
+    void flushBackground(); // no-op while background() was never used
+
+    /**
+     * Undo steps the patient, supply and ambulance stores keep
+     * (DEFAULT_UNDO_DEPTH unless set; 0 turns undo off). Applies to stores
+     * created after the call, so set it before the first store is requested.
+     */
+    void setUndoDepth(std::size_t depth);
+
+    // Load results, for the messages the menus print on entry
+    bool suppliesFileFound();
+    bool scheduleFileReady();
+
+    /**
+     * Starts loading every store in the background, one thread per store so
+     * the data files are read at the same time. Safe to call once at
+     * startup; later calls are ignored.
+     */
+    void preloadInBackground();
+
+    HospitalState(const HospitalState&) = delete;
+    HospitalState& operator=(const HospitalState&) = delete;
+
+private:
+    HospitalState();
+    ~HospitalState();
+
+    std::once_flag patientsOnce;
+    std::once_flag suppliesOnce;
+    std::once_flag emergenciesOnce;
+    std::once_flag ambulancesOnce;
+    std::once_flag analyticsOnce;
+    std::once_flag sitesOnce;
+    std::once_flag backgroundOnce;
+    std::once_flag preloadOnce;
+
+    std::unique_ptr<PatientQueue> patientStore;
+    std::unique_ptr<SupplyStack> supplyStore;
+    std::unique_ptr<EmergencyDepartmentSystem> emergencyStore;
+    std::unique_ptr<AmbulanceScheduler> ambulanceStore;
+    std::unique_ptr<DischargeArchive> dischargeStore; // history of patientStore
+    std::unique_ptr<AnalyticsSnapshotter> analyticsStore;
+    std::unique_ptr<SiteRouter> siteRouter;
+    bool suppliesFound;
+    bool scheduleReady;
+    std::size_t undoDepth;
+    bool backgroundWrites;
+    std::atomic<bool> backgroundStarted;
+    std::unique_ptr<WorkStealingPool> backgroundPool; // destroyed before the stores, so it flushes first
+
+    std::vector<std::thread> preloaders;
+};
+
+#endif // HOSPITALSTATE_HPP
@@ -0,0 +1,543 @@
+#include "IpcServer.hpp"
+#include "CommandMode.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+#include "HospitalState.hpp"
+#include "Metrics.hpp"
+#include "SiteShards.hpp"
+#include "WorkStealingPool.hpp"
+#include <iostream>
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const int MAX_EVENTS = 64;
+const std::size_t READ_CHUNK = 64 * 1024;
+const std::size_t MAX_PENDING_INPUT = 1024 * 1024; // bytes without a newline before a client is dropped
+const std::size_t MAX_PENDING_OUTPUT = 1024 * 1024; // unsent bytes at which a client's requests wait for it to read
+
+// Per-client buffers and session; requests are answered in arrival order
+struct Connection {
+    int fd = -1;
+    std::uint64_t serial = 0;  // tells a reused fd from the client a response was meant for
+    std::string in;
+    std::string out;
+    std::size_t outOffset = 0;
+    bool closing = false;      // QUIT received, close after output drains
+    bool peerClosed = false;
+    std::uint32_t interest = EPOLLIN; // events currently registered
+    bool waiting = false;      // a deferred response is being prepared; later requests wait
+    CommandSession session;    // SITE selection and UNDO order of this client
+};
+
+bool outputBacklogged(const Connection& c) {
+    return c.out.size() - c.outOffset >= MAX_PENDING_OUTPUT;
+}
+
+// Responses of deferred commands (HISTORY) finished on the background pool;
+// the eventfd wakes the event loop to pick them up
+struct DeferredResults {
+    struct Result {
+        int fd;
+        std::uint64_t serial;
+        std::string response;
+    };
+
+    std::mutex mutex;
+    std::vector<Result> finished;
+    int eventFd = -1;
+
+    void finish(Result result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::move(result));
+        }
+        std::uint64_t one = 1;
+        ssize_t written = ::write(eventFd, &one, sizeof(one));
+        (void)written; // a full counter already wakes the loop
+    }
+
+    void take(std::vector<Result>& results) {
+        std::uint64_t count;
+        while (::read(eventFd, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count))) {
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        results.swap(finished);
+    }
+};
+
+bool fillAddress(const std::string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cout << "Error: socket path '" << path << "' is empty or too long.\n";
+        return false;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Write as much pending output as the socket accepts, or drop it if the client
+// hung up. Returns false on a fatal error.
+bool flushOutput(Connection& c) {
+    while (c.outOffset < c.out.size()) {
+        ssize_t n = ::send(c.fd, c.out.data() + c.outOffset, c.out.size() - c.outOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.outOffset += static_cast<std::size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (c.outOffset >= MAX_PENDING_OUTPUT) { // a client that never catches up
+                c.out.erase(0, c.outOffset);
+                c.outOffset = 0;
+            }
+            return true;
+        } else if (n < 0 && (errno == EPIPE || errno == ECONNRESET)) {
+            c.peerClosed = true; // its requests still run, their responses are dropped
+            break;
+        } else {
+            return false;
+        }
+    }
+    c.out.clear();
+    c.outOffset = 0;
+    return true;
+}
+
+// Read everything currently available. Returns false on a fatal error.
+bool readInput(Connection& c, char* buffer) {
+    while (true) {
+        ssize_t n = ::recv(c.fd, buffer, READ_CHUNK, 0);
+        if (n > 0) {
+            c.in.append(buffer, static_cast<std::size_t>(n));
+        } else if (n == 0 || errno == ECONNRESET) { // reset: it left responses unread
+            c.peerClosed = true;
+            return true;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+// Execute every complete request line buffered for this client. A deferred
+// response goes to pool, and the lines after it wait until it is back; so do
+// the lines after MAX_PENDING_OUTPUT unsent bytes, until the client reads.
+// Responses to a client that hung up are dropped. Returns true when requests
+// were left waiting for output to drain.
+bool processRequests(Connection& c, CommandProcessor& processor, std::string& line,
+                     WorkStealingPool& pool, DeferredResults& results) {
+    std::size_t start = 0;
+    DeferredResponse deferred;
+    bool backlogged = false;
+    processor.setSession(&c.session);
+    while (!c.closing && !c.waiting) {
+        if (c.peerClosed) {
+            c.out.clear();
+            c.outOffset = 0;
+        } else if (outputBacklogged(c)) {
+            backlogged = c.in.find('\n', start) != std::string::npos;
+            break;
+        }
+        std::size_t newline = c.in.find('\n', start);
+        if (newline == std::string::npos) {
+            break;
+        }
+        line.assign(c.in, start, newline - start);
+        start = newline + 1;
+        if (!processor.execute(line, c.out, deferred)) {
+            c.closing = true;
+        }
+        if (deferred) {
+            c.waiting = true;
+            int fd = c.fd;
+            std::uint64_t serial = c.serial;
+            pool.submit([&results, fd, serial, work = std::move(deferred)] {
+                results.finish(DeferredResults::Result{fd, serial, work()});
+            });
+            deferred = nullptr;
+        }
+    }
+    processor.setSession(nullptr);
+    if (c.peerClosed) {
+        c.out.clear();
+        c.outOffset = 0;
+    }
+    c.in.erase(0, c.closing ? c.in.size() : start);
+    return backlogged;
+}
+
+// Reads only while requests can run, so a client that does not read its
+// responses (or waits on HISTORY) is held back by its own socket buffer
+void updateInterest(int epollFd, Connection& c) {
+    std::uint32_t wanted = 0;
+    if (!c.waiting && !outputBacklogged(c)) {
+        wanted |= EPOLLIN;
+    }
+    if (!c.out.empty()) {
+        wanted |= EPOLLOUT;
+    }
+    if (wanted == c.interest) {
+        return;
+    }
+    epoll_event ev{};
+    ev.events = wanted;
+    ev.data.fd = c.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.interest = wanted;
+}
+
+} // namespace
+
+int runServer(const std::string& socketPath) {
+    sockaddr_un addr;
+    if (!fillAddress(socketPath, addr)) {
+        return 1;
+    }
+
+    // Deliver SIGINT/SIGTERM (stop) and SIGUSR1 (dump metrics) through the
+    // event loop instead of a handler. Blocked first, so every thread started
+    // below (loaders, export, sites, pool) inherits the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+    HospitalState& state = HospitalState::instance();
+    state.enableBackgroundWrites();
+    state.preloadInBackground();
+    CommandProcessor processor(state.patients(), state.supplies(), state.emergencies(),
+                               state.ambulances(), SUPPLIES_FILENAME, SCHEDULE_FILENAME);
+    processor.setSnapshotter(&state.analytics());
+    state.sites().openExisting();
+    processor.setSiteRouter(&state.sites());
+    processor.setQueuedSaves(true); // SAVE must not stall the event loop on disk
+    WorkStealingPool& background = state.background();
+    int signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    DeferredResults deferredResults;
+    deferredResults.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ::unlink(socketPath.c_str());
+    if (listenFd < 0 || signalFd < 0 || deferredResults.eventFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        std::cout << "Error: unable to listen on '" << socketPath << "': " << std::strerror(errno) << "\n";
+        if (listenFd >= 0) ::close(listenFd);
+        if (signalFd >= 0) ::close(signalFd);
+        if (deferredResults.eventFd >= 0) ::close(deferredResults.eventFd);
+        return 1;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = signalFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &ev);
+    ev.data.fd = deferredResults.eventFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, deferredResults.eventFd, &ev);
+
+    std::cout << "Serving on '" << socketPath << "' (Ctrl+C to stop)." << std::endl;
+
+    std::unordered_map<int, Connection> connections;
+    std::vector<char> readBuffer(READ_CHUNK);
+    std::vector<DeferredResults::Result> finished;
+    std::string line;
+    epoll_event events[MAX_EVENTS];
+    std::uint64_t nextSerial = 0;
+    bool running = true;
+
+    auto closeConnection = [&](int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    };
+
+    // Runs what is buffered, sends what it can, and closes the client once it
+    // is done. A client that hung up is dropped with its unsent output, but
+    // only after a deferred response in flight has let its last requests run.
+    auto serve = [&](Connection& c, bool healthy) {
+        bool backlogged = true;
+        while (backlogged) {
+            backlogged = processRequests(c, processor, line, background, deferredResults);
+            healthy = healthy && (c.peerClosed || flushOutput(c));
+            backlogged = backlogged && healthy && c.out.empty(); // drained at once: no EPOLLOUT to resume on
+        }
+        if (c.in.size() > MAX_PENDING_INPUT && c.in.find('\n') == std::string::npos) healthy = false;
+
+        if (!healthy || (c.peerClosed && !c.waiting) || (c.closing && c.out.empty())) {
+            closeConnection(c.fd);
+        } else if (c.peerClosed) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr); // no more input; wait for the response
+        } else {
+            updateInterest(epollFd, c);
+        }
+    };
+
+    while (running) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+
+            if (fd == signalFd) {
+                signalfd_siginfo info;
+                while (::read(signalFd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+                    if (info.ssi_signo == SIGUSR1) {
+                        if (!metricsOutput().empty()) {
+                            background.submitLatest(metricsOutput(), [] { dumpMetrics(metricsOutput()); });
+                        }
+                    } else {
+                        running = false;
+                    }
+                }
+                continue;
+            }
+
+            if (fd == deferredResults.eventFd) {
+                deferredResults.take(finished);
+                for (DeferredResults::Result& result : finished) {
+                    auto it = connections.find(result.fd);
+                    if (it == connections.end() || it->second.serial != result.serial) {
+                        continue; // the client is gone
+                    }
+                    Connection& c = it->second;
+                    c.out += result.response;
+                    c.waiting = false;
+                    serve(c, true);
+                }
+                finished.clear();
+                continue;
+            }
+
+            if (fd == listenFd) {
+                while (true) {
+                    int clientFd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (clientFd < 0) break;
+                    epoll_event clientEv{};
+                    clientEv.events = EPOLLIN;
+                    clientEv.data.fd = clientFd;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &clientEv);
+                    Connection& c = connections[clientFd];
+                    c.fd = clientFd;
+                    c.serial = ++nextSerial;
+                }
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            Connection& c = it->second;
+
+            bool healthy = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                healthy = readInput(c, readBuffer.data());
+            }
+            serve(c, healthy);
+        }
+    }
+
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    ::close(epollFd);
+    ::close(listenFd);
+    ::close(signalFd);
+    ::unlink(socketPath.c_str());
+
+    background.flush(); // deferred responses included, so the eventfd outlives their writes
+    ::close(deferredResults.eventFd);
+    bool saved = processor.commit();
+    std::cout << "Server stopped after " << processor.commandsExecuted() << " requests.\n";
+    return saved ? 0 : 1;
+}
+
+namespace {
+
+// Latencies and error count collected by one load-generator connection
+struct ClientResult {
+    std::vector<double> latenciesUs;
+    std::size_t errorResponses = 0;
+    bool ok = false;
+};
+
+// Request mix: adds and removes are balanced so the stores stay bounded
+void appendRequest(std::string& batch, int client, int seq) {
+    std::string tag = std::to_string(client) + "-" + std::to_string(seq);
+    switch (seq % 8) {
+        case 0: batch += "ADMIT L" + tag + ",LOADGEN,FEVER\n"; break;
+        case 1: batch += "LOG LOADGEN,TRAUMA," + std::to_string(seq % 5 + 1) + "\n"; break;
+        case 2: batch += "ADD GAUZE,1,B" + tag + "\n"; break;
+        case 3: batch += "PROCESS\n"; break;
+        case 4: batch += "DISCHARGE\n"; break;
+        case 5: batch += "USE\n"; break;
+        case 6: batch += "ROTATE\n"; break;
+        default: batch += "LOG LOADGEN,BURN," + std::to_string(seq % 5 + 1) + "\nPROCESS\n"; break;
+    }
+}
+
+bool sendAll(int fd, const std::string& data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void runClient(const LoadGenOptions& options, int client, ClientResult& result) {
+    sockaddr_un addr;
+    if (!fillAddress(options.socketPath, addr)) return;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0) ::close(fd);
+        return;
+    }
+
+    result.latenciesUs.reserve(static_cast<std::size_t>(options.requestsPerClient) + 8);
+    std::string batch;
+    std::vector<char> buffer(READ_CHUNK);
+    std::size_t partialStart = 0; // bytes of an incomplete response carried over
+    bool lastWasErr = false;
+    int seq = 0;
+
+    while (seq < options.requestsPerClient) {
+        batch.clear();
+        int end = std::min(options.requestsPerClient, seq + options.pipelineDepth);
+        for (; seq < end; ++seq) {
+            appendRequest(batch, client, seq);
+        }
+        std::size_t expected = static_cast<std::size_t>(std::count(batch.begin(), batch.end(), '\n'));
+
+        auto sentAt = std::chrono::steady_clock::now();
+        if (!sendAll(fd, batch)) {
+            ::close(fd);
+            return;
+        }
+
+        std::size_t received = 0;
+        while (received < expected) {
+            ssize_t n = ::recv(fd, buffer.data(), buffer.size(), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sentAt).count();
+            for (ssize_t i = 0; i < n; ++i) {
+                if (partialStart == 0) {
+                    lastWasErr = buffer[static_cast<std::size_t>(i)] == 'E';
+                }
+                ++partialStart;
+                if (buffer[static_cast<std::size_t>(i)] == '\n') {
+                    result.latenciesUs.push_back(us);
+                    if (lastWasErr) ++result.errorResponses;
+                    partialStart = 0;
+                    ++received;
+                }
+            }
+        }
+    }
+
+    ::close(fd);
+    result.ok = true;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    std::size_t index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+} // namespace
+
+int runLoadGenerator(const LoadGenOptions& options) {
+    if (options.clients < 1 || options.requestsPerClient < 1 || options.pipelineDepth < 1) {
+        std::cout << "Error: clients, requests and pipeline depth must be positive.\n";
+        return 1;
+    }
+
+    std::vector<ClientResult> results(static_cast<std::size_t>(options.clients));
+    std::vector<std::thread> threads;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.clients; ++i) {
+        threads.emplace_back(runClient, std::cref(options), i, std::ref(results[static_cast<std::size_t>(i)]));
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<double> all;
+    std::size_t errors = 0;
+    int failedClients = 0;
+    for (const ClientResult& r : results) {
+        all.insert(all.end(), r.latenciesUs.begin(), r.latenciesUs.end());
+        errors += r.errorResponses;
+        if (!r.ok) ++failedClients;
+    }
+    std::sort(all.begin(), all.end());
+
+    std::cout << "clients=" << options.clients
+              << " pipeline=" << options.pipelineDepth
+              << " responses=" << all.size()
+              << " err_responses=" << errors
+              << " seconds=" << seconds
+              << " throughput=" << static_cast<long long>(seconds > 0.0 ? all.size() / seconds : 0.0) << " ops/sec\n"
+              << "latency_us p50=" << percentile(all, 0.50)
+              << " p99=" << percentile(all, 0.99)
+              << " p99.9=" << percentile(all, 0.999)
+              << " max=" << (all.empty() ? 0.0 : all.back()) << "\n";
+    if (failedClients > 0) {
+        std::cout << "Error: " << failedClients << " client(s) could not complete (is the server running?).\n";
+        return 1;
+    }
+    return 0;
+}
+
+#else // !__linux__
+
+int runServer(const std::string&) {
+    std::cout << "Error: server mode needs Linux (epoll and Unix domain sockets).\n";
+    return 1;
+}
+
+int runLoadGenerator(const LoadGenOptions&) {
+    std::cout << "Error: load generator needs Linux (Unix domain sockets).\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef IPCSERVER_HPP
+#define IPCSERVER_HPP
+
+#include <string>
+
+// Default Unix domain socket used by --serve and --loadgen
+const char* const DEFAULT_SOCKET_PATH = "/tmp/hospital.sock";
+
+// Settings for the load-generator client
+struct LoadGenOptions {
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    int clients = 8;            // concurrent connections, one thread each
+    int requestsPerClient = 100000;
+    int pipelineDepth = 32;     // requests in flight per connection
+};
+
+/**
+ * Serves all four role stores to local clients over a Unix domain socket.
+ *
+ * Framing is the command-mode line protocol (see CommandMode.hpp): each
+ * request is one '\n'-terminated command line and produces exactly one
+ * response line, in request order, so clients may pipeline freely.
+ * A single epoll thread owns the stores, so requests never need locks.
+ * Each client has its own SITE selection and UNDO order (see CommandSession).
+ * A client that leaves responses unread stops being read from once they
+ * pass a cap, so it cannot hold memory or hold up the others.
+ * It never waits on the disk: saves go to the background writers, and
+ * HISTORY reads the discharge archive on the background pool while later
+ * requests of that client wait (other clients keep being served).
+ * SIGINT/SIGTERM stop the server; stores are saved on the way out.
+ * SIGUSR1 writes the --metrics-out file.
+ * Returns a process exit code.
+ */
+int runServer(const std::string& socketPath);
+
+/**
+ * Drives a running server with a mixed request stream from several
+ * connections and prints throughput plus p50/p99/p99.9 latency.
+ * Returns a process exit code.
+ */
+int runLoadGenerator(const LoadGenOptions& options);
+
+#endif // IPCSERVER_HPP
@@ -0,0 +1,247 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const char* const METRIC_NAMES[static_cast<int>(MetricId::Count)] = {
+    "patient_save", "patient_load", "supply_save", "supply_load",
+    "schedule_save", "schedule_load", "triage_process",
+    "dispatch_assign"
+};
+
+const int METRIC_COUNT = static_cast<int>(MetricId::Count);
+
+const int SUB_BUCKET_BITS = 3;
+const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+const int BUCKET_COUNT = LATENCY_BUCKET_COUNT; // reaches ~2^42 ns (~73 min)
+
+int highestBit(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * One thread's metrics. Only the owning thread writes; the dumper reads with
+ * relaxed loads, so a dump taken mid-operation may be one sample behind.
+ */
+struct Shard {
+    std::atomic<std::uint64_t> count[METRIC_COUNT];
+    std::atomic<std::uint64_t> sumNs[METRIC_COUNT];
+    std::atomic<std::uint64_t> maxNs[METRIC_COUNT];
+    std::atomic<std::uint64_t> buckets[METRIC_COUNT][BUCKET_COUNT];
+
+    Shard() {
+        for (int m = 0; m < METRIC_COUNT; ++m) {
+            count[m].store(0, std::memory_order_relaxed);
+            sumNs[m].store(0, std::memory_order_relaxed);
+            maxNs[m].store(0, std::memory_order_relaxed);
+            for (int b = 0; b < BUCKET_COUNT; ++b) {
+                buckets[m][b].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// Shards outlive their threads so samples from finished threads still count
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::string outputPath;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry(); // never destroyed: used from atexit
+    return *instance;
+}
+
+Shard& localShard() {
+    thread_local Shard* shard = nullptr;
+    if (shard == nullptr) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.shards.emplace_back(new Shard());
+        shard = r.shards.back().get();
+    }
+    return *shard;
+}
+
+// Owner-only increment: a plain load/store pair avoids a locked instruction
+void bump(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+#ifdef HOSPITAL_METRICS
+
+struct Summary {
+    std::uint64_t count = 0;
+    std::uint64_t sumNs = 0;
+    std::uint64_t maxNs = 0;
+    std::vector<std::uint64_t> buckets = std::vector<std::uint64_t>(BUCKET_COUNT, 0);
+
+    double quantileNs(double q) const {
+        if (count == 0) return 0.0;
+        std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (int b = 0; b < BUCKET_COUNT; ++b) {
+            seen += buckets[static_cast<std::size_t>(b)];
+            if (seen >= rank) {
+                return std::min(latencyBucketValue(b), static_cast<double>(maxNs));
+            }
+        }
+        return static_cast<double>(maxNs);
+    }
+};
+
+std::vector<Summary> collect() {
+    std::vector<Summary> summaries(METRIC_COUNT);
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::unique_ptr<Shard>& shard : r.shards) {
+        for (int m = 0; m < METRIC_COUNT; ++m) {
+            Summary& s = summaries[static_cast<std::size_t>(m)];
+            s.count += shard->count[m].load(std::memory_order_relaxed);
+            s.sumNs += shard->sumNs[m].load(std::memory_order_relaxed);
+            s.maxNs = std::max(s.maxNs, shard->maxNs[m].load(std::memory_order_relaxed));
+            for (int b = 0; b < BUCKET_COUNT; ++b) {
+                s.buckets[static_cast<std::size_t>(b)] += shard->buckets[m][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return summaries;
+}
+
+const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+void writePrometheus(std::ofstream& out, const std::vector<Summary>& summaries) {
+    char line[256];
+    out << "# HELP hospital_operation_seconds Latency of instrumented hospital operations.\n"
+        << "# TYPE hospital_operation_seconds summary\n";
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+        const Summary& s = summaries[static_cast<std::size_t>(m)];
+        for (double q : QUANTILES) {
+            std::snprintf(line, sizeof(line), "hospital_operation_seconds{op=\"%s\",quantile=\"%g\"} %.9f\n",
+                          METRIC_NAMES[m], q, s.quantileNs(q) * 1e-9);
+            out << line;
+        }
+        std::snprintf(line, sizeof(line), "hospital_operation_seconds_sum{op=\"%s\"} %.9f\n",
+                      METRIC_NAMES[m], static_cast<double>(s.sumNs) * 1e-9);
+        out << line;
+        std::snprintf(line, sizeof(line), "hospital_operation_seconds_count{op=\"%s\"} %llu\n",
+                      METRIC_NAMES[m], static_cast<unsigned long long>(s.count));
+        out << line;
+    }
+    out << "# HELP hospital_operation_max_seconds Slowest observation per operation.\n"
+        << "# TYPE hospital_operation_max_seconds gauge\n";
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+        std::snprintf(line, sizeof(line), "hospital_operation_max_seconds{op=\"%s\"} %.9f\n",
+                      METRIC_NAMES[m], static_cast<double>(summaries[static_cast<std::size_t>(m)].maxNs) * 1e-9);
+        out << line;
+    }
+}
+
+void writeJson(std::ofstream& out, const std::vector<Summary>& summaries) {
+    char line[512];
+    out << "{\"metrics\":[";
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+        const Summary& s = summaries[static_cast<std::size_t>(m)];
+        std::snprintf(line, sizeof(line),
+                      "%s\n{\"op\":\"%s\",\"count\":%llu,\"sum_ns\":%llu,\"max_ns\":%llu,"
+                      "\"p50_ns\":%.0f,\"p90_ns\":%.0f,\"p99_ns\":%.0f,\"p999_ns\":%.0f}",
+                      m == 0 ? "" : ",", METRIC_NAMES[m],
+                      static_cast<unsigned long long>(s.count), static_cast<unsigned long long>(s.sumNs),
+                      static_cast<unsigned long long>(s.maxNs),
+                      s.quantileNs(0.5), s.quantileNs(0.9), s.quantileNs(0.99), s.quantileNs(0.999));
+        out << line;
+    }
+    out << "\n]}\n";
+}
+
+#endif // HOSPITAL_METRICS
+
+void dumpAtExit() {
+    const std::string& path = registry().outputPath;
+    if (!path.empty()) {
+        dumpMetrics(path);
+    }
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+int latencyBucketFor(std::uint64_t ns) {
+    if (ns < static_cast<std::uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(ns);
+    }
+    int exponent = highestBit(ns);
+    int sub = static_cast<int>((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    int index = (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    return std::min(index, BUCKET_COUNT - 1);
+}
+
+double latencyBucketValue(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int sub = index % SUB_BUCKETS;
+    double width = static_cast<double>(1ULL << (exponent - SUB_BUCKET_BITS));
+    return static_cast<double>(SUB_BUCKETS + sub) * width + width / 2.0;
+}
+
+void recordMetric(MetricId id, std::uint64_t nanoseconds) {
+    int m = static_cast<int>(id);
+    Shard& shard = localShard();
+    bump(shard.count[m], 1);
+    bump(shard.sumNs[m], nanoseconds);
+    bump(shard.buckets[m][latencyBucketFor(nanoseconds)], 1);
+    if (nanoseconds > shard.maxNs[m].load(std::memory_order_relaxed)) {
+        shard.maxNs[m].store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+bool dumpMetrics(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    bool json = endsWith(path, ".json");
+#ifdef HOSPITAL_METRICS
+    std::vector<Summary> summaries = collect();
+    if (json) {
+        writeJson(out, summaries);
+    } else {
+        writePrometheus(out, summaries);
+    }
+#else
+    out << (json ? "{\"metrics\":[],\"note\":\"built without HOSPITAL_METRICS\"}\n"
+                 : "# metrics disabled: built without HOSPITAL_METRICS\n");
+#endif
+    return static_cast<bool>(out);
+}
+
+void setMetricsOutput(const std::string& path) {
+    static std::once_flag registered;
+    registry().outputPath = path;
+    std::call_once(registered, [] { std::atexit(dumpAtExit); });
+}
+
+const std::string& metricsOutput() {
+    return registry().outputPath;
+}
@@ -0,0 +1,75 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Low-overhead operation metrics.
+ *
+ * Each thread records into its own shard (a call count plus a log-linear
+ * latency histogram per metric, ~12% relative precision), so the hot path
+ * takes no locks and shares no cache lines with other threads. Shards are
+ * only merged when a dump is written.
+ *
+ * Recording is compiled in when HOSPITAL_METRICS is defined (the CMake
+ * option HOSPITAL_ENABLE_METRICS); otherwise HOSPITAL_METRIC_SCOPE expands
+ * to nothing and dumps only contain a note that metrics are disabled.
+ */
+
+enum class MetricId {
+    PatientSave,
+    PatientLoad,
+    SupplySave,
+    SupplyLoad,
+    ScheduleSave,
+    ScheduleLoad,
+    TriageProcess,
+    DispatchAssign,
+    Count
+};
+
+// Log-linear histogram layout shared with other latency statistics:
+// values below 8 ns have exact buckets, each power of two above is split in 8.
+const int LATENCY_BUCKET_COUNT = 328;
+int latencyBucketFor(std::uint64_t nanoseconds);
+double latencyBucketValue(int bucket); // midpoint of a bucket, in ns
+
+// Adds one observation of the given duration to the calling thread's shard
+void recordMetric(MetricId id, std::uint64_t nanoseconds);
+
+// Writes all metrics to path: JSON if it ends in ".json", Prometheus text otherwise
+bool dumpMetrics(const std::string& path);
+
+// Remembers where METRICS/SIGUSR1 dumps go and dumps there again at exit
+void setMetricsOutput(const std::string& path);
+const std::string& metricsOutput();
+
+/**
+ * Times the enclosing scope and records it on destruction.
+ */
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricId metric)
+        : id(metric), started(std::chrono::steady_clock::now()) {}
+    ~MetricTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        recordMetric(id, static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    MetricId id;
+    std::chrono::steady_clock::time_point started;
+};
+
+#ifdef HOSPITAL_METRICS
+#define HOSPITAL_METRIC_SCOPE(id) MetricTimer hospitalMetricTimer_(id)
+#else
+#define HOSPITAL_METRIC_SCOPE(id) ((void)0)
+#endif
+
+#endif // METRICS_HPP
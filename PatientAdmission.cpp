@@ -1,24 +1,86 @@
 #include "PatientAdmission.hpp"
+#include "TableRenderer.hpp"
+#include "Metrics.hpp"
+#include "WorkStealingPool.hpp"
+#include "DuplicateFilter.hpp"
+
+namespace {
+
+const char* const PATIENT_CSV_HEADER = "Position,Patient ID,Name,Condition Type,Admitted At";
+const size_t HISTORY_STRINGS_SLACK = 64 * 1024; // history arena growth tolerated before compacting
+
+// Local "YYYY-MM-DD HH:MM", or "N/A" for unknown times
+string formatLocalTime(int64_t seconds) {
+    time_t value = static_cast<time_t>(seconds);
+    char buffer[32];
+    tm local;
+#ifdef _WIN32
+    bool converted = localtime_s(&local, &value) == 0;
+#else
+    bool converted = localtime_r(&value, &local) != nullptr; // shards format on their own threads
+#endif
+    if (seconds > 0 && converted && strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &local)) {
+        return buffer;
+    }
+    return "N/A";
+}
+
+// Writes records (front first) as the queue file; count 0 writes the empty-queue marker
+template <typename Records>
+bool writePatientFile(const string& filename, const Records& records, size_t count) {
+    HOSPITAL_METRIC_SCOPE(MetricId::PatientSave);
+    ofstream outFile(filename);
+    
+    if (!outFile) {
+        cout << "Error: Unable to create file!" << endl;
+        return false;
+    }
+    
+    // Write CSV header
+    // ('\n' instead of endl so large queues are not flushed once per row)
+    outFile << PATIENT_CSV_HEADER << '\n';
+    if (count == 0) {
+        outFile << "No patients in queue" << '\n';
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        const PatientRecord& current = records[i];
+        outFile << (i + 1) << ',';
+        outFile.write(current.id.data(), static_cast<streamsize>(current.id.size())) << ',';
+        outFile.write(current.name.data(), static_cast<streamsize>(current.name.size())) << ',';
+        outFile.write(current.conditionType.data(), static_cast<streamsize>(current.conditionType.size())) << ',';
+        if (current.admittedAt > 0) {
+            outFile << current.admittedAt;
+        }
+        outFile << '\n';
+    }
+    
+    outFile.close();
+    return static_cast<bool>(outFile);
+}
+
+// Copy of the queue handed to the background writer
+struct PatientFileSnapshot {
+    vector<PatientRecord> records;
+    StringArena strings;
+};
+
+} // namespace
 
 // Constructor
-PatientQueue::PatientQueue() : front(nullptr), rear(nullptr), size(0), currentFilename("data/PatientAdmission.csv") {
+PatientQueue::PatientQueue() : currentFilename("data/PatientAdmission.csv"), archive(nullptr), writer(nullptr), historyStringsKept(0), waitingIds(0) {
     // Load existing data from default file on startup
     loadFromFile(currentFilename);
 }
 
-// Destructor
-PatientQueue::~PatientQueue() {
-    // Clear memory without triggering file updates
-    Patient* current = front;
-    while (current != nullptr) {
-        Patient* temp = current;
-        current = current->next;
-        delete temp;
-    }
-    front = rear = nullptr;
-    size = 0;
+// Constructor for a queue backed by a specific file
+PatientQueue::PatientQueue(string filename) : currentFilename(filename), archive(nullptr), writer(nullptr), historyStringsKept(0), waitingIds(0) {
+    loadFromFile(currentFilename);
 }
 
+// Destructor (no file update; the queue releases its own storage)
+PatientQueue::~PatientQueue() {}
+
 // Helper function to convert string to uppercase
 string PatientQueue::toUpperCase(string str) {
     transform(str.begin(), str.end(), str.begin(), ::toupper);
@@ -38,60 +100,190 @@ void PatientQueue::admitPatient(string id, string name, string conditionType) {
     name = toUpperCase(name);
     conditionType = toUpperCase(conditionType);
     
-    Patient* newPatient = new Patient(id, name, conditionType);
-    
-    if (isEmpty()) {
-        front = rear = newPatient;
-    } else {
-        rear->next = newPatient;
-        rear = newPatient;
+    if (!appendPatient(id, name, conditionType)) {
+        cout << "Error: a patient with ID " << id << " is already waiting." << endl;
+        return;
     }
-    
-    size++;
     cout << "Patient admitted: " << name << " (ID: " << id << ", Condition: " << conditionType << ")" << endl;
     
     // Auto-update file
-    saveToFile(currentFilename);
+    persistLater();
 }
 
-// Function: removes earliest admitted patient
-bool PatientQueue::dischargePatient() {
-    loadFromFile(currentFilename);
-    
+// Append an already-normalized patient to the rear of the queue.
+// Used by bulk paths that persist once at the end instead of per patient.
+bool PatientQueue::appendPatient(const string& id, const string& name, const string& conditionType) {
+    return appendPatient(id, name, conditionType, time(nullptr));
+}
+
+// Same, with a known admission time (0 if unknown)
+bool PatientQueue::appendPatient(const string& id, const string& name, const string& conditionType, time_t admittedAt) {
+    if (isWaiting(id)) {
+        return false;
+    }
+    PatientRecord& record = patients.emplace_back();
+    record.admittedAt = static_cast<int64_t>(admittedAt);
+    record.id.assign(id, arena);
+    record.name.assign(name, arena);
+    record.conditionType.assign(conditionType, arena);
+    noteWaiting(record);
+    if (history) {
+        history->record(VersionEdit::Push, history->current().push_back(historyRecord(record)));
+        history->oldest().releaseOlder();
+        compactHistory();
+    }
+    return true;
+}
+
+// Numeric ids are settled by the filter alone; a string id it may hold is
+// looked for in the queue
+bool PatientQueue::isWaiting(const string& id) const {
+    DuplicateIdFilter::Lookup found = waitingIds.lookup(id);
+    if (found != DuplicateIdFilter::Lookup::Maybe) {
+        return found == DuplicateIdFilter::Lookup::Present;
+    }
+    for (size_t i = 0; i < patients.size(); i++) {
+        const PatientRecord& record = patients[i];
+        if (string_view(record.id.data(), record.id.size()) == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PatientQueue::noteWaiting(const PatientRecord& record) {
+    waitingIds.insert(string_view(record.id.data(), record.id.size()));
+    if (waitingIds.saturated()) {
+        indexIds(); // drops the string ids of discharged patients
+    }
+}
+
+void PatientQueue::indexIds() {
+    waitingIds = DuplicateIdFilter(max<size_t>(patients.size() * 2, 1024));
+    for (size_t i = 0; i < patients.size(); i++) {
+        waitingIds.insert(string_view(patients[i].id.data(), patients[i].id.size()));
+    }
+}
+
+void PatientQueue::assignRecord(PatientRecord& record, const PatientEntry& entry) {
+    record.admittedAt = entry.admittedAt;
+    record.id.assign(entry.id, arena);
+    record.name.assign(entry.name, arena);
+    record.conditionType.assign(entry.conditionType, arena);
+}
+
+void PatientQueue::assignRecord(PatientRecord& record, const PatientRecord& kept) {
+    record = kept;
+    record.forEachString([this](auto& field) { field.moveTo(arena); });
+}
+
+PatientRecord PatientQueue::historyRecord(const PatientRecord& record) {
+    PatientRecord copy = record;
+    copy.forEachString([this](auto& field) { field.moveTo(historyStrings); });
+    return copy;
+}
+
+// Remove the earliest admitted patient without console output or file save
+bool PatientQueue::removeFront(string& id, string& name, string& conditionType) {
     if (isEmpty()) {
-        cout << "No patients in queue to discharge." << endl;
         return false;
     }
     
-    Patient* temp = front;
-    cout << "Discharging patient: " << temp->name << " (ID: " << temp->id << ")" << endl;
-    
-    front = front->next;
-    
-    if (front == nullptr) {
-        rear = nullptr;
+    PatientRecord& first = patients.front();
+    id.assign(first.id.data(), first.id.size());
+    name.assign(first.name.data(), first.name.size());
+    conditionType.assign(first.conditionType.data(), first.conditionType.size());
+    if (archive) {
+        archive->append(DischargeRecord{static_cast<int64_t>(time(nullptr)), first.admittedAt, id, conditionType});
+    }
+    dropFront();
+    if (history) {
+        history->record(VersionEdit::Pop, history->current().pop_front());
+        history->oldest().releaseOlder();
+    }
+    return true;
+}
+
+void PatientQueue::dropFront() {
+    waitingIds.erase(string_view(patients.front().id.data(), patients.front().id.size()));
+    patients.front().forEachString([this](const auto& field) { field.release(arena); });
+    patients.pop_front();
+    reclaimSpilled();
+}
+
+void PatientQueue::dropBack() {
+    waitingIds.erase(string_view(patients.back().id.data(), patients.back().id.size()));
+    patients.back().forEachString([this](const auto& field) { field.release(arena); });
+    patients.pop_back();
+    reclaimSpilled();
+}
+
+// Spilled strings of removed patients stay in the arena until it is cleared
+// (queue empty) or rebuilt from the remaining records (mostly dead)
+void PatientQueue::reclaimSpilled() {
+    if (patients.empty()) {
+        arena.clear();
+    } else if (arena.wantsCompaction()) {
+        StringArena fresh;
+        for (size_t i = 0; i < patients.size(); i++) {
+            patients[i].forEachString([&fresh](auto& field) { field.moveTo(fresh); });
+        }
+        arena.swap(fresh);
+    }
+}
+
+// Function: removes earliest admitted patient
+// (the queue in memory is authoritative; it was loaded once at construction)
+bool PatientQueue::dischargePatient() {
+    string id, name, condition;
+    if (!removeFront(id, name, condition)) {
+        cout << "No patients in queue to discharge." << endl;
+        return false;
     }
     
-    delete temp;
-    size--;
+    cout << "Discharging patient: " << name << " (ID: " << id << ")" << endl;
     
     // Auto-update file
+    persistLater();
     if (isEmpty()) {
-        // If queue is empty, clear the file
-        ofstream clearFile(currentFilename);
-        clearFile << "Position,Patient ID,Name,Condition Type" << endl;
-        clearFile << "No patients in queue" << endl;
-        clearFile.close();
         cout << "File '" << currentFilename << "' updated (queue is now empty)." << endl;
-    } else {
-        saveToFile(currentFilename);
     }
     
     return true;
 }
 
+// Save queue to the default file; an empty queue still rewrites the file
+bool PatientQueue::persist() {
+    if (archive && !archive->flush()) {
+        return false;
+    }
+    return writePatientFile(currentFilename, patients, patients.size());
+}
+
+// Same as persist(), but only the copy of the records is made here
+void PatientQueue::persistLater() {
+    if (!writer) {
+        persist();
+        return;
+    }
+    if (archive) {
+        archive->flushLater(writer);
+    }
+    shared_ptr<PatientFileSnapshot> snapshot = make_shared<PatientFileSnapshot>();
+    snapshotRecords(snapshot->records, snapshot->strings);
+    string filename = currentFilename;
+    writer->submitLatest(filename, [snapshot, filename] {
+        writePatientFile(filename, snapshot->records, snapshot->records.size());
+    });
+}
+
+void PatientQueue::setBackgroundWriter(WorkStealingPool* pool) {
+    writer = pool;
+}
+
 // Load data from CSV file
 bool PatientQueue::loadFromFile(string filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::PatientLoad);
     ifstream inFile(filename);
     
     if (!inFile) {
@@ -99,14 +291,15 @@ bool PatientQueue::loadFromFile(string filename) {
     }
     
     // Clear current queue
-    while (!isEmpty()) {
-        Patient* temp = front;
-        front = front->next;
-        delete temp;
-        size--;
-    }
-    front = rear = nullptr;
-    size = 0;
+    patients.clear();
+    arena.clear();
+    
+    // Rows are at least this long, so this bounds the number of ids
+    inFile.seekg(0, ios::end);
+    streamoff fileSize = inFile.tellg();
+    inFile.seekg(0, ios::beg);
+    DuplicateIdFilter duplicates(fileSize > 0 ? static_cast<size_t>(fileSize / 16) : 0);
+    size_t skipped = 0;
     
     string line;
     bool firstLine = true;
@@ -125,57 +318,79 @@ bool PatientQueue::loadFromFile(string filename) {
         
         // Parse CSV line
         stringstream ss(line);
-        string position, id, name, condition;
+        string position, id, name, condition, admitted;
         
         getline(ss, position, ',');
         getline(ss, id, ',');
         getline(ss, name, ',');
         getline(ss, condition, ',');
+        getline(ss, admitted, ','); // absent in files from before admission times were kept
         
         // Trim whitespace
         id = trim(id);
         name = trim(name);
         condition = trim(condition);
         
-        // Add to queue if data is valid
+        // Add to queue if data is valid; a repeated ID keeps its first row
+        // (admissions reject repeats, so only hand-edited files have them)
         if (!id.empty() && !name.empty() && !condition.empty()) {
-            Patient* newPatient = new Patient(id, name, condition);
-            
-            if (isEmpty()) {
-                front = rear = newPatient;
-            } else {
-                rear->next = newPatient;
-                rear = newPatient;
+            if (!duplicates.firstSighting(id)) {
+                skipped++;
+                continue;
             }
-            size++;
+            long long admittedAt = strtoll(admitted.c_str(), nullptr, 10);
+            assignRecord(patients.emplace_back(), PatientEntry{id, name, condition, admittedAt > 0 ? admittedAt : 0});
         }
     }
     
     inFile.close();
+    if (duplicates.needsVerify()) {
+        // Second pass over the loaded rows settles the possible repeats
+        Queue<PatientRecord> kept;
+        kept.reserve(patients.size());
+        for (size_t i = 0; i < patients.size(); i++) {
+            PatientRecord& record = patients[i];
+            if (duplicates.verify(string_view(record.id.data(), record.id.size()))) {
+                kept.push_back(record);
+            } else {
+                record.forEachString([this](const auto& field) { field.release(arena); });
+                skipped++;
+            }
+        }
+        patients.swap(kept);
+        reclaimSpilled();
+    }
+    if (skipped > 0) {
+        cerr << "Warning: skipped " << skipped << " duplicate patient ID(s) in '" << filename << "'." << endl;
+    }
+    indexIds();
+    recordReset();
     return true;
 }
 
 // Functionality 3: View Patient Queue
 void PatientQueue::viewPatientQueue() {
-    loadFromFile(currentFilename);
-    
     if (isEmpty()) {
         cout << "No patients waiting for treatment." << endl;
         return;
     }
     
-    cout << "\n=== Patient Queue (Total: " << size << ") ===" << endl;
-    Patient* current = front;
-    int position = 1;
+    const ListingPage& page = listingPage();
+    TableRenderer table({{"Position", 10}, {"Patient ID", 15}, {"Name", 25}, {"Condition", 20}});
+    table.line("\n=== Patient Queue (Total: " + to_string(patients.size()) + ") ===");
+    table.header();
     
-    while (current != nullptr) {
-        cout << position << ". ID: " << current->id 
-             << " | Name: " << current->name 
-             << " | Condition: " << current->conditionType << endl;
-        current = current->next;
-        position++;
+    // Rows are indexed directly, so rows before the page are skipped outright
+    for (size_t index = page.offset; index < patients.size() && !page.pastEnd(index); index++) {
+        const PatientRecord& current = patients[index];
+        table.cell(static_cast<long long>(index + 1))
+             .cell(current.id.data(), current.id.size())
+             .cell(current.name.data(), current.name.size())
+             .cell(current.conditionType.data(), current.conditionType.size());
+        table.endRow();
     }
-    cout << "================================\n" << endl;
+    table.pageSummary(page, patients.size());
+    table.line("================================\n");
 }
 
 // Function: Save Patient Queue to File
@@ -183,39 +398,193 @@ bool PatientQueue::saveToFile(string filename) {
     if (isEmpty()) {
         return false;
     }
-    
-    ofstream outFile(filename);
-    
-    if (!outFile) {
-        cout << "Error: Unable to create file!" << endl;
+    return writePatientFile(filename, patients, patients.size());
+}
+
+// Save the queue as a binary record file (front first)
+bool PatientQueue::saveToBinary(const string& filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::PatientSave);
+    return writeRecordFile<PatientRecord>(filename, "HPAT", patients.size(),
+                                          [this](size_t i) { return patients[i]; });
+}
+
+// Replace the queue with a binary record file; the queue is unchanged on failure
+bool PatientQueue::loadFromBinary(const string& filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::PatientLoad);
+    Queue<PatientRecord> loaded;
+    StringArena loadedArena;
+    if (!readRecordFile<PatientRecord>(filename, "HPAT", loadedArena,
+                                       [&loaded](const PatientRecord& record) { loaded.push_back(record); })) {
         return false;
     }
-    
-    // Write CSV header
-    outFile << "Position,Patient ID,Name,Condition Type" << endl;
-    
-    Patient* current = front;
-    int position = 1;
-    
-    while (current != nullptr) {
-        outFile << position << "," 
-                << current->id << "," 
-                << current->name << "," 
-                << current->conditionType << endl;
-        current = current->next;
-        position++;
+    patients.swap(loaded);
+    arena.swap(loadedArena);
+    indexIds();
+    recordReset();
+    return true;
+}
+
+// Copy the records for a reader on another thread; the copies do not point into our arena
+void PatientQueue::snapshotRecords(vector<PatientRecord>& out, StringArena& strings) const {
+    out.reserve(out.size() + patients.size());
+    for (size_t i = 0; i < patients.size(); i++) {
+        out.push_back(patients[i]);
+        out.back().forEachString([&strings](auto& field) { field.moveTo(strings); });
+    }
+}
+
+// Start (or stop) keeping versions; the current contents become version 0
+void PatientQueue::enableHistory(size_t depth) {
+    history.reset();
+    historyStrings.clear();
+    historyStringsKept = 0;
+    if (depth == 0) {
+        return;
+    }
+    history.reset(new VersionHistory<PatientVersion>(currentVersion(), depth));
+}
+
+// Step back one change. Undoing an admission or discharge touches one end
+// of the queue; undoing a load rebuilds it from the previous version.
+bool PatientQueue::undo() {
+    if (!history || !history->canUndo()) {
+        return false;
+    }
+    VersionEdit undone = history->currentEdit();
+    history->undo();
+    const PatientVersion& previous = history->current();
+    if (undone == VersionEdit::Push) {
+        dropBack();
+    } else if (undone == VersionEdit::Pop) {
+        assignRecord(patients.emplace_front(), previous.front());
+        noteWaiting(patients.front());
+    } else {
+        restore(previous);
     }
-    
-    outFile.close();
     return true;
 }
 
+// Repeat an undone change (a redone discharge is not archived twice)
+bool PatientQueue::redo() {
+    if (!history || !history->canRedo()) {
+        return false;
+    }
+    history->redo();
+    const PatientVersion& next = history->current();
+    if (history->currentEdit() == VersionEdit::Push) {
+        assignRecord(patients.emplace_back(), next.back());
+        noteWaiting(patients.back());
+    } else if (history->currentEdit() == VersionEdit::Pop) {
+        dropFront();
+    } else {
+        restore(next);
+    }
+    return true;
+}
+
+const VersionHistory<PatientVersion>* PatientQueue::versions() const {
+    return history.get();
+}
+
+PatientVersion PatientQueue::currentVersion() {
+    PatientVersion version;
+    for (size_t i = 0; i < patients.size(); i++) {
+        version = version.push_back(historyRecord(patients[i]));
+    }
+    return version;
+}
+
+// Versions never give their spilled strings back one by one, so once the
+// history arena has grown well past what survived the last compaction, the
+// kept versions are replayed into a new one (sharing stays as it was)
+void PatientQueue::compactHistory() {
+    if (historyStrings.liveBytes() <= 2 * historyStringsKept + HISTORY_STRINGS_SLACK) {
+        return;
+    }
+    StringArena strings;
+    auto rehome = [&strings](PatientRecord record) {
+        record.forEachString([&strings](auto& field) { field.moveTo(strings); });
+        return record;
+    };
+    history->remake([&rehome](VersionEdit edit, const PatientVersion& version, const PatientVersion* previous) {
+        if (previous && edit == VersionEdit::Push) {
+            return previous->push_back(rehome(version.back()));
+        }
+        if (previous && edit == VersionEdit::Pop) {
+            return previous->pop_front();
+        }
+        PatientVersion copy;
+        version.forEach([&](const PatientRecord& record) { copy = copy.push_back(rehome(record)); });
+        return copy;
+    });
+    historyStrings.swap(strings);
+    historyStringsKept = historyStrings.liveBytes();
+}
+
+void PatientQueue::restore(const PatientVersion& version) {
+    patients.clear();
+    arena.clear();
+    patients.reserve(version.size());
+    version.forEach([this](const PatientRecord& kept) { assignRecord(patients.emplace_back(), kept); });
+    indexIds();
+}
+
+void PatientQueue::recordReset() {
+    if (history) {
+        history->record(VersionEdit::Reset, currentVersion());
+        compactHistory();
+    }
+}
+
+// Attach the archive that receives discharged patients
+void PatientQueue::setDischargeArchive(DischargeArchive* target) {
+    archive = target;
+}
+
+DischargeArchive* PatientQueue::dischargeArchive() {
+    return archive;
+}
+
+// Functionality 4: list discharges of the last days, optionally for one condition
+void PatientQueue::viewDischargeHistory(const string& conditionType, int days) {
+    if (!archive) {
+        cout << "Discharge history is not kept for this queue." << endl;
+        return;
+    }
+    
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    int64_t from = now - static_cast<int64_t>(days) * 24 * 3600;
+    const ListingPage& page = listingPage();
+    TableRenderer table({{"Patient ID", 15}, {"Condition", 20}, {"Admitted", 20}, {"Discharged", 20}});
+    string heading = "\n=== Discharges in the last " + to_string(days) + " day(s)";
+    table.line(heading + (conditionType.empty() ? "" : " (" + conditionType + ")") + " ===");
+    table.header();
+    
+    size_t index = 0;
+    size_t found = archive->query(from, now + 1, conditionType, [&](const DischargeRecord& record) {
+        if (page.contains(index++)) {
+            table.cell(record.id)
+                 .cell(record.conditionType)
+                 .cell(formatLocalTime(record.admittedAt))
+                 .cell(formatLocalTime(record.dischargedAt));
+            table.endRow();
+        }
+    });
+    table.pageSummary(page, found);
+    table.line("================================\n");
+}
+
 // Check if queue is empty
 bool PatientQueue::isEmpty() {
-    return front == nullptr;
+    return patients.empty();
 }
 
 // Get queue size
 int PatientQueue::getSize() {
-    return size;
+    return static_cast<int>(patients.size());
+}
+
+// Get the file this queue persists to
+string PatientQueue::getFilename() {
+    return currentFilename;
 }
\ No newline at end of file
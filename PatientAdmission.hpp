@@ -7,42 +7,121 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <vector>
+#include "Containers.hpp"
+#include "CompactRecords.hpp"
+#include "DischargeArchive.hpp"
+#include "DuplicateFilter.hpp"
+#include "VersionHistory.hpp"
 using namespace std;
 
-// Patient structure
-struct Patient {
+class WorkStealingPool;
+
+// Patient record: one 64-byte cache line, long values spill to the queue's arena
+struct PatientRecord {
+    int64_t admittedAt; // Unix seconds, 0 if unknown (files written before it was kept)
+    InlineString<16> id;
+    InlineString<24> name;
+    InlineString<16> conditionType;
+
+    template <typename F>
+    void forEachString(F&& f) {
+        f(id);
+        f(name);
+        f(conditionType);
+    }
+};
+
+// Patient owning its strings, unlike PatientRecord (rows read from a file)
+struct PatientEntry {
     string id;
     string name;
     string conditionType;
-    Patient* next;
-    
-    Patient(string patientId, string patientName, string condition) 
-        : id(patientId), name(patientName), conditionType(condition), next(nullptr) {}
+    int64_t admittedAt;
 };
 
-// Queue class for Patient management
+// One version of the queue contents, front first; spilled strings live in
+// the queue's history arena, not in the arena of the queue itself
+typedef PersistentQueue<PatientRecord> PatientVersion;
+
+// Queue class for Patient management (thin wrapper over Queue<PatientRecord>)
 class PatientQueue {
 private:
-    Patient* front;
-    Patient* rear;
-    int size;
+    Queue<PatientRecord> patients;
+    StringArena arena;
     string currentFilename;
-    
-    string toUpperCase(string str);
-    string trim(const string& str);
+    DischargeArchive* archive; // not owned; null when discharges are not kept
+    WorkStealingPool* writer;  // not owned; null to write files on the calling thread
+    unique_ptr<VersionHistory<PatientVersion>> history; // null while undo is off
+    StringArena historyStrings;   // spilled strings of the versions in history
+    size_t historyStringsKept;    // bytes of historyStrings in use after the last compaction
+    DuplicateIdFilter waitingIds; // ids of the patients in the queue
+
+    void reclaimSpilled(); // drop or compact the arena after removals
+    void noteWaiting(const PatientRecord& record); // adds its id to waitingIds
+    void indexIds();       // rebuilds waitingIds after the queue was replaced
+    void assignRecord(PatientRecord& record, const PatientEntry& entry);
+    void assignRecord(PatientRecord& record, const PatientRecord& kept); // from a version
+    PatientRecord historyRecord(const PatientRecord& record); // copy for a version
+    void compactHistory();                 // once historyStrings is mostly dropped versions
+    void dropFront();
+    void dropBack();
+    PatientVersion currentVersion();       // built from every record
+    void restore(const PatientVersion& version);
+    void recordReset();                    // contents were replaced as a whole
 
 public:
     PatientQueue();
+    explicit PatientQueue(string filename); // queue persisted to another file
     ~PatientQueue();
     
+    // Normalization helpers (shared with the bulk import pipeline)
+    static string toUpperCase(string str);
+    static string trim(const string& str);
+    
+    // An id already waiting in the queue is rejected: admitPatient prints why,
+    // appendPatient returns false; the queue is left unchanged
     void admitPatient(string id, string name, string conditionType);
+    bool appendPatient(const string& id, const string& name, const string& conditionType); // no output, no file save
+    bool appendPatient(const string& id, const string& name, const string& conditionType, time_t admittedAt);
+    bool isWaiting(const string& id) const;
+    bool removeFront(string& id, string& name, string& conditionType);                      // no output, no file save
     bool dischargePatient();
     void viewPatientQueue();
+    
+    // Discharged patients are appended to archive (flushed by persist and persistLater)
+    void setDischargeArchive(DischargeArchive* target);
+    DischargeArchive* dischargeArchive();
+    void viewDischargeHistory(const string& conditionType, int days); // blank condition = all
     bool saveToFile(string filename);
     bool loadFromFile(string filename);
+    bool persist(); // save to the default file, writing the empty-queue marker when empty
+    
+    // Queue file writes of the menu functions (and persistLater) go to pool
+    void setBackgroundWriter(WorkStealingPool* pool);
+    void persistLater(); // persist() on the background writer, from a copy of the records
+    
+    // Binary snapshot of the records as laid out in memory (see CompactRecords.hpp)
+    bool saveToBinary(const string& filename);
+    bool loadFromBinary(const string& filename);
+    
+    // Undo history, off until enabled: every admission, discharge and load
+    // adds a version sharing the unchanged patients with the previous one.
+    // depth is the number of undo steps kept; 0 turns the history off.
+    void enableHistory(size_t depth);
+    bool undo(); // false when there is nothing to undo; discharges stay archived
+    bool redo();
+    const VersionHistory<PatientVersion>* versions() const; // null while undo is off
+    
+    // Appends a copy of every record (front first) with spilled strings re-homed in strings
+    void snapshotRecords(vector<PatientRecord>& out, StringArena& strings) const;
     
     bool isEmpty();
     int getSize();
+    string getFilename();
 };
 
 #endif
\ No newline at end of file
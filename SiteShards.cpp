@@ -0,0 +1,171 @@
+#include "SiteShards.hpp"
+#include "CommandMode.hpp"
+#include "DischargeArchive.hpp"
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+#include <cctype>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+SiteShard::SiteShard(std::string site, std::string directory, std::size_t undoDepth)
+    : name(std::move(site)), dir(std::move(directory)), stopping(false) {
+    worker = std::thread(&SiteShard::run, this);
+    // Queued first, so every later task sees the loaded stores
+    post([undoDepth](SiteShard& shard) { shard.load(undoDepth); });
+}
+
+SiteShard::~SiteShard() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+std::future<void> SiteShard::post(std::function<void(SiteShard&)> task) {
+    std::packaged_task<void()> job([this, task = std::move(task)] { task(*this); });
+    std::future<void> done = job.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(job));
+    }
+    wake.notify_one();
+    return done;
+}
+
+void SiteShard::load(std::size_t undoDepth) {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error); // the stores write here on commit
+
+    const std::string suppliesFile = dir + "/MedicalSupplies.csv";
+    const std::string scheduleFile = dir + "/ambulance_schedule.csv";
+
+    patients.reset(new PatientQueue(dir + "/PatientAdmission.csv"));
+    archive.reset(new DischargeArchive(dir + "/discharges"));
+    patients->setDischargeArchive(archive.get());
+    patients->enableHistory(undoDepth);
+
+    supplies.reset(new SupplyStack());
+    supplies->loadFromCsv(suppliesFile);
+    supplies->enableHistory(undoDepth);
+
+    emergencies.reset(new EmergencyDepartmentSystem());
+    emergencies->loadAgingPolicies(AGING_FILENAME); // one policy file for every site
+
+    ambulances.reset(new AmbulanceScheduler());
+    ambulances->loadScheduleFromCsv(scheduleFile);
+    ambulances->enableHistory(undoDepth);
+
+    commands.reset(new CommandProcessor(*patients, *supplies, *emergencies, *ambulances,
+                                        suppliesFile, scheduleFile));
+}
+
+SiteSummary SiteShard::summary() {
+    SiteSummary result;
+    result.site = name;
+    result.patientsWaiting = static_cast<std::size_t>(patients->getSize());
+    result.supplyUnits = supplies->totalQuantity();
+    result.pendingCases = emergencies->pendingCount();
+    result.ambulances = ambulances->size();
+    return result;
+}
+
+void SiteShard::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+            return; // stopping, and everything queued has run
+        }
+        std::packaged_task<void()> job = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+SiteRouter::SiteRouter(std::string root, std::size_t undoDepth) : root(std::move(root)), undoDepth(undoDepth) {}
+
+bool SiteRouter::validSiteId(const std::string& site) {
+    if (site.empty() || site.size() > MAX_SITE_ID_LENGTH) {
+        return false;
+    }
+    for (char c : site) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+SiteShard* SiteRouter::open(const std::string& site) {
+    if (!validSiteId(site)) {
+        return nullptr;
+    }
+    std::unique_ptr<SiteShard>& shard = shards[site];
+    if (!shard) {
+        shard.reset(new SiteShard(site, root + "/" + site, undoDepth));
+    }
+    return shard.get();
+}
+
+void SiteRouter::openExisting() {
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(root, error)) {
+        std::string site = entry.path().filename().string();
+        if (entry.is_directory(error) && site == PatientQueue::toUpperCase(site)) {
+            open(site); // loads on the shard's own thread
+        }
+    }
+}
+
+bool SiteRouter::execute(SiteShard& shard, const std::string& line, std::string& out) {
+    bool keepGoing = true;
+    std::string reply;
+    shard.post([&](SiteShard& target) { keepGoing = target.processor().execute(line, reply); }).get();
+    out += reply;
+    return keepGoing;
+}
+
+std::vector<SiteSummary> SiteRouter::summarize() {
+    std::vector<SiteSummary> results(shards.size());
+    std::vector<std::future<void>> pending;
+    pending.reserve(shards.size());
+    std::size_t index = 0;
+    for (auto& entry : shards) {
+        SiteSummary& slot = results[index++];
+        pending.push_back(entry.second->post([&slot](SiteShard& shard) { slot = shard.summary(); }));
+    }
+    for (std::future<void>& done : pending) {
+        done.get();
+    }
+    return results;
+}
+
+bool SiteRouter::commitAll() {
+    std::vector<char> saved(shards.size(), 1);
+    std::vector<std::future<void>> pending;
+    pending.reserve(shards.size());
+    std::size_t index = 0;
+    for (auto& entry : shards) {
+        char& ok = saved[index++];
+        pending.push_back(entry.second->post([&ok](SiteShard& shard) { ok = shard.processor().commit(); }));
+    }
+    bool ok = true;
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        pending[i].get();
+        ok = ok && saved[i];
+    }
+    return ok;
+}
+
+void SiteRouter::commitAllLater() {
+    for (auto& entry : shards) {
+        entry.second->post([](SiteShard& shard) { shard.processor().commit(); });
+    }
+}
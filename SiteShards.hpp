@@ -0,0 +1,117 @@
+#ifndef SITESHARDS_HPP
+#define SITESHARDS_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PatientQueue;
+class SupplyStack;
+class EmergencyDepartmentSystem;
+class AmbulanceScheduler;
+class DischargeArchive;
+class CommandProcessor;
+
+// Each site keeps its files in SITES_DIR/<site id>/
+const char* const SITES_DIR = "data/sites";
+const std::size_t MAX_SITE_ID_LENGTH = 32;
+
+// Totals of one site, for cross-site queries
+struct SiteSummary {
+    std::string site;
+    std::size_t patientsWaiting = 0;
+    long long supplyUnits = 0;
+    std::size_t pendingCases = 0;
+    int ambulances = 0;
+};
+
+/**
+ * The stores of one hospital site, owned by one worker thread.
+ *
+ * A shard has its own patient queue (with discharge archive), supply
+ * stack, triage system and ambulance rotation, persisted under its own
+ * directory with the same file names as the main site. The stores are
+ * created and loaded on the worker and only ever touched there: callers
+ * hand work over with post() and wait on the returned future, so shards
+ * load, save and answer queries in parallel with each other.
+ */
+class SiteShard {
+public:
+    SiteShard(std::string site, std::string directory, std::size_t undoDepth);
+    ~SiteShard(); // runs the queued tasks, then stops the worker
+
+    SiteShard(const SiteShard&) = delete;
+    SiteShard& operator=(const SiteShard&) = delete;
+
+    std::future<void> post(std::function<void(SiteShard&)> task);
+
+    const std::string& site() const { return name; }
+
+    // Worker thread only
+    CommandProcessor& processor() { return *commands; }
+    SiteSummary summary();
+
+private:
+    void load(std::size_t undoDepth);
+    void run();
+
+    std::string name;
+    std::string dir;
+
+    std::unique_ptr<DischargeArchive> archive;
+    std::unique_ptr<PatientQueue> patients;
+    std::unique_ptr<SupplyStack> supplies;
+    std::unique_ptr<EmergencyDepartmentSystem> emergencies;
+    std::unique_ptr<AmbulanceScheduler> ambulances;
+    std::unique_ptr<CommandProcessor> commands;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::packaged_task<void()>> tasks;
+    bool stopping;
+    std::thread worker;
+};
+
+/**
+ * Routes work to site shards by site id. Shards are opened on first use
+ * (or all at once by openExisting()); queries over every site fan out to
+ * all shards and wait for them together. The router itself is used from
+ * one thread.
+ */
+class SiteRouter {
+public:
+    SiteRouter(std::string root, std::size_t undoDepth);
+
+    // Letters, digits, '-' and '_', up to MAX_SITE_ID_LENGTH characters
+    static bool validSiteId(const std::string& site);
+
+    // Shard of site, opened if new; null for an invalid id
+    SiteShard* open(const std::string& site);
+
+    // Opens a shard for every site directory under the root
+    void openExisting();
+
+    // Runs one command line on the site's worker and appends its response
+    bool execute(SiteShard& shard, const std::string& line, std::string& out);
+
+    std::vector<SiteSummary> summarize(); // by site id
+    bool commitAll();                     // writes every shard's modified stores
+    void commitAllLater();                // same, without waiting (errors unreported)
+
+    std::size_t size() const { return shards.size(); }
+
+private:
+    std::string root;
+    std::size_t undoDepth;
+    std::map<std::string, std::unique_ptr<SiteShard>> shards;
+};
+
+#endif // SITESHARDS_HPP
@@ -1,29 +1,77 @@
 #include "SupplyStack.hpp"
+#include "TableRenderer.hpp"
+#include "Metrics.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
 #include <iostream>
-#include <iomanip>
 #include <fstream>
+#include <mutex>
 #include <sstream>
+#include <vector>
 
-// Constructor: Initialize empty stack
-SupplyStack::SupplyStack() : top(nullptr) {}
+namespace {
 
-// Destructor: Pop all items to prevent memory leaks
-SupplyStack::~SupplyStack() {
-    while (!isEmpty()) {
-        pop();
-    }
+Supply toSupply(const SupplyRecord& record) {
+    Supply supply;
+    supply.type = record.type.str();
+    supply.quantity = record.quantity;
+    supply.batch = record.batch.str();
+    return supply;
+}
+
+// Header of the current CSV layout; files with another header list the
+// supplies top first ("Position,Type,Quantity,Batch")
+const char* const SUPPLY_CSV_HEADER = "Depth,Type,Quantity,Batch";
+
+// One CSV row, depth counted from the bottom of the stack (1 = bottom)
+void formatSupplyRow(std::string& row, std::size_t depth, const SupplyRecord& record) {
+    row = std::to_string(depth);
+    row += ',';
+    row.append(record.type.data(), record.type.size());
+    row += ',';
+    row += std::to_string(record.quantity);
+    row += ',';
+    row.append(record.batch.data(), record.batch.size());
+    row += '\n';
 }
 
+} // namespace
+
+// Rewrites are numbered as they are queued; written is the newest one on disk
+// (or given up on), so none is pending while written == queued
+struct SupplyStack::PendingRewrites {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::uint64_t queued = 0;
+    std::uint64_t written = 0;
+};
+
+// Constructor: Initialize empty stack
+SupplyStack::SupplyStack() : unchangedRows(0), writer(nullptr), rewrites(std::make_shared<PendingRewrites>()) {}
+
+// Destructor
+SupplyStack::~SupplyStack() {}
+
 // Check if stack is empty
 bool SupplyStack::isEmpty() const {
-    return top == nullptr;
+    return items.empty();
 }
 
 // Add supply to top of stack
 void SupplyStack::push(const Supply& item) {
-    Node* newNode = new Node(item);
-    newNode->next = top;
-    top = newNode;
+    pushRecord(item);
+    if (history) {
+        history->record(VersionEdit::Push, history->current().push(item));
+    }
+}
+
+void SupplyStack::pushRecord(const Supply& item) {
+    SupplyRecord& record = items.emplace();
+    record.type.assign(item.type, arena);
+    record.batch.assign(item.batch, arena);
+    record.quantity = item.quantity;
 }
 
 // Remove and return top supply (most recently added)
@@ -37,13 +85,35 @@ Supply SupplyStack::pop() {
         return emptySupply;
     }
     
-    Node* nodeToRemove = top;
-    Supply data = top->data;
-    top = top->next;
-    delete nodeToRemove;
+    Supply data = toSupply(items.top());
+    dropTop();
+    if (history) {
+        history->record(VersionEdit::Pop, history->current().pop());
+    }
     return data;
 }
 
+void SupplyStack::dropTop() {
+    items.top().forEachString([this](const auto& field) { field.release(arena); });
+    items.pop();
+    unchangedRows = std::min(unchangedRows, items.size());
+    reclaimSpilled();
+}
+
+// Spilled strings of used supplies stay in the arena until it is cleared
+// (stack empty) or rebuilt from the remaining records (mostly dead)
+void SupplyStack::reclaimSpilled() {
+    if (items.empty()) {
+        arena.clear();
+    } else if (arena.wantsCompaction()) {
+        StringArena fresh;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            items.fromTop(i).forEachString([&fresh](auto& field) { field.moveTo(fresh); });
+        }
+        arena.swap(fresh);
+    }
+}
+
 // View top item without removing
 Supply SupplyStack::peek() const {
     if (isEmpty()) {
@@ -53,16 +123,18 @@ Supply SupplyStack::peek() const {
         emptySupply.batch = "";
         return emptySupply;
     }
-    return top->data;
+    return toSupply(items.top());
 }
 
 // Add Supply Stock: Record a new supply item
 void SupplyStack::addSupplyStock(const std::string& type, int quantity, const std::string& batch) {
-    Supply newSupply;
-    newSupply.type = type;
-    newSupply.quantity = quantity;
-    newSupply.batch = batch;
-    push(newSupply);
+    SupplyRecord& record = items.emplace();
+    record.type.assign(type, arena);
+    record.batch.assign(batch, arena);
+    record.quantity = quantity;
+    if (history) {
+        history->record(VersionEdit::Push, history->current().push(Supply{type, quantity, batch}));
+    }
 }
 
 // Use 'Last Added' Supply: Remove the most recently added supply
@@ -78,53 +150,153 @@ void SupplyStack::viewCurrentSupplies() const {
         return;
     }
     
-    std::cout << "\n=== Current Supplies (Top to Bottom) ===" << std::endl;
-    std::cout << std::left << std::setw(20) << "Type" 
-              << std::setw(15) << "Quantity" 
-              << std::setw(15) << "Batch" << std::endl;
-    std::cout << std::string(50, '-') << std::endl;
+    const ListingPage& page = listingPage();
+    TableRenderer table({{"Position", 10}, {"Type", 20}, {"Quantity", 15}, {"Batch", 15}});
+    table.line("\n=== Current Supplies (Top to Bottom) ===");
+    table.header();
     
-    // Iterate through stack without removing items
-    Node* current = top;
-    int position = 1;
-    while (current != nullptr) {
-        std::cout << position << ". " 
-                  << std::setw(17) << current->data.type
-                  << std::setw(15) << current->data.quantity
-                  << std::setw(15) << current->data.batch << std::endl;
-        current = current->next;
-        position++;
+    // Index from the top without removing items; only the page is visited
+    for (std::size_t index = page.offset; index < items.size() && !page.pastEnd(index); index++) {
+        const SupplyRecord& current = items.fromTop(index);
+        table.cell(static_cast<long long>(index + 1))
+             .cell(current.type.data(), current.type.size())
+             .cell(current.quantity)
+             .cell(current.batch.data(), current.batch.size());
+        table.endRow();
     }
-    std::cout << std::endl;
+    table.pageSummary(page, items.size());
+    table.line("");
 }
 
-// Save current supplies to a CSV file
+// Save current supplies to a CSV file. A row keeps its line while its supply
+// stays on the stack, so when filename is the file saved last (and still the
+// size we left it) only the rows above the lowest pop since are rewritten: a
+// push costs one appended line and a pop one truncation.
 bool SupplyStack::saveToCsv(const std::string& filename) const {
-    std::ofstream outFile(filename);
+    HOSPITAL_METRIC_SCOPE(MetricId::SupplySave);
+    waitForRewrites();
+    std::error_code error;
+    bool delta = filename == syncedFile && !syncedRowEnds.empty() &&
+                 std::filesystem::file_size(filename, error) == syncedRowEnds.back() && !error;
+    std::size_t keep = delta ? std::min(unchangedRows, syncedRowEnds.size() - 1) : 0;
+    syncedFile.clear(); // until this save is complete
+    if (delta) {
+        std::filesystem::resize_file(filename, syncedRowEnds[keep], error);
+        if (error) {
+            std::cout << "Error: Unable to write supplies to file '" << filename << "'.\n";
+            return false;
+        }
+    }
+
+    std::ofstream outFile(filename, delta ? std::ios::app : std::ios::trunc);
     if (!outFile) {
         std::cout << "Error: Unable to write supplies to file '" << filename << "'.\n";
         return false;
     }
 
-    // CSV header
-    outFile << "Position,Type,Quantity,Batch\n";
+    std::string rows;
+    if (!delta) {
+        keep = 0;
+        rows = SUPPLY_CSV_HEADER;
+        rows += '\n';
+    }
+    formatRows(keep, rows);
+    outFile.write(rows.data(), static_cast<std::streamsize>(rows.size()));
 
-    Node* current = top;
-    int position = 1;
-    while (current != nullptr) {
-        outFile << position << ","
-                << current->data.type << ","
-                << current->data.quantity << ","
-                << current->data.batch << "\n";
-        current = current->next;
-        ++position;
+    outFile.close();
+    if (outFile) {
+        syncedFile = filename;
+        unchangedRows = items.size();
+    } else {
+        std::cout << "Error: Unable to write supplies to file '" << filename << "'.\n";
     }
+    return static_cast<bool>(outFile);
+}
 
-    return true;
+// Appends the rows from depth keep + 1 up to out, and records where they end
+// in the file; keep 0 starts the file over, with out holding the header
+void SupplyStack::formatRows(std::size_t keep, std::string& out) const {
+    if (keep == 0) {
+        syncedRowEnds.assign(1, out.size());
+    } else {
+        syncedRowEnds.resize(keep + 1);
+    }
+    std::string row;
+    for (std::size_t depth = keep; depth < items.size(); ++depth) {
+        formatSupplyRow(row, depth + 1, items.fromTop(items.size() - 1 - depth));
+        out += row;
+        syncedRowEnds.push_back(syncedRowEnds.back() + row.size());
+    }
+}
+
+// A delta save stays on the calling thread: it is one truncation or one short
+// append. A full rewrite is formatted here and written by the writer, keyed by
+// the file so rewrites land in order. The delta check needs the file as the
+// last save left it, so while a rewrite is still queued, saves queue rewrites
+// as well (the pool drops the older one if it has not started yet).
+void SupplyStack::saveToCsvLater(const std::string& filename) const {
+    if (!writer) {
+        saveToCsv(filename);
+        return;
+    }
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(rewrites->mutex);
+        if (rewrites->written == rewrites->queued) {
+            generation = 0;
+        } else {
+            generation = ++rewrites->queued;
+        }
+    }
+    if (generation == 0) {
+        std::error_code error;
+        bool delta = filename == syncedFile && !syncedRowEnds.empty() &&
+                     std::filesystem::file_size(filename, error) == syncedRowEnds.back() && !error;
+        if (delta) {
+            saveToCsv(filename);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(rewrites->mutex);
+        generation = ++rewrites->queued;
+    }
+
+    HOSPITAL_METRIC_SCOPE(MetricId::SupplySave);
+    std::shared_ptr<std::string> contents = std::make_shared<std::string>(SUPPLY_CSV_HEADER);
+    *contents += '\n';
+    formatRows(0, *contents);
+    // Assume the rewrite lands; if it does not, the size check of the next
+    // save fails and that save rewrites the file again
+    syncedFile = filename;
+    unchangedRows = items.size();
+
+    std::shared_ptr<PendingRewrites> pending = rewrites;
+    writer->submitLatest(filename, [pending, contents, filename, generation] {
+        std::ofstream outFile(filename, std::ios::trunc);
+        if (outFile) {
+            outFile.write(contents->data(), static_cast<std::streamsize>(contents->size()));
+        } else {
+            std::cout << "Error: Unable to write supplies to file '" << filename << "'.\n";
+        }
+        outFile.close();
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        pending->written = generation;
+        pending->done.notify_all();
+    });
+}
+
+void SupplyStack::setBackgroundWriter(WorkStealingPool* pool) {
+    writer = pool;
+}
+
+void SupplyStack::waitForRewrites() const {
+    std::unique_lock<std::mutex> lock(rewrites->mutex);
+    rewrites->done.wait(lock, [this] { return rewrites->written == rewrites->queued; });
 }
 
 // Load supplies from a CSV file, replacing current stack contents
 bool SupplyStack::loadFromCsv(const std::string& filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::SupplyLoad);
+    waitForRewrites(); // the file may still be on its way to the disk
     std::ifstream inFile(filename);
     if (!inFile) {
         // If file doesn't exist, treat as empty inventory but not an error
@@ -132,23 +304,26 @@ bool SupplyStack::loadFromCsv(const std::string& filename) {
     }
 
     // Clear existing stack
-    while (!isEmpty()) {
-        pop();
-    }
+    items.clear();
+    arena.clear();
+    syncedFile.clear();
+    unchangedRows = 0;
 
     std::string line;
-    bool firstLine = true;
+    std::getline(inFile, line);
+    bool bottomFirst = line.rfind(SUPPLY_CSV_HEADER, 0) == 0;
+    // A file in the current layout with every row kept can be saved to as is
+    bool intact = bottomFirst;
+    std::vector<std::uint64_t> rowEnds(1, line.size() + 1);
 
-    // Use a temporary stack to store supplies while reading
-    // Then transfer them to main stack in correct order
-    SupplyStack tempStack;
+    std::vector<SupplyRecord> rows;
 
     while (std::getline(inFile, line)) {
-        if (firstLine) {
-            firstLine = false; // skip header
+        rowEnds.push_back(rowEnds.back() + line.size() + 1);
+        if (line.empty()) {
+            intact = false;
             continue;
         }
-        if (line.empty()) continue;
 
         std::stringstream ss(line);
         std::string positionStr, type, quantityStr, batch;
@@ -158,28 +333,153 @@ bool SupplyStack::loadFromCsv(const std::string& filename) {
         std::getline(ss, quantityStr, ',');
         std::getline(ss, batch, ',');
 
-        if (type.empty()) continue;
-
         int quantity = 0;
         try {
             quantity = std::stoi(quantityStr);
         } catch (...) {
+            type.clear();
+        }
+        if (type.empty()) {
+            intact = false;
             continue;
         }
 
-        Supply s;
-        s.type = type;
-        s.quantity = quantity;
-        s.batch = batch;
-        tempStack.push(s);
+        SupplyRecord record{};
+        record.type.assign(type, arena);
+        record.batch.assign(batch, arena);
+        record.quantity = quantity;
+        rows.push_back(record);
+    }
+
+    // Older files list the top first
+    if (!bottomFirst) {
+        std::reverse(rows.begin(), rows.end());
+    }
+    items.reserve(rows.size());
+    for (const SupplyRecord& record : rows) {
+        items.push(record);
+    }
+
+    if (intact) {
+        syncedFile = filename;
+        syncedRowEnds.swap(rowEnds);
+        unchangedRows = items.size();
+    }
+    recordReset();
+    return true;
+}
+
+// Save the stack as a binary record file (bottom first, the order it was built)
+bool SupplyStack::saveToBinary(const std::string& filename) const {
+    HOSPITAL_METRIC_SCOPE(MetricId::SupplySave);
+    std::size_t count = items.size();
+    return writeRecordFile<SupplyRecord>(filename, "HSUP", count,
+                                         [this, count](std::size_t i) { return items.fromTop(count - 1 - i); });
+}
+
+// Replace the stack with a binary record file
+bool SupplyStack::loadFromBinary(const std::string& filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::SupplyLoad);
+    Stack<SupplyRecord> loaded;
+    StringArena loadedArena;
+    if (!readRecordFile<SupplyRecord>(filename, "HSUP", loadedArena,
+                                      [&loaded](const SupplyRecord& record) { loaded.push(record); })) {
+        return false;
     }
+    std::swap(items, loaded);
+    arena.swap(loadedArena);
+    unchangedRows = 0;
+    recordReset();
+    return true;
+}
 
-    // Transfer from temp stack to main stack to maintain correct order
-    // (first read item should be at top of main stack)
-    while (!tempStack.isEmpty()) {
-        push(tempStack.pop());
+// Start (or stop) keeping versions; the current contents become version 0
+void SupplyStack::enableHistory(std::size_t depth) {
+    if (depth == 0) {
+        history.reset();
+        return;
+    }
+    history.reset(new VersionHistory<SupplyVersion>(currentVersion(), depth));
+}
+
+// Step back one change; a push or pop is reversed at the top, a load by a rebuild
+bool SupplyStack::undo() {
+    if (!history || !history->canUndo()) {
+        return false;
     }
+    VersionEdit undone = history->currentEdit();
+    history->undo();
+    const SupplyVersion& previous = history->current();
+    if (undone == VersionEdit::Push) {
+        dropTop();
+    } else if (undone == VersionEdit::Pop) {
+        pushRecord(previous.top());
+    } else {
+        restore(previous);
+    }
+    return true;
+}
 
+bool SupplyStack::redo() {
+    if (!history || !history->canRedo()) {
+        return false;
+    }
+    history->redo();
+    const SupplyVersion& next = history->current();
+    if (history->currentEdit() == VersionEdit::Push) {
+        pushRecord(next.top());
+    } else if (history->currentEdit() == VersionEdit::Pop) {
+        dropTop();
+    } else {
+        restore(next);
+    }
     return true;
 }
 
+const VersionHistory<SupplyVersion>* SupplyStack::versions() const {
+    return history.get();
+}
+
+SupplyVersion SupplyStack::currentVersion() const {
+    SupplyVersion version;
+    for (std::size_t i = items.size(); i-- > 0;) {
+        version = version.push(toSupply(items.fromTop(i)));
+    }
+    return version;
+}
+
+void SupplyStack::restore(const SupplyVersion& version) {
+    std::vector<const Supply*> topFirst;
+    topFirst.reserve(version.size());
+    version.forEach([&topFirst](const Supply& supply) { topFirst.push_back(&supply); });
+    items.clear();
+    arena.clear();
+    unchangedRows = 0;
+    items.reserve(topFirst.size());
+    for (std::size_t i = topFirst.size(); i > 0; --i) {
+        pushRecord(*topFirst[i - 1]);
+    }
+}
+
+void SupplyStack::recordReset() {
+    if (history) {
+        history->record(VersionEdit::Reset, currentVersion());
+    }
+}
+
+long long SupplyStack::totalQuantity() const {
+    long long total = 0;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        total += items.fromTop(i).quantity;
+    }
+    return total;
+}
+
+// Copy the records for a reader on another thread; the copies do not point into our arena
+void SupplyStack::snapshotRecords(std::vector<SupplyRecord>& out, StringArena& strings) const {
+    out.reserve(out.size() + items.size());
+    for (std::size_t i = items.size(); i-- > 0;) {
+        out.push_back(items.fromTop(i));
+        out.back().forEachString([&strings](auto& field) { field.moveTo(strings); });
+    }
+}
@@ -1,7 +1,18 @@
 #ifndef SUPPLYSTACK_HPP
 #define SUPPLYSTACK_HPP
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+#include "Containers.hpp"
+#include "CompactRecords.hpp"
+#include "VersionHistory.hpp"
+
+class WorkStealingPool;
+
+// Default CSV file used by the Medical Supply Manager role
+const char* const SUPPLIES_FILENAME = "data/MedicalSupplies.csv";
 
 // Supply data structure
 struct Supply {
@@ -10,24 +21,53 @@ struct Supply {
     std::string batch;
 };
 
-// Node structure for linked list implementation
-struct Node {
-    Supply data;
-    Node* next;
-    
-    Node(const Supply& supply) : data(supply), next(nullptr) {}
+// One version of the stack contents for the undo history (top = last added)
+typedef PersistentStack<Supply> SupplyVersion;
+
+// Supply as stored in the stack (44 bytes); long values spill to the stack's arena
+struct SupplyRecord {
+    InlineString<24> type;
+    InlineString<16> batch;
+    std::int32_t quantity;
+
+    template <typename F>
+    void forEachString(F&& f) {
+        f(type);
+        f(batch);
+    }
 };
 
-// Stack class for managing medical supplies
+// Stack class for managing medical supplies (thin wrapper over Stack<SupplyRecord>)
 class SupplyStack {
 private:
-    Node* top;  // Pointer to the top of the stack
+    Stack<SupplyRecord> items;  // back of the vector is the top of the stack
+    StringArena arena;
+    std::unique_ptr<VersionHistory<SupplyVersion>> history;  // null while undo is off
+    // What saveToCsv last wrote, so the next save only rewrites the changed
+    // rows: the file, the byte offset after its header and after each row
+    // (bottom first), and how many bottom rows are unchanged since
+    mutable std::string syncedFile;
+    mutable std::vector<std::uint64_t> syncedRowEnds;
+    mutable std::size_t unchangedRows;
+    WorkStealingPool* writer;  // full rewrites of saveToCsvLater; not owned
+    // Full rewrites handed to writer and how far it got, shared with its tasks
+    struct PendingRewrites;
+    std::shared_ptr<PendingRewrites> rewrites;
+    
+    void reclaimSpilled();  // drop or compact the arena after removals
+    void pushRecord(const Supply& item);
+    void dropTop();
+    SupplyVersion currentVersion() const;  // built from every record
+    void restore(const SupplyVersion& version);
+    void recordReset();                    // contents were replaced as a whole
+    void formatRows(std::size_t keep, std::string& out) const;  // rows above keep; updates syncedRowEnds
+    void waitForRewrites() const;          // until writer has written every queued rewrite
     
 public:
     // Constructor: Initialize empty stack
     SupplyStack();
     
-    // Destructor: Clean up all nodes
+    // Destructor: the stack releases its own storage
     ~SupplyStack();
     
     // Core stack operations
@@ -35,6 +75,7 @@ public:
     Supply pop();                   // Remove and return top supply
     bool isEmpty() const;           // Check if stack is empty
     Supply peek() const;            // View top item without removing
+    long long totalQuantity() const; // Sum of the quantities of all supplies
     
     // Required role functions
     void addSupplyStock(const std::string& type, int quantity, const std::string& batch);
@@ -42,8 +83,28 @@ public:
     void viewCurrentSupplies() const;  // Display all supplies from top to bottom
 
     // Persistence helpers for Medical Supply Manager role
+    // The CSV lists supplies bottom first by depth; saving again to the same
+    // file truncates it after the unchanged rows and appends the rest
     bool saveToCsv(const std::string& filename) const; // Save current supplies to CSV
     bool loadFromCsv(const std::string& filename);     // Load supplies from CSV (replaces current stack)
+    // Same as saveToCsv, but a full rewrite is formatted here and written by
+    // the background writer; until it lands, later saves queue rewrites too
+    void saveToCsvLater(const std::string& filename) const;
+    void setBackgroundWriter(WorkStealingPool* pool);       // null: saveToCsvLater writes right away
+
+    // Binary snapshot of the records as laid out in memory (see CompactRecords.hpp)
+    bool saveToBinary(const std::string& filename) const;
+    bool loadFromBinary(const std::string& filename);  // stack unchanged on failure
+
+    // Undo history, off until enabled: every push, pop and load adds a
+    // version sharing the unchanged supplies. depth 0 turns it off.
+    void enableHistory(std::size_t depth);
+    bool undo();  // false when there is nothing to undo
+    bool redo();
+    const VersionHistory<SupplyVersion>* versions() const;  // null while undo is off
+
+    // Appends a copy of every record (bottom first) with spilled strings re-homed in strings
+    void snapshotRecords(std::vector<SupplyRecord>& out, StringArena& strings) const;
 };
 
 #endif // SUPPLYSTACK_HPP
@@ -0,0 +1,111 @@
+#include "TableRenderer.hpp"
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+ListingPage& listingPage() {
+    static ListingPage page;
+    return page;
+}
+
+TableRenderer::TableRenderer(std::vector<TableColumn> tableColumns)
+    : columns(std::move(tableColumns)), ruleWidth(0), nextColumn(0) {
+    for (const TableColumn& column : columns) {
+        ruleWidth += column.width;
+    }
+    buffer.reserve(TABLE_CHUNK_SIZE + 256);
+}
+
+TableRenderer::~TableRenderer() {
+    flush();
+}
+
+void TableRenderer::line(const std::string& text) {
+    buffer += text;
+    buffer += '\n';
+    flushIfFull();
+}
+
+void TableRenderer::header() {
+    for (const TableColumn& column : columns) {
+        cell(column.title);
+    }
+    endRow();
+    buffer.append(ruleWidth, '-');
+    buffer += '\n';
+}
+
+TableRenderer& TableRenderer::cell(const std::string& text) {
+    return cell(text.data(), text.size());
+}
+
+TableRenderer& TableRenderer::cell(const char* text, std::size_t length) {
+    buffer.append(text, length);
+    // The last column is not padded, so rows carry no trailing blanks
+    if (nextColumn + 1 < columns.size() && length < columns[nextColumn].width) {
+        buffer.append(columns[nextColumn].width - length, ' ');
+    }
+    ++nextColumn;
+    return *this;
+}
+
+TableRenderer& TableRenderer::cell(long long value) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%lld", value);
+    return cell(digits, static_cast<std::size_t>(length));
+}
+
+void TableRenderer::endRow() {
+    buffer += '\n';
+    nextColumn = 0;
+    flushIfFull();
+}
+
+void TableRenderer::pageSummary(const ListingPage& page, std::size_t total) {
+    if (page.offset == 0 && (page.limit == 0 || page.limit >= total)) {
+        return;
+    }
+    std::size_t first = (page.offset < total) ? page.offset + 1 : 0;
+    std::size_t last = (page.limit == 0 || page.offset + page.limit > total) ? total : page.offset + page.limit;
+    if (first == 0) {
+        last = 0;
+    }
+    line("Showing rows " + std::to_string(first) + "-" + std::to_string(last) +
+         " of " + std::to_string(total));
+}
+
+void TableRenderer::flushIfFull() {
+    if (buffer.size() >= TABLE_CHUNK_SIZE) {
+        flush();
+    }
+}
+
+void TableRenderer::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    // Anything already queued in std::cout must appear before the table
+    std::cout.flush();
+#ifdef _WIN32
+    std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+    std::fflush(stdout);
+#else
+    std::size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = ::write(STDOUT_FILENO, buffer.data() + written, buffer.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+#endif
+    buffer.clear();
+}
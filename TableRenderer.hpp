@@ -0,0 +1,66 @@
+#ifndef TABLERENDERER_HPP
+#define TABLERENDERER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Bytes buffered before the renderer hands a chunk to the console
+const std::size_t TABLE_CHUNK_SIZE = 64 * 1024;
+
+// One table column: title and padded width (like std::left << std::setw(width))
+struct TableColumn {
+    std::string title;
+    std::size_t width;
+};
+
+// Window of rows a listing prints; limit 0 means "no limit"
+struct ListingPage {
+    std::size_t offset = 0;
+    std::size_t limit = 0;
+
+    bool contains(std::size_t index) const {
+        return index >= offset && (limit == 0 || index - offset < limit);
+    }
+    bool pastEnd(std::size_t index) const {
+        return limit != 0 && index >= offset + limit;
+    }
+};
+
+// Page applied to every listing (set from --limit/--offset at startup)
+ListingPage& listingPage();
+
+/**
+ * Formats table output into one reusable buffer and writes it to stdout
+ * in TABLE_CHUNK_SIZE chunks, one write() call per chunk, instead of one
+ * flush per line. Column widths are fixed up front, so padding a cell is
+ * a single append.
+ */
+class TableRenderer {
+public:
+    explicit TableRenderer(std::vector<TableColumn> columns);
+    ~TableRenderer(); // flushes anything still buffered
+
+    void line(const std::string& text);   // raw text line
+    void header();                        // column titles and a rule
+
+    TableRenderer& cell(const std::string& text);
+    TableRenderer& cell(const char* text, std::size_t length);
+    TableRenderer& cell(long long value);
+    void endRow();
+
+    // Prints "Showing rows a-b of n" when the page hides rows
+    void pageSummary(const ListingPage& page, std::size_t total);
+
+    void flush();
+
+private:
+    std::vector<TableColumn> columns;
+    std::size_t ruleWidth;
+    std::size_t nextColumn;
+    std::string buffer;
+
+    void flushIfFull();
+};
+
+#endif // TABLERENDERER_HPP
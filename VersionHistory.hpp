@@ -0,0 +1,101 @@
+#ifndef VERSIONHISTORY_HPP
+#define VERSIONHISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+// Undo steps each store keeps unless configured otherwise
+const std::size_t DEFAULT_UNDO_DEPTH = 64;
+
+// How a version was made from the one before it
+enum class VersionEdit {
+    Base,  // first version kept
+    Push,  // one element added
+    Pop,   // one element removed
+    Reset  // contents replaced (file load, or a change made as a whole)
+};
+
+/**
+ * Linear undo history over immutable versions of a store.
+ *
+ * Versions are numbered from 0 (the contents when the history started);
+ * each recorded change gets the next number. Undo and redo only move the
+ * current position, so jumping between versions copies nothing; recording
+ * a change after an undo drops the versions that could have been redone
+ * and reuses their numbers. Only the newest depth + 1 versions are kept.
+ *
+ * Version is meant to be cheap to copy, like the persistent containers,
+ * so that keeping one per change shares almost all of the memory.
+ */
+template <typename Version>
+class VersionHistory {
+public:
+    VersionHistory(Version base, std::size_t depth) : first(0), position(0), depth(depth) {
+        entries.push_back(Entry{VersionEdit::Base, std::move(base)});
+    }
+
+    void record(VersionEdit edit, Version next) {
+        entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(position) + 1, entries.end());
+        entries.push_back(Entry{edit, std::move(next)});
+        if (entries.size() > depth + 1) {
+            entries.pop_front();
+            ++first;
+        }
+        position = entries.size() - 1;
+    }
+
+    const Version& current() const { return entries[position].version; }
+    const Version& oldest() const { return entries.front().version; }
+
+    // How the current version was made from the previous one
+    VersionEdit currentEdit() const { return entries[position].edit; }
+
+    bool canUndo() const { return position > 0; }
+    bool canRedo() const { return position + 1 < entries.size(); }
+
+    // Step back or forward one version; the caller checks canUndo/canRedo
+    void undo() { --position; }
+    void redo() { ++position; }
+
+    std::uint64_t currentNumber() const { return first + position; }
+    std::uint64_t oldestNumber() const { return first; }
+    std::uint64_t newestNumber() const { return first + entries.size() - 1; }
+
+    /**
+     * Replaces every kept version, oldest first, by remake(edit, version,
+     * previous), where previous is the version before it as already remade
+     * (null for the oldest). Numbers and the current position stay the same.
+     * Lets the owner move what the versions point to somewhere else.
+     */
+    template <typename Remake>
+    void remake(Remake remake) {
+        const Version* previous = nullptr;
+        for (Entry& entry : entries) {
+            entry.version = remake(entry.edit, entry.version, previous);
+            previous = &entry.version;
+        }
+    }
+
+    // Version with the given number (redoable ones included), or null if not kept
+    const Version* at(std::uint64_t number) const {
+        if (number < first || number > newestNumber()) {
+            return nullptr;
+        }
+        return &entries[static_cast<std::size_t>(number - first)].version;
+    }
+
+private:
+    struct Entry {
+        VersionEdit edit;
+        Version version;
+    };
+
+    std::deque<Entry> entries;
+    std::uint64_t first;    // number of entries.front()
+    std::size_t position;   // index of the current version
+    std::size_t depth;
+};
+
+#endif // VERSIONHISTORY_HPP
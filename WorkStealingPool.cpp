@@ -0,0 +1,146 @@
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Pool and deque index of the calling worker thread, if it is one
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local std::size_t currentQueue = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(std::size_t workerCount)
+    : nextQueue(0), available(0), unfinished(0), stopping(false) {
+    if (workerCount == 0) {
+        workerCount = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                            MAX_BACKGROUND_WORKERS);
+    }
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        queues.emplace_back(new Worker());
+    }
+    workers.reserve(workerCount);
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    std::size_t target = (currentPool == this) ? currentQueue
+                                               : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++unfinished;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++available;
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::submitLatest(const std::string& key, std::function<void()> task) {
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(keyedMutex);
+        KeyedSlot& slot = keyed[key];
+        slot.next = std::move(task); // a waiting task of this key is dropped
+        start = !slot.scheduled;
+        slot.scheduled = true;
+    }
+    if (start) {
+        submit([this, key] { drain(key); });
+    }
+}
+
+void WorkStealingPool::flush() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    idle.wait(lock, [this] { return unfinished == 0; });
+}
+
+// Runs the tasks of key one after another until none is waiting
+void WorkStealingPool::drain(const std::string& key) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(keyedMutex);
+            KeyedSlot& slot = keyed[key];
+            if (!slot.next) {
+                slot.scheduled = false;
+                return;
+            }
+            task = std::move(slot.next);
+            slot.next = nullptr;
+        }
+        task();
+    }
+}
+
+// Own newest task, else the oldest task of the first other worker that has one
+bool WorkStealingPool::take(std::size_t self, std::function<void()>& task) {
+    {
+        Worker& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t step = 1; step < queues.size(); ++step) {
+        Worker& victim = *queues[(self + step) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(std::size_t self) {
+    currentPool = this;
+    currentQueue = self;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [this] { return stopping || available > 0; });
+            if (available <= 0) {
+                return; // stopping, and flush() saw every task finish
+            }
+        }
+        std::function<void()> task;
+        if (!take(self, task)) {
+            // Counted but not pushed yet, or taken by another worker first
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            --available;
+        }
+        task();
+        task = nullptr; // release what the task captured before reporting it done
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--unfinished == 0) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Workers used unless a count is given: one per core, at most this many
+const std::size_t MAX_BACKGROUND_WORKERS = 4;
+
+/**
+ * Small work-stealing thread pool for background file writes.
+ *
+ * Every worker owns a deque. Tasks submitted from outside the pool are
+ * dealt round-robin to the workers; a task submitted by a worker goes to
+ * that worker's own deque. Workers take their newest task first and, when
+ * they run dry, steal the oldest task of another worker.
+ *
+ * submitLatest() serializes the tasks of one key (a file name): they run in
+ * submission order, and a task still waiting is replaced by a newer one,
+ * since only the newest contents of a file are worth writing.
+ *
+ * flush() waits until every submitted task has finished; the destructor
+ * flushes before stopping the workers. Neither may be called from a task.
+ */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t workers = 0); // 0: one per core, up to MAX_BACKGROUND_WORKERS
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void submitLatest(const std::string& key, std::function<void()> task);
+    void flush();
+
+    std::size_t workerCount() const { return workers.size(); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks; // owner takes the back, thieves the front
+    };
+
+    // Newest waiting task of a key, and whether a drain of the key is queued or running
+    struct KeyedSlot {
+        std::function<void()> next;
+        bool scheduled = false;
+    };
+
+    bool take(std::size_t self, std::function<void()>& task);
+    void drain(const std::string& key);
+    void run(std::size_t self);
+
+    std::vector<std::unique_ptr<Worker>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> nextQueue;
+
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    long available;         // tasks in the deques, guarded by stateMutex
+    std::size_t unfinished; // submitted and not yet finished
+    bool stopping;
+
+    std::mutex keyedMutex;
+    std::unordered_map<std::string, KeyedSlot> keyed;
+};
+
+#endif // WORKSTEALINGPOOL_HPP
@@ -5,435 +5,704 @@
  * This module focuses on Role 4 requirements only.
  */
 
-#include <fstream>
+#include "ambulance_dispatcher.hpp"
+#include "HospitalState.hpp"
+#include "TableRenderer.hpp"
+#include "Metrics.hpp"
+#include "WorkStealingPool.hpp"
+#include "DuplicateFilter.hpp"
 #include <iostream>
-#include <iomanip>
+#include <cstdlib>
 #include <limits>
-#include <sstream>
 #include <string>
-#include <ctime>
+#include <vector>
+#include <algorithm>
 #include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 
-// Fixed settings
-const int MAX_AMBULANCES = 10;
-const int DUTY_HOURS = 8;
-const std::time_t DUTY_SECONDS = static_cast<std::time_t>(DUTY_HOURS) * 3600;
-const int BASE_HOUR = 0; // shifts always start counting from midnight
-const char* const SCHEDULE_FILENAME = "data/ambulance_schedule.csv";
-
-/**
- * Basic data holder for ambulance information.
- */
-struct Ambulance {
-    std::string id;
-    std::string driverName;
-};
-
-/**
- * Circular queue implementation dedicated to ambulance scheduling.
- */
-class AmbulanceScheduler {
-public:
-    AmbulanceScheduler()
-        : frontIndex(0), count(0), currentStartDate(todayAtMidnight()), nextId(1) {}
-
-    /**
-     * Adds a new ambulance to the active duty rotation.
-     * Returns the assigned ambulance ID, or an empty string if the queue is full.
-     */
-    std::string registerAmbulance(const Ambulance& ambulance) {
-        if (isFull()) {
-            return "";
+DutyTimeline::DutyTimeline(std::vector<std::string> ids, std::vector<DutyInterval> shifts,
+                           std::time_t origin, std::time_t horizon, int requiredCrews)
+    : ids(std::move(ids)), shifts(std::move(shifts)), from(origin), until(horizon),
+      required(requiredCrews) {
+    std::vector<std::pair<std::time_t, int>> changes;
+    changes.reserve(this->shifts.size() * 2 + 2);
+    changes.emplace_back(from, 0);
+    for (const DutyInterval& shift : this->shifts) {
+        longest = std::max(longest, shift.end - shift.start);
+        changes.emplace_back(shift.start, 1);
+        changes.emplace_back(shift.end, -1);
+    }
+    std::sort(changes.begin(), changes.end());
+
+    int crews = 0;
+    for (const auto& change : changes) {
+        crews += change.second;
+        if (!steps.empty() && steps.back().first == change.first) {
+            steps.back().second = crews;
+        } else {
+            steps.emplace_back(change.first, crews);
         }
+    }
 
-        int insertionIndex = (frontIndex + count) % MAX_AMBULANCES;
-        queue[insertionIndex] = ambulance;
-        if (queue[insertionIndex].id.empty()) {
-            queue[insertionIndex].id = formatAmbulanceId(nextId++);
+    // Gaps within [from, until), merged across steps that are all short
+    for (std::size_t i = 0; i < steps.size() && steps[i].first < until; ++i) {
+        if (steps[i].second >= required) {
+            continue;
         }
-        ++count;
-        if (count == 1) {
-            currentStartDate = todayAtMidnight();
+        std::time_t end = (i + 1 < steps.size()) ? std::min(steps[i + 1].first, until) : until;
+        if (!gaps.empty() && gaps.back().end == steps[i].first && gaps.back().crews == steps[i].second) {
+            gaps.back().end = end;
+        } else if (end > steps[i].first) {
+            gaps.push_back(CoverageGap{steps[i].first, end, steps[i].second});
         }
-        return queue[insertionIndex].id;
     }
+}
 
-    /**
-     * Rotates the queue so the next ambulance takes the upcoming shift.
-     * Returns false if there are fewer than two ambulances to rotate.
-     * Also advances the schedule start time by one duty block.
-     */
-    bool rotateShift() {
-        if (count <= 1) {
-            return false;
+void DutyTimeline::onDutyAt(std::time_t t, std::vector<DutyInterval>& out) const {
+    if (t < from || t >= until) {
+        return;
+    }
+    auto last = std::upper_bound(shifts.begin(), shifts.end(), t,
+                                 [](std::time_t value, const DutyInterval& shift) { return value < shift.start; });
+    for (auto it = last; it != shifts.begin();) {
+        --it;
+        if (t - it->start >= longest) {
+            break;
         }
+        if (t < it->end) {
+            out.push_back(*it);
+        }
+    }
+}
 
-        Ambulance completedShift;
-        dequeue(completedShift);
-        registerAmbulance(completedShift);
-        currentStartDate += DUTY_SECONDS;
-        return true;
+int DutyTimeline::crewsOnDutyAt(std::time_t t) const {
+    if (t < from || t >= until) {
+        return 0;
     }
+    auto after = std::upper_bound(steps.begin(), steps.end(), t,
+                                  [](std::time_t value, const std::pair<std::time_t, int>& step) {
+                                      return value < step.first;
+                                  });
+    return (after == steps.begin()) ? 0 : std::prev(after)->second;
+}
 
-    /**
-     * Displays the current rotation order in a readable table.
-     * Shows the fixed duty duration for clarity.
-     */
-    void displaySchedule() const {
-        if (isEmpty()) {
-            std::cout << "\nNo ambulances registered yet.\n";
-            return;
-        }
+void DutyTimeline::coverageGaps(std::time_t start, std::time_t end, std::vector<CoverageGap>& out) const {
+    auto it = std::upper_bound(gaps.begin(), gaps.end(), start,
+                               [](std::time_t value, const CoverageGap& gap) { return value < gap.end; });
+    for (; it != gaps.end() && it->start < end; ++it) {
+        out.push_back(CoverageGap{std::max(it->start, start), std::min(it->end, end), it->crews});
+    }
+}
 
-        std::cout << "\nCurrent Ambulance Rotation (each shift: "
-                  << DUTY_HOURS << " hours)\n";
+AmbulanceScheduler::AmbulanceScheduler()
+    : dutyStart(), nextId(1), crews(1), timelineStale(true), writer(nullptr) {
+    dutyStart[0] = todayAtMidnight();
+}
+
+std::string AmbulanceScheduler::registerAmbulance(const Ambulance& ambulance) {
+    std::time_t block = blockStart();
+    if (ambulance.shiftHours < 1 || ambulance.shiftHours > MAX_SHIFT_HOURS ||
+        !rotation.push_back(ambulance)) {
+        return "";
+    }
+
+    Ambulance& added = rotation[rotation.size() - 1];
+    if (added.id.empty()) {
+        added.id = formatAmbulanceId(nextId++);
+    }
+    std::size_t position = rotation.size() - 1;
+    if (position < static_cast<std::size_t>(crews)) {
+        // Fills a crew slot straight away, alongside the current block
+        dutyStart[position] = (position == 0) ? todayAtMidnight() : block;
+        sortOnDuty();
+    }
+    timelineStale = true;
+    recordChange();
+    return added.id;
+}
+
+bool AmbulanceScheduler::rotateShift() {
+    if (rotation.size() <= static_cast<std::size_t>(crews)) {
+        return false;
+    }
+
+    std::time_t handover = shiftEnd(0);
+    rotation.rotate(); // the completed shift goes to the back
+    for (int i = 1; i < crews; ++i) {
+        dutyStart[i - 1] = dutyStart[i];
+    }
+    dutyStart[crews - 1] = handover;
+    sortOnDuty();
+    timelineStale = true;
+    recordChange();
+    return true;
+}
+
+bool AmbulanceScheduler::setCrewsPerShift(int count) {
+    if (count < 1 || count > MAX_AMBULANCES) {
+        return false;
+    }
+    std::time_t start = blockStart();
+    crews = count;
+    for (int i = 0; i < crews; ++i) {
+        dutyStart[i] = start;
+    }
+    sortOnDuty();
+    timelineStale = true;
+    recordChange();
+    return true;
+}
 
-        int currentIndex = frontIndex;
+const DutyTimeline& AmbulanceScheduler::dutyTimeline(std::time_t until) const {
+    if (timelineStale || until > timeline.horizon()) {
+        std::time_t horizon = std::max(until, blockStart() + DEFAULT_TIMELINE_DAYS * 24 * SECONDS_PER_HOUR);
+        timeline = buildTimeline(horizon);
+        timelineStale = false;
+    }
+    return timeline;
+}
+
+void AmbulanceScheduler::displaySchedule() const {
+    if (isEmpty()) {
+        std::cout << "\nNo ambulances registered yet.\n";
+        return;
+    }
+
+    const int count = size();
+    const int onDuty = std::min(crews, count);
+    bool uniform = true;
+    for (int i = 1; i < count; ++i) {
+        uniform = uniform && rotation[static_cast<std::size_t>(i)].shiftHours == rotation[0].shiftHours;
+    }
+    std::cout << "\nCurrent Ambulance Rotation (";
+    if (uniform) {
+        std::cout << "each shift: " << rotation[0].shiftHours << " hours";
+    } else {
+        std::cout << "shift lengths vary by ambulance";
+    }
+    if (crews > 1) {
+        std::cout << ", " << crews << " on duty at a time";
+    }
+    std::cout << ")\n";
+
+    if (crews == 1) {
         std::cout << "Current duty ambulance: Ambulance "
-                  << queue[currentIndex].id << " ("
-                  << queue[currentIndex].driverName << ")\n";
-
-        if (count >= 2) {
-            int nextIndex = (frontIndex + 1) % MAX_AMBULANCES;
-            std::cout << "Next duty ambulance: Ambulance "
-                      << queue[nextIndex].id << " ("
-                      << queue[nextIndex].driverName << ")\n";
-        } else if (count == 1) {
-            std::cout << "No standby ambulances. Only one ambulance in rotation.\n";
+                  << rotation[0].id << " ("
+                  << rotation[0].driverName << ")\n";
+    } else {
+        std::cout << "Ambulances on duty:";
+        for (int i = 0; i < onDuty; ++i) {
+            const Ambulance& ambulance = rotation[static_cast<std::size_t>(i)];
+            std::cout << (i ? ", " : " ") << ambulance.id << " (" << ambulance.driverName << ")";
         }
+        std::cout << '\n';
+    }
 
-        std::cout << std::left
-                  << std::setw(10) << "Position"
-                  << std::setw(15) << "Ambulance ID"
-                  << std::setw(20) << "Driver"
-                  << std::setw(16) << "Duty Status"
-                  << std::setw(20) << "Start Time"
-                  << std::setw(20) << "End Time" << '\n';
-        std::cout << std::string(101, '-') << '\n';
-
-        for (int i = 0; i < count; ++i) {
-            int index = (frontIndex + i) % MAX_AMBULANCES;
-            std::time_t slotTime = currentStartDate + (static_cast<std::time_t>(i) * DUTY_SECONDS);
-            std::string timeLabel = "N/A";
-            std::string endTimeLabel = "N/A";
-
-            if (std::tm* startPtr = std::localtime(&slotTime)) {
-                std::tm startTime = *startPtr;
-                char buffer[32];
-                if (std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &startTime)) {
-                    timeLabel = buffer;
-                }
+    if (count > crews) {
+        const Ambulance& next = rotation[static_cast<std::size_t>(crews)];
+        std::cout << "Next duty ambulance: Ambulance "
+                  << next.id << " ("
+                  << next.driverName << ")\n";
+    } else if (count == 1) {
+        std::cout << "No standby ambulances. Only one ambulance in rotation.\n";
+    } else {
+        std::cout << "No standby ambulances. Every ambulance is on duty.\n";
+    }
+    if (count < crews) {
+        std::cout << "Warning: " << crews - count << " crew slot(s) have no ambulance.\n";
+    }
 
-                std::tm endTime = startTime;
-                endTime.tm_hour += DUTY_HOURS;
-                std::mktime(&endTime); // normalize date rollovers
-                if (std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &endTime)) {
-                    endTimeLabel = buffer;
-                }
-            }
+    std::time_t starts[MAX_AMBULANCES];
+    projectStarts(starts);
 
-            std::string dutyStatus = (i == 0) ? "In Duty" : "Not in Duty";
+    const ListingPage& page = listingPage();
+    TableRenderer table({{"Position", 10}, {"Ambulance ID", 15}, {"Driver", 20},
+                         {"Duty Status", 16}, {"Start Time", 20}, {"End Time", 20}});
+    table.header();
 
-            std::cout << std::setw(10) << (i + 1)
-                      << std::setw(15) << queue[index].id
-                      << std::setw(20) << queue[index].driverName
-                      << std::setw(16) << dutyStatus
-                      << std::setw(20) << timeLabel
-                      << std::setw(20) << endTimeLabel << '\n';
+    for (int i = 0; i < count; ++i) {
+        if (!page.contains(static_cast<std::size_t>(i))) {
+            continue;
         }
+        const Ambulance& ambulance = rotation[static_cast<std::size_t>(i)];
+        table.cell(i + 1)
+             .cell(ambulance.id)
+             .cell(ambulance.driverName)
+             .cell(i < onDuty ? "In Duty" : "Not in Duty")
+             .cell(formatDateTime(starts[i]))
+             .cell(formatDateTime(starts[i] + ambulance.shiftHours * SECONDS_PER_HOUR));
+        table.endRow();
     }
+    table.pageSummary(page, static_cast<std::size_t>(count));
+}
 
-    /**
-     * Writes the current schedule to a CSV file on disk.
-     * Returns false if the queue is empty or the file cannot be opened.
-     */
-    bool saveScheduleToCsv(const std::string& filename) const {
+bool AmbulanceScheduler::saveScheduleToCsv(const std::string& filename) const {
+    HOSPITAL_METRIC_SCOPE(MetricId::ScheduleSave);
+    std::ofstream outFile(filename.c_str());
+    if (!outFile) {
+        return false;
+    }
+    writeSchedule(outFile);
+    return true;
+}
+
+void AmbulanceScheduler::saveScheduleLater(const std::string& filename) const {
+    if (!writer) {
+        if (!saveScheduleToCsv(filename)) {
+            std::cout << "Warning: Failed to update schedule file.\n";
+        }
+        return;
+    }
+    std::ostringstream rendered;
+    writeSchedule(rendered);
+    writer->submitLatest(filename, [filename, text = rendered.str()] {
+        HOSPITAL_METRIC_SCOPE(MetricId::ScheduleSave);
         std::ofstream outFile(filename.c_str());
-        if (!outFile) {
+        if (!outFile.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+            std::cout << "Warning: Failed to update schedule file.\n";
+        }
+    });
+}
+
+bool AmbulanceScheduler::loadScheduleFromCsv(const std::string& filename) {
+    HOSPITAL_METRIC_SCOPE(MetricId::ScheduleLoad);
+    std::ifstream inFile(filename.c_str());
+    if (!inFile) {
+        std::ofstream newFile(filename.c_str());
+        if (!newFile) {
             return false;
         }
+        newFile << "Position,Ambulance ID,Driver,Duty Status,Start Time,End Time\n";
+        resetScheduleState();
+        recordChange();
+        return true;
+    }
 
-        outFile << "Position,Ambulance ID,Driver,Duty Status,Start Time,End Time\n";
+    Ambulance onDutyRows[MAX_AMBULANCES];
+    std::time_t onDutyStarts[MAX_AMBULANCES];
+    Ambulance waitingRows[MAX_AMBULANCES];
+    int onDutyCount = 0;
+    int waitingCount = 0;
+    // Explicit ids are "A" and at most 7 digits (extractNumericId), so always take the exact bitmap path
+    DuplicateIdFilter duplicates(0);
+    int skipped = 0;
+    int renumbered = 0;
+    std::time_t firstStart = todayAtMidnight();
+    int highestId = 0;
+    bool firstRow = true;
+
+    std::string line;
+    if (!std::getline(inFile, line)) {
+        resetScheduleState();
+        recordChange();
+        return true;
+    }
 
-        for (int i = 0; i < count; ++i) {
-            int index = (frontIndex + i) % MAX_AMBULANCES;
-            std::time_t slotTime = currentStartDate + (static_cast<std::time_t>(i) * DUTY_SECONDS);
-            std::string startLabel = "N/A";
-            std::string endLabel = "N/A";
+    // First pass: rows without a valid ID are numbered above every explicit
+    // one in the file, so a generated ID never takes a later row's
+    int generatedId = 0;
+    while (std::getline(inFile, line)) {
+        std::string columns[6];
+        if (!line.empty() && splitCsvLine(line, columns, 6) && !columns[2].empty()) {
+            generatedId = std::max(generatedId, extractNumericId(columns[1]));
+        }
+    }
+    inFile.clear();
+    inFile.seekg(0);
+    std::getline(inFile, line); // header
 
-            if (std::tm* startPtr = std::localtime(&slotTime)) {
-                std::tm startTime = *startPtr;
-                char buffer[32];
-                if (std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &startTime)) {
-                    startLabel = buffer;
-                }
+    while (std::getline(inFile, line)) {
+        if (line.empty()) {
+            continue;
+        }
 
-                std::tm endTime = startTime;
-                endTime.tm_hour += DUTY_HOURS;
-                std::mktime(&endTime);
-                if (std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &endTime)) {
-                    endLabel = buffer;
-                }
-            }
+        std::string columns[6];
+        if (!splitCsvLine(line, columns, 6)) {
+            continue;
+        }
 
-            outFile << (i + 1) << ','
-                    << queue[index].id << ','
-                    << queue[index].driverName << ','
-                    << ((i == 0) ? "In Duty" : "Not in Duty") << ','
-                    << startLabel << ','
-                    << endLabel << '\n';
+        Ambulance ambulance{};
+        ambulance.driverName = columns[2];
+
+        if (ambulance.driverName.empty()) {
+            continue;
         }
 
-        return true;
-    }
+        int numericId = extractNumericId(columns[1]);
+        if (numericId > 0) {
+            ambulance.id = formatAmbulanceId(numericId);
+            if (!duplicates.firstSighting(ambulance.id)) {
+                ++skipped; // a later row for a unit already loaded
+                continue;
+            }
+        } else {
+            if (!columns[1].empty()) {
+                ++renumbered;
+            }
+            numericId = ++generatedId; // unique: above every explicit ID
+            ambulance.id = formatAmbulanceId(numericId);
+        }
+
+        std::time_t start;
+        std::time_t end;
+        bool timed = parseDateTime(columns[4], start);
+        if (timed && parseDateTime(columns[5], end) && end > start &&
+            end - start <= MAX_SHIFT_HOURS * SECONDS_PER_HOUR) {
+            ambulance.shiftHours = static_cast<int>((end - start + SECONDS_PER_HOUR / 2) / SECONDS_PER_HOUR);
+        }
 
-    /**
-     * Loads a schedule from a CSV file, replacing the current queue contents.
-     * Returns false if the file cannot be opened or no valid rows are found.
-     */
-    bool loadScheduleFromCsv(const std::string& filename) {
-        std::ifstream inFile(filename.c_str());
-        if (!inFile) {
-            std::ofstream newFile(filename.c_str());
-            if (!newFile) {
-                return false;
+        if (firstRow) {
+            if (timed) {
+                firstStart = start;
             }
-            newFile << "Position,Ambulance ID,Driver,Duty Status,Start Time,End Time\n";
-            resetScheduleState();
-            return true;
+            firstRow = false;
         }
 
-        Ambulance tempQueue[MAX_AMBULANCES];
-        int tempCount = 0;
-        std::time_t tempStartDate = todayAtMidnight();
-        int highestId = 0;
-        bool firstRow = true;
+        if (onDutyCount + waitingCount >= MAX_AMBULANCES) {
+            break;
+        }
 
-        std::string line;
-        if (!std::getline(inFile, line)) {
-            resetScheduleState();
-            return true;
+        highestId = std::max(highestId, numericId);
+        if (columns[3] == "In Duty") {
+            onDutyStarts[onDutyCount] = timed ? start : firstStart;
+            onDutyRows[onDutyCount++] = ambulance;
+        } else {
+            waitingRows[waitingCount++] = ambulance;
         }
+    }
 
-        while (std::getline(inFile, line)) {
-            if (line.empty()) {
-                continue;
-            }
+    resetScheduleState();
+    nextId = (highestId >= 1) ? (highestId + 1) : 1;
 
-            std::string columns[6];
-            if (!splitCsvLine(line, columns, 6)) {
-                continue;
-            }
+    if (onDutyCount == 0 && waitingCount > 0) {
+        // Older files without a marked row: the first one is on duty
+        onDutyStarts[0] = firstStart;
+        onDutyRows[onDutyCount++] = waitingRows[0];
+        std::copy(waitingRows + 1, waitingRows + waitingCount, waitingRows);
+        --waitingCount;
+    }
+    crews = std::max(1, onDutyCount);
+    for (int i = 0; i < onDutyCount; ++i) {
+        rotation.push_back(onDutyRows[i]);
+        dutyStart[i] = onDutyStarts[i];
+    }
+    if (onDutyCount == 0) {
+        dutyStart[0] = firstStart;
+    }
+    for (int i = 0; i < waitingCount; ++i) {
+        rotation.push_back(waitingRows[i]);
+    }
+    sortOnDuty();
+    recordChange();
+    if (skipped > 0) {
+        std::cout << "Warning: skipped " << skipped << " duplicate ambulance ID(s) in '" << filename << "'.\n";
+    }
+    if (renumbered > 0) {
+        std::cout << "Warning: gave " << renumbered << " ambulance(s) with an invalid ID a new one in '"
+                  << filename << "'.\n";
+    }
 
-            Ambulance ambulance{};
-            int numericId = 0;
+    return true;
+}
 
-            if (!columns[1].empty()) {
-                numericId = extractNumericId(columns[1]);
-            }
+void AmbulanceScheduler::enableHistory(std::size_t depth) {
+    if (depth == 0) {
+        history.reset();
+        return;
+    }
+    history.reset(new VersionHistory<RotationVersion>(currentVersion(), depth));
+}
 
-            if (numericId <= 0) {
-                numericId = highestId + 1;
-            }
+bool AmbulanceScheduler::undo() {
+    if (!history || !history->canUndo()) {
+        return false;
+    }
+    history->undo();
+    restore(history->current());
+    return true;
+}
 
-            ambulance.id = formatAmbulanceId(numericId);
-            if (numericId > highestId) {
-                highestId = numericId;
-            }
+bool AmbulanceScheduler::redo() {
+    if (!history || !history->canRedo()) {
+        return false;
+    }
+    history->redo();
+    restore(history->current());
+    return true;
+}
 
-            ambulance.driverName = columns[2];
+bool AmbulanceScheduler::parseDateTime(const std::string& text, std::time_t& result) {
+    if (text.size() < 16) {
+        return false;
+    }
 
-            if (ambulance.driverName.empty()) {
-                continue;
-            }
+    int year = parseNumber(text, 0, 4);
+    int month = parseNumber(text, 5, 2);
+    int day = parseNumber(text, 8, 2);
+    int hour = parseNumber(text, 11, 2);
+    int minute = parseNumber(text, 14, 2);
 
-            if (firstRow) {
-                std::time_t parsedStart;
-                if (parseDateTime(columns[4], parsedStart)) {
-                    tempStartDate = parsedStart;
-                }
-                firstRow = false;
-            }
+    if (year < 1900 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
 
-            if (tempCount >= MAX_AMBULANCES) {
-                break;
-            }
+    std::tm tmValue{};
+    tmValue.tm_year = year - 1900;
+    tmValue.tm_mon = month - 1;
+    tmValue.tm_mday = day;
+    tmValue.tm_hour = hour;
+    tmValue.tm_min = minute;
+    tmValue.tm_sec = 0;
+    tmValue.tm_isdst = -1;
+
+    std::time_t converted = std::mktime(&tmValue);
+    if (converted == static_cast<std::time_t>(-1)) {
+        return false;
+    }
 
-            tempQueue[tempCount++] = ambulance;
+    result = converted;
+    return true;
+}
+
+std::string AmbulanceScheduler::formatDateTime(std::time_t value) {
+    std::tm local;
+    if (toLocalTime(value, local)) {
+        char buffer[32];
+        if (std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &local)) {
+            return buffer;
         }
+    }
+    return "N/A";
+}
 
-        resetScheduleState();
-        currentStartDate = tempStartDate;
-        nextId = (highestId >= 1) ? (highestId + 1) : 1;
+bool AmbulanceScheduler::toLocalTime(std::time_t value, std::tm& local) {
+#ifdef _WIN32
+    return localtime_s(&local, &value) == 0;
+#else
+    return localtime_r(&value, &local) != nullptr;
+#endif
+}
 
-        for (int i = 0; i < tempCount; ++i) {
-            queue[i] = tempQueue[i];
-        }
-        count = tempCount;
+void AmbulanceScheduler::writeSchedule(std::ostream& out) const {
+    out << "Position,Ambulance ID,Driver,Duty Status,Start Time,End Time\n";
+
+    std::time_t starts[MAX_AMBULANCES];
+    projectStarts(starts);
+    const int count = size();
+    const int onDuty = std::min(crews, count);
+    for (int i = 0; i < count; ++i) {
+        const Ambulance& ambulance = rotation[static_cast<std::size_t>(i)];
+        out << (i + 1) << ','
+            << ambulance.id << ','
+            << ambulance.driverName << ','
+            << ((i < onDuty) ? "In Duty" : "Not in Duty") << ','
+            << formatDateTime(starts[i]) << ','
+            << formatDateTime(starts[i] + ambulance.shiftHours * SECONDS_PER_HOUR) << '\n';
+    }
+}
 
-        return true;
+RotationVersion AmbulanceScheduler::currentVersion() const {
+    RotationVersion version;
+    version.rotation = rotation;
+    std::copy(dutyStart, dutyStart + MAX_AMBULANCES, version.dutyStart);
+    version.nextId = nextId;
+    version.crews = crews;
+    return version;
+}
+
+void AmbulanceScheduler::restore(const RotationVersion& version) {
+    rotation = version.rotation;
+    std::copy(version.dutyStart, version.dutyStart + MAX_AMBULANCES, dutyStart);
+    nextId = version.nextId;
+    crews = version.crews;
+    timelineStale = true;
+}
+
+void AmbulanceScheduler::recordChange() {
+    if (history) {
+        history->record(VersionEdit::Reset, currentVersion());
     }
+}
 
-private:
-    Ambulance queue[MAX_AMBULANCES];
-    int frontIndex;
-    int count;
-    std::time_t currentStartDate; // midnight of the scheduling day
-    int nextId;
-
-    /**
-     * Resets the scheduler to an empty state with default timing and IDs.
-     */
-    void resetScheduleState() {
-        frontIndex = 0;
-        count = 0;
-        currentStartDate = todayAtMidnight();
-        nextId = 1;
-    }
-
-    /**
-     * Splits a CSV line into the expected number of columns (no quoted commas).
-     */
-    bool splitCsvLine(const std::string& line, std::string* columns, int expectedColumns) const {
-        int col = 0;
-        std::size_t start = 0;
-
-        while (col < expectedColumns - 1) {
-            std::size_t commaPos = line.find(',', start);
-            if (commaPos == std::string::npos) {
-                return false;
-            }
-            columns[col++] = line.substr(start, commaPos - start);
-            start = commaPos + 1;
-        }
+void AmbulanceScheduler::resetScheduleState() {
+    rotation.clear();
+    dutyStart[0] = todayAtMidnight();
+    nextId = 1;
+    crews = 1;
+    timelineStale = true;
+}
 
-        columns[col] = line.substr(start);
-        return true;
+std::time_t AmbulanceScheduler::blockStart() const {
+    std::size_t onDuty = std::min(rotation.size(), static_cast<std::size_t>(crews));
+    std::time_t earliest = dutyStart[0];
+    for (std::size_t i = 1; i < onDuty; ++i) {
+        earliest = std::min(earliest, dutyStart[i]);
     }
+    return earliest;
+}
 
-    /**
-     * Extracts the numeric portion from an ambulance ID like "A01".
-     */
-    int extractNumericId(const std::string& id) const {
-        if (id.size() < 2 || id[0] != 'A') {
-            return 0;
+void AmbulanceScheduler::sortOnDuty() {
+    std::size_t onDuty = std::min(rotation.size(), static_cast<std::size_t>(crews));
+    for (std::size_t i = 1; i < onDuty; ++i) {
+        for (std::size_t j = i; j > 0 && shiftEnd(j) < shiftEnd(j - 1); --j) {
+            std::swap(rotation[j], rotation[j - 1]);
+            std::swap(dutyStart[j], dutyStart[j - 1]);
         }
+    }
+}
 
-        int value = 0;
-        for (std::size_t i = 1; i < id.size(); ++i) {
-            unsigned char ch = static_cast<unsigned char>(id[i]);
-            if (!std::isdigit(ch)) {
-                return 0;
-            }
-            value = value * 10 + (id[i] - '0');
+template <typename Visit>
+void AmbulanceScheduler::forEachShift(Visit visit) const {
+    const int count = size();
+    if (count == 0) {
+        return;
+    }
+    const int onDuty = std::min(crews, count);
+    int slotUnit[MAX_AMBULANCES];
+    std::time_t slotEnd[MAX_AMBULANCES];
+    int waiting[MAX_AMBULANCES];
+    int waitingHead = 0;
+    int waitingCount = 0;
+
+    // On-duty shifts first, by start (they are stored by end)
+    int order[MAX_AMBULANCES];
+    for (int i = 0; i < onDuty; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order, order + onDuty, [this](int a, int b) { return dutyStart[a] < dutyStart[b]; });
+    for (int i = 0; i < onDuty; ++i) {
+        int position = order[i];
+        slotUnit[i] = position;
+        slotEnd[i] = shiftEnd(static_cast<std::size_t>(position));
+        if (!visit(position, dutyStart[position], slotEnd[i])) {
+            return;
         }
-        return value;
+    }
+    for (int i = onDuty; i < count; ++i) {
+        waiting[waitingCount++] = i;
     }
 
-    /**
-     * Parses a datetime string formatted as "YYYY-MM-DD HH:MM".
-     */
-    bool parseDateTime(const std::string& text, std::time_t& result) const {
-        if (text.size() < 16) {
-            return false;
+    while (true) {
+        int slot = 0;
+        for (int i = 1; i < onDuty; ++i) {
+            if (slotEnd[i] < slotEnd[slot]) {
+                slot = i;
+            }
         }
+        // The finished unit queues behind the waiting ones and the next one starts
+        waiting[(waitingHead + waitingCount) % MAX_AMBULANCES] = slotUnit[slot];
+        int position = waiting[waitingHead];
+        waitingHead = (waitingHead + 1) % MAX_AMBULANCES;
+        std::time_t start = slotEnd[slot];
+        slotUnit[slot] = position;
+        slotEnd[slot] = start + rotation[static_cast<std::size_t>(position)].shiftHours * SECONDS_PER_HOUR;
+        if (!visit(position, start, slotEnd[slot])) {
+            return;
+        }
+    }
+}
 
-        int year = parseNumber(text, 0, 4);
-        int month = parseNumber(text, 5, 2);
-        int day = parseNumber(text, 8, 2);
-        int hour = parseNumber(text, 11, 2);
-        int minute = parseNumber(text, 14, 2);
-
-        if (year < 1900 || month < 1 || month > 12 || day < 1 || day > 31 ||
-            hour < 0 || hour > 23 || minute < 0 || minute > 59) {
-            return false;
+void AmbulanceScheduler::projectStarts(std::time_t* starts) const {
+    int remaining = size();
+    bool seen[MAX_AMBULANCES] = {};
+    forEachShift([&](int position, std::time_t start, std::time_t) {
+        if (!seen[position]) {
+            seen[position] = true;
+            starts[position] = start;
+            --remaining;
         }
+        return remaining > 0;
+    });
+}
 
-        std::tm tmValue{};
-        tmValue.tm_year = year - 1900;
-        tmValue.tm_mon = month - 1;
-        tmValue.tm_mday = day;
-        tmValue.tm_hour = hour;
-        tmValue.tm_min = minute;
-        tmValue.tm_sec = 0;
-        tmValue.tm_isdst = -1;
-
-        std::time_t converted = std::mktime(&tmValue);
-        if (converted == static_cast<std::time_t>(-1)) {
+DutyTimeline AmbulanceScheduler::buildTimeline(std::time_t horizon) const {
+    std::vector<std::string> ids;
+    for (std::size_t i = 0; i < rotation.size(); ++i) {
+        ids.push_back(rotation[i].id);
+    }
+    std::vector<DutyInterval> shifts;
+    forEachShift([&](int position, std::time_t start, std::time_t end) {
+        if (start >= horizon) {
             return false;
         }
-
-        result = converted;
+        shifts.push_back(DutyInterval{start, end, position});
         return true;
+    });
+    // Before the last handover the crews that already left are unknown
+    std::time_t lastHandover = dutyStart[0];
+    for (std::size_t i = 1; i < std::min(rotation.size(), static_cast<std::size_t>(crews)); ++i) {
+        lastHandover = std::max(lastHandover, dutyStart[i]);
     }
+    return DutyTimeline(std::move(ids), std::move(shifts), lastHandover, horizon, crews);
+}
 
-    /**
-     * Parses a substring of digits into an integer, returning -1 if invalid.
-     */
-    int parseNumber(const std::string& text, std::size_t start, std::size_t length) const {
-        if (start + length > text.size()) {
-            return -1;
-        }
+bool AmbulanceScheduler::splitCsvLine(const std::string& line, std::string* columns, int expectedColumns) const {
+    int col = 0;
+    std::size_t start = 0;
 
-        int value = 0;
-        for (std::size_t i = 0; i < length; ++i) {
-            unsigned char ch = static_cast<unsigned char>(text[start + i]);
-            if (!std::isdigit(ch)) {
-                return -1;
-            }
-            value = value * 10 + (ch - '0');
-        }
-        return value;
-    }
-
-    /**
-     * Helper to compute today's date at 00:00:00 local time.
-     */
-    std::time_t todayAtMidnight() const {
-        std::time_t now = std::time(nullptr);
-        std::tm local = *std::localtime(&now);
-        local.tm_hour = BASE_HOUR;
-        local.tm_min = 0;
-        local.tm_sec = 0;
-        return std::mktime(&local);
-    }
-    /**
-     * Formats the numeric ambulance counter into ID style "A01", "A02", etc.
-     */
-    std::string formatAmbulanceId(int number) const {
-        std::ostringstream oss;
-        oss << 'A' << std::setfill('0') << std::setw(2) << number;
-        return oss.str();
-    }
-    /**
-     * Removes the ambulance at the front of the queue.
-     * Returns false when the queue is empty.
-     */
-    bool dequeue(Ambulance& removed) {
-        if (isEmpty()) {
+    while (col < expectedColumns - 1) {
+        std::size_t commaPos = line.find(',', start);
+        if (commaPos == std::string::npos) {
             return false;
         }
+        columns[col++] = line.substr(start, commaPos - start);
+        start = commaPos + 1;
+    }
 
-        removed = queue[frontIndex];
-        frontIndex = (frontIndex + 1) % MAX_AMBULANCES;
-        --count;
-        return true;
+    columns[col] = line.substr(start);
+    return true;
+}
+
+int AmbulanceScheduler::extractNumericId(const std::string& id) const {
+    if (id.size() < 2 || id[0] != 'A') {
+        return 0;
     }
 
-    /**
-     * Checks if the queue already holds the maximum number of ambulances.
-     */
-    bool isFull() const {
-        return count == MAX_AMBULANCES;
+    int value = 0;
+    for (std::size_t i = 1; i < id.size(); ++i) {
+        unsigned char ch = static_cast<unsigned char>(id[i]);
+        if (!std::isdigit(ch) || value >= 1000000) {
+            return 0; // not a number, or more than 7 digits
+        }
+        value = value * 10 + (id[i] - '0');
     }
+    return value;
+}
 
-    /**
-     * Checks if the queue currently holds no ambulances.
-     */
-    bool isEmpty() const {
-        return count == 0;
+int AmbulanceScheduler::parseNumber(const std::string& text, std::size_t start, std::size_t length) {
+    if (start + length > text.size()) {
+        return -1;
     }
-};
+
+    int value = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        unsigned char ch = static_cast<unsigned char>(text[start + i]);
+        if (!std::isdigit(ch)) {
+            return -1;
+        }
+        value = value * 10 + (ch - '0');
+    }
+    return value;
+}
+
+std::time_t AmbulanceScheduler::todayAtMidnight() const {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    toLocalTime(now, local);
+    local.tm_hour = BASE_HOUR;
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    return std::mktime(&local);
+}
+
+std::string AmbulanceScheduler::formatAmbulanceId(int number) const {
+    std::ostringstream oss;
+    oss << 'A' << std::setfill('0') << std::setw(2) << number;
+    return oss.str();
+}
 
 /**
  * Utility to safely obtain a line of input after numeric reads.
@@ -452,6 +721,14 @@ std::string promptRegisterAmbulance(AmbulanceScheduler& scheduler) {
     std::cout << "Enter driver name: ";
     std::getline(std::cin, ambulance.driverName);
 
+    std::string hours;
+    std::cout << "Enter shift length in hours (1-" << MAX_SHIFT_HOURS
+              << ", blank for " << DUTY_HOURS << "): ";
+    std::getline(std::cin, hours);
+    if (!hours.empty()) {
+        ambulance.shiftHours = std::atoi(hours.c_str());
+    }
+
     std::string assignedId = scheduler.registerAmbulance(ambulance);
     if (!assignedId.empty()) {
         std::cout << "Assigned ambulance ID: " << assignedId << '\n';
@@ -459,6 +736,48 @@ std::string promptRegisterAmbulance(AmbulanceScheduler& scheduler) {
     return assignedId;
 }
 
+/**
+ * Shows who is on duty at a chosen time and the coverage gaps in the
+ * following DEFAULT_TIMELINE_DAYS days.
+ */
+void promptDutyCoverage(const AmbulanceScheduler& scheduler) {
+    std::string text;
+    std::cout << "Enter date and time (YYYY-MM-DD HH:MM, blank for the current shift): ";
+    std::getline(std::cin, text);
+
+    const std::time_t horizonSeconds = DEFAULT_TIMELINE_DAYS * 24 * SECONDS_PER_HOUR;
+    std::time_t at;
+    if (text.empty()) {
+        at = scheduler.dutyTimeline(0).origin();
+    } else if (!AmbulanceScheduler::parseDateTime(text, at)) {
+        std::cout << "\nInvalid date. Use the format YYYY-MM-DD HH:MM.\n";
+        return;
+    }
+    const DutyTimeline& timeline = scheduler.dutyTimeline(at + horizonSeconds);
+
+    std::vector<DutyInterval> onDuty;
+    timeline.onDutyAt(at, onDuty);
+    std::cout << "\nOn duty at " << AmbulanceScheduler::formatDateTime(at) << ": ";
+    if (onDuty.empty()) {
+        std::cout << "none";
+    }
+    for (std::size_t i = 0; i < onDuty.size(); ++i) {
+        std::cout << (i ? ", " : "") << timeline.unitId(onDuty[i].unit)
+                  << " (until " << AmbulanceScheduler::formatDateTime(onDuty[i].end) << ")";
+    }
+    std::cout << '\n';
+
+    std::vector<CoverageGap> gaps;
+    timeline.coverageGaps(at, at + horizonSeconds, gaps);
+    std::cout << "Coverage gaps in the next " << DEFAULT_TIMELINE_DAYS << " days ("
+              << scheduler.crewsPerShift() << " required): " << gaps.size() << '\n';
+    for (const CoverageGap& gap : gaps) {
+        std::cout << "  " << AmbulanceScheduler::formatDateTime(gap.start) << " - "
+                  << AmbulanceScheduler::formatDateTime(gap.end) << "  "
+                  << gap.crews << " on duty\n";
+    }
+}
+
 /**
  * Presents the menu options to the dispatcher.
  */
@@ -467,7 +786,11 @@ void printMenu() {
               << "1. Register ambulance\n"
               << "2. Rotate ambulance shift\n"
               << "3. Display ambulance schedule\n"
-              << "4. Exit\n"
+              << "4. Set ambulances on duty per shift\n"
+              << "5. Check duty coverage\n"
+              << "6. Undo last change\n"
+              << "7. Redo undone change\n"
+              << "0. Exit\n"
               << "Choose an option: ";
 }
 
@@ -476,10 +799,10 @@ void printMenu() {
  * This function contains the original main() logic.
  */
 int runAmbulanceDispatcher() {
-    AmbulanceScheduler scheduler;
+    AmbulanceScheduler& scheduler = HospitalState::instance().ambulances();
     const std::string scheduleFilename = SCHEDULE_FILENAME;
 
-    if (!scheduler.loadScheduleFromCsv(scheduleFilename)) {
+    if (!HospitalState::instance().scheduleFileReady()) {
         std::cout << "Warning: Unable to initialize schedule file '"
                   << scheduleFilename << "'.\n";
     }
@@ -491,7 +814,7 @@ int runAmbulanceDispatcher() {
 
         int choice = 0;
         if (!(std::cin >> choice)) {
-            std::cout << "\nInvalid input. Please enter a number from 1 to 4.\n";
+            std::cout << "\nInvalid input. Please enter a number from 0 to 7.\n";
             std::cin.clear();
             discardLine();
             continue;
@@ -503,22 +826,20 @@ int runAmbulanceDispatcher() {
                 std::string newId = promptRegisterAmbulance(scheduler);
                 if (!newId.empty()) {
                     std::cout << "\nAmbulance registered successfully.\n";
-                    if (!scheduler.saveScheduleToCsv(scheduleFilename)) {
-                        std::cout << "Warning: Failed to update schedule file.\n";
-                    }
-                } else {
+                    scheduler.saveScheduleLater(scheduleFilename);
+                } else if (scheduler.size() == MAX_AMBULANCES) {
                     std::cout << "\nUnable to register ambulance. Queue is full.\n";
+                } else {
+                    std::cout << "\nUnable to register ambulance. Invalid shift length.\n";
                 }
                 break;
             }
             case 2: {
                 if (scheduler.rotateShift()) {
                     std::cout << "\nShift rotation completed. Next ambulance is on duty.\n";
-                    if (!scheduler.saveScheduleToCsv(scheduleFilename)) {
-                        std::cout << "Warning: Failed to update schedule file.\n";
-                    }
+                    scheduler.saveScheduleLater(scheduleFilename);
                 } else {
-                    std::cout << "\nNeed at least two ambulances to rotate shifts.\n";
+                    std::cout << "\nNeed a standby ambulance to rotate shifts.\n";
                 }
                 break;
             }
@@ -527,12 +848,42 @@ int runAmbulanceDispatcher() {
                 break;
             }
             case 4: {
+                std::cout << "Enter ambulances on duty at a time (1-" << MAX_AMBULANCES << "): ";
+                int count = 0;
+                if (!(std::cin >> count)) {
+                    std::cin.clear();
+                }
+                discardLine();
+                if (scheduler.setCrewsPerShift(count)) {
+                    std::cout << "\nNow " << count << " ambulance(s) on duty per shift.\n";
+                    scheduler.saveScheduleLater(scheduleFilename);
+                } else {
+                    std::cout << "\nInvalid count.\n";
+                }
+                break;
+            }
+            case 5: {
+                promptDutyCoverage(scheduler);
+                break;
+            }
+            case 6:
+            case 7: {
+                bool changed = (choice == 6) ? scheduler.undo() : scheduler.redo();
+                if (!changed) {
+                    std::cout << (choice == 6 ? "\nNothing to undo.\n" : "\nNothing to redo.\n");
+                    break;
+                }
+                std::cout << (choice == 6 ? "\nLast change undone.\n" : "\nChange redone.\n");
+                scheduler.saveScheduleLater(scheduleFilename);
+                break;
+            }
+            case 0: {
                 running = false;
                 std::cout << "\nExiting dispatcher module. Goodbye!\n";
                 break;
             }
             default:
-                std::cout << "\nUnknown option. Please choose between 1 and 4.\n";
+                std::cout << "\nUnknown option. Please choose between 0 and 7.\n";
                 break;
         }
     }
@@ -0,0 +1,328 @@
+/**
+ * Ambulance Dispatcher Module
+ *
+ * Circular queue used to manage ambulance rotations (Role 4).
+ * Shared by the interactive dispatcher menu and the command mode.
+ */
+
+#ifndef AMBULANCE_DISPATCHER_HPP
+#define AMBULANCE_DISPATCHER_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Containers.hpp"
+#include "VersionHistory.hpp"
+
+class WorkStealingPool;
+
+// Fixed settings
+constexpr int MAX_AMBULANCES = 10;
+const int DUTY_HOURS = 8;     // default shift length of a unit
+const int MAX_SHIFT_HOURS = 24;
+const std::time_t SECONDS_PER_HOUR = 3600;
+const int BASE_HOUR = 0; // shifts always start counting from midnight
+const int DEFAULT_TIMELINE_DAYS = 31; // horizon of the cached duty timeline
+const char* const SCHEDULE_FILENAME = "data/ambulance_schedule.csv";
+
+/**
+ * Basic data holder for ambulance information.
+ * Location and availability are used by the DispatchEngine; the duty
+ * rotation and its CSV file track id, driver and shift length.
+ */
+struct Ambulance {
+    std::string id;
+    std::string driverName;
+    double x = 0.0;        // km from the service area's south-west corner
+    double y = 0.0;
+    bool available = true; // free to take a call
+    int shiftHours = DUTY_HOURS;
+};
+
+// One shift worked by one unit; unit indexes DutyTimeline::unitId
+struct DutyInterval {
+    std::time_t start;
+    std::time_t end;
+    int unit;
+};
+
+// A stretch of time with fewer crews on duty than required
+struct CoverageGap {
+    std::time_t start;
+    std::time_t end;
+    int crews; // crews on duty during the gap
+};
+
+/**
+ * Projected duty shifts from the scheduler's current state up to a horizon.
+ *
+ * Shifts are kept sorted by start and the crew count as a step function, so
+ * "who is on duty at T" is a binary search plus a scan over the few shifts
+ * that can still be running (no shift is longer than the longest one seen),
+ * and coverage gaps are found by binary search in a precomputed list.
+ * Queries outside [origin(), horizon()) see no crews.
+ */
+class DutyTimeline {
+public:
+    DutyTimeline() = default;
+
+    DutyTimeline(std::vector<std::string> ids, std::vector<DutyInterval> shifts,
+                 std::time_t origin, std::time_t horizon, int requiredCrews);
+
+    std::time_t origin() const { return from; }
+    std::time_t horizon() const { return until; }
+    const std::vector<DutyInterval>& intervals() const { return shifts; }
+    const std::string& unitId(int unit) const { return ids[static_cast<std::size_t>(unit)]; }
+
+    /**
+     * Appends the shifts running at time t (start <= t < end) to out.
+     */
+    void onDutyAt(std::time_t t, std::vector<DutyInterval>& out) const;
+    int crewsOnDutyAt(std::time_t t) const;
+
+    /**
+     * Appends the coverage gaps overlapping [start, end) to out, clipped to it.
+     */
+    void coverageGaps(std::time_t start, std::time_t end, std::vector<CoverageGap>& out) const;
+
+private:
+    std::vector<std::string> ids;
+    std::vector<DutyInterval> shifts;                  // by start
+    std::vector<std::pair<std::time_t, int>> steps;    // crews on duty from each time on
+    std::vector<CoverageGap> gaps;
+    std::time_t from = 0;
+    std::time_t until = 0;
+    std::time_t longest = 0;
+    int required = 1;
+};
+
+/**
+ * Rotation state as kept by the undo history. The ring holds at most
+ * MAX_AMBULANCES units, so a version is a bounded copy rather than a
+ * shared structure.
+ */
+struct RotationVersion {
+    RingBuffer<Ambulance, MAX_AMBULANCES> rotation;
+    std::time_t dutyStart[MAX_AMBULANCES];
+    int nextId;
+    int crews;
+
+    // Calls visit(ambulance) in rotation order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (std::size_t i = 0; i < rotation.size(); ++i) {
+            visit(rotation[i]);
+        }
+    }
+};
+
+/**
+ * Circular queue dedicated to ambulance scheduling, over a fixed-capacity
+ * RingBuffer sized by MAX_AMBULANCES.
+ *
+ * The first crewsPerShift() units of the rotation are on duty, ordered by
+ * when their shift ends; the rest wait in order. At each handover the unit
+ * whose shift ends first goes to the back and the next waiting unit takes
+ * its crew slot, so with differing shift lengths the slots drift apart.
+ */
+class AmbulanceScheduler {
+public:
+    AmbulanceScheduler();
+
+    /**
+     * Adds a new ambulance to the active duty rotation.
+     * Returns the assigned ambulance ID, or an empty string if the queue is full
+     * or the shift length is outside 1..MAX_SHIFT_HOURS.
+     */
+    std::string registerAmbulance(const Ambulance& ambulance);
+
+    /**
+     * Hands the shift that ends first over to the next waiting ambulance.
+     * Returns false if no ambulance is waiting (at most crewsPerShift() units).
+     */
+    bool rotateShift();
+
+    /**
+     * Sets how many ambulances are on duty at once (1..MAX_AMBULANCES). The
+     * current block restarts: every on-duty unit starts at the earliest
+     * current start time.
+     */
+    bool setCrewsPerShift(int count);
+
+    int crewsPerShift() const {
+        return crews;
+    }
+
+    /**
+     * Returns the ID of the on-duty ambulance whose shift ends first, or an empty string.
+     */
+    std::string currentDutyId() const {
+        return isEmpty() ? std::string() : rotation.front().id;
+    }
+
+    /**
+     * Returns the number of ambulances in the rotation.
+     */
+    int size() const {
+        return static_cast<int>(rotation.size());
+    }
+
+    /**
+     * Projected shifts from the last handover up to at least until. Built on
+     * first use after a change and reused while it reaches far enough.
+     */
+    const DutyTimeline& dutyTimeline(std::time_t until) const;
+
+    /**
+     * Displays the current rotation order in a readable table.
+     * Shows the shift lengths and crews per shift for clarity.
+     */
+    void displaySchedule() const;
+
+    /**
+     * Writes the current schedule to a CSV file on disk.
+     * Each row's start and end give the unit's shift length, and the
+     * "In Duty" rows give the crews per shift, so nothing else is stored.
+     * Returns false if the file cannot be opened.
+     */
+    bool saveScheduleToCsv(const std::string& filename) const;
+
+    /**
+     * Same as saveScheduleToCsv, on the background writer when one is set.
+     * The schedule is at most MAX_AMBULANCES rows, so it is rendered here
+     * and only the file write is left to the writer. Failures print a warning.
+     */
+    void saveScheduleLater(const std::string& filename) const;
+
+    // Schedule file writes of saveScheduleLater go to pool; null writes right away
+    void setBackgroundWriter(WorkStealingPool* pool) {
+        writer = pool;
+    }
+
+    /**
+     * Loads a schedule from a CSV file, replacing the current queue contents.
+     * Rows marked "In Duty" keep their start times and set the crews per
+     * shift (one if none is marked). A row repeating an earlier row's ID is
+     * skipped; a row with no valid ID ("A" and 1 to 7 digits) gets a new one
+     * above every ID in the file. Returns false if the file cannot be opened.
+     */
+    bool loadScheduleFromCsv(const std::string& filename);
+
+    /**
+     * Starts keeping up to depth undo steps from the current state (0 turns
+     * the history off). Registrations, handovers, crew changes and loads
+     * each add a version.
+     */
+    void enableHistory(std::size_t depth);
+
+    // Steps back or forward one change; false when there is none
+    bool undo();
+    bool redo();
+
+    // Null while undo is off
+    const VersionHistory<RotationVersion>* versions() const {
+        return history.get();
+    }
+
+    /**
+     * Parses a datetime string formatted as "YYYY-MM-DD HH:MM" (local time).
+     */
+    static bool parseDateTime(const std::string& text, std::time_t& result);
+
+    /**
+     * Formats a time as "YYYY-MM-DD HH:MM" (local time), or "N/A".
+     */
+    static std::string formatDateTime(std::time_t value);
+
+    /**
+     * Thread-safe localtime: site shards build and print schedules on
+     * their own threads, so the shared std::localtime buffer will not do.
+     */
+    static bool toLocalTime(std::time_t value, std::tm& local);
+
+private:
+    RingBuffer<Ambulance, MAX_AMBULANCES> rotation;
+    std::time_t dutyStart[MAX_AMBULANCES]; // per crew slot, i.e. per on-duty position
+    int nextId;
+    int crews;
+    mutable DutyTimeline timeline;
+    mutable bool timelineStale;
+    std::unique_ptr<VersionHistory<RotationVersion>> history; // null while undo is off
+    WorkStealingPool* writer; // not owned
+
+    void writeSchedule(std::ostream& out) const;
+    RotationVersion currentVersion() const;
+    void restore(const RotationVersion& version);
+    void recordChange();
+
+    /**
+     * Resets the scheduler to an empty state with default timing and IDs.
+     */
+    void resetScheduleState();
+
+    std::time_t shiftEnd(std::size_t position) const {
+        return dutyStart[position] + rotation[position].shiftHours * SECONDS_PER_HOUR;
+    }
+
+    // Earliest start among the on-duty units (the current block)
+    std::time_t blockStart() const;
+
+    /**
+     * Keeps the on-duty positions ordered by shift end (stable, at most
+     * MAX_AMBULANCES entries), so position 0 is always the next to hand over.
+     */
+    void sortOnDuty();
+
+    /**
+     * Replays handovers from the current state, calling visit(position,
+     * start, end) for each shift in start order until it returns false.
+     * Positions refer to the current rotation.
+     */
+    template <typename Visit>
+    void forEachShift(Visit visit) const;
+
+    // First projected start of every position in the rotation
+    void projectStarts(std::time_t* starts) const;
+    DutyTimeline buildTimeline(std::time_t horizon) const;
+
+    /**
+     * Splits a CSV line into the expected number of columns (no quoted commas).
+     */
+    bool splitCsvLine(const std::string& line, std::string* columns, int expectedColumns) const;
+
+    /**
+     * Extracts the numeric portion from an ambulance ID like "A01".
+     */
+    int extractNumericId(const std::string& id) const;
+
+    /**
+     * Parses a substring of digits into an integer, returning -1 if invalid.
+     */
+    static int parseNumber(const std::string& text, std::size_t start, std::size_t length);
+
+    /**
+     * Helper to compute today's date at 00:00:00 local time.
+     */
+    std::time_t todayAtMidnight() const;
+    /**
+     * Formats the numeric ambulance counter into ID style "A01", "A02", etc.
+     */
+    std::string formatAmbulanceId(int number) const;
+    /**
+     * Checks if the queue currently holds no ambulances.
+     */
+    bool isEmpty() const {
+        return rotation.empty();
+    }
+};
+
+/**
+ * Runs the interactive ambulance dispatcher module.
+ */
+int runAmbulanceDispatcher();
+
+#endif // AMBULANCE_DISPATCHER_HPP
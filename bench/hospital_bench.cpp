@@ -0,0 +1,601 @@
+/**
+ * Microbenchmarks for the core data structures, their CSV persistence, the
+ * dispatch engine and the analytics export.
+ *
+ * Prints one JSON object per line, for example:
+ *   {"name":"supply_stack/push","size":1000,"ops":1000000,"ns_per_op":12.3,
+ *    "allocs_per_op":1,"bytes_per_op":80}
+ * so runs can be diffed or loaded into a spreadsheet to track regressions.
+ *
+ * Usage: hospital_bench [--max-size N] [--filter TEXT] [--min-time SECONDS]
+ *   --max-size  largest record count to try (sizes go 10, 100, ... up to N;
+ *               default 10000000)
+ *   --filter    only run benchmarks whose name contains TEXT
+ *   --min-time  keep repeating a size until this much time was measured
+ */
+
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+#include "DispatchEngine.hpp"
+#include "DischargeArchive.hpp"
+#include "Analytics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Allocation counting: every global operator new in this process is counted.
+
+namespace {
+std::atomic<unsigned long long> allocationCount{0};
+std::atomic<unsigned long long> allocationBytes{0};
+}
+
+void* operator new(std::size_t bytes) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct Options {
+    std::size_t maxSize = 10000000;
+    std::string filter;
+    double minTime = 0.2;
+};
+
+// Pool of short inputs so generating arguments is not part of the timing
+const std::size_t INPUT_POOL = 1024;
+
+struct Inputs {
+    std::vector<std::string> ids;
+    std::vector<std::string> names;
+    std::vector<std::string> batches;
+
+    Inputs() {
+        for (std::size_t i = 0; i < INPUT_POOL; ++i) {
+            ids.push_back(std::to_string(100000 + i));
+            names.push_back("PATIENT " + std::to_string(i));
+            batches.push_back("B" + std::to_string(i));
+        }
+    }
+};
+
+// Distinct patient ids ("100001", "100002", ...), since the queue turns away
+// an id that is already waiting; the digits are bumped in place, so there is
+// no formatting in the timed loop
+struct IdSequence {
+    std::string text = "100000";
+
+    const std::string& next() {
+        for (std::size_t i = text.size(); i-- > 0;) {
+            if (text[i] != '9') {
+                ++text[i];
+                return text;
+            }
+            text[i] = '0';
+        }
+        text.insert(text.begin(), '1');
+        return text;
+    }
+};
+
+std::filesystem::path scratchDir() {
+    static std::filesystem::path dir = std::filesystem::temp_directory_path() / "hospital_bench";
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+void report(const std::string& name, std::size_t size, std::size_t ops, double ns,
+            unsigned long long allocs, unsigned long long bytes) {
+    double perOp = ops ? 1.0 / static_cast<double>(ops) : 0.0;
+    std::printf("{\"name\":\"%s\",\"size\":%zu,\"ops\":%zu,\"ns_per_op\":%.3f,"
+                "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.3f}\n",
+                name.c_str(), size, ops, ns * perOp,
+                static_cast<double>(allocs) * perOp, static_cast<double>(bytes) * perOp);
+    std::fflush(stdout);
+}
+
+/**
+ * Repeats setup (untimed) + body (timed) until minTime has been measured.
+ * setup returns the state as a unique_ptr; body performs the operations and
+ * returns how many it did. Only allocations made inside body are counted.
+ */
+template <typename Setup, typename Body>
+void run(const Options& options, const std::string& name, std::size_t size, Setup setup, Body body) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+
+    double totalNs = 0.0;
+    std::size_t totalOps = 0;
+    unsigned long long allocs = 0;
+    unsigned long long bytes = 0;
+
+    do {
+        auto state = setup();
+        unsigned long long countBefore = allocationCount.load(std::memory_order_relaxed);
+        unsigned long long bytesBefore = allocationBytes.load(std::memory_order_relaxed);
+        auto started = std::chrono::steady_clock::now();
+
+        totalOps += body(*state);
+
+        auto finished = std::chrono::steady_clock::now();
+        allocs += allocationCount.load(std::memory_order_relaxed) - countBefore;
+        bytes += allocationBytes.load(std::memory_order_relaxed) - bytesBefore;
+        totalNs += std::chrono::duration<double, std::nano>(finished - started).count();
+    } while (totalNs < options.minTime * 1e9);
+
+    report(name, size, totalOps, totalNs, allocs, bytes);
+}
+
+std::unique_ptr<PatientQueue> filledQueue(const Inputs& in, const std::string& file, std::size_t n) {
+    std::filesystem::remove(file);
+    std::unique_ptr<PatientQueue> queue(new PatientQueue(file));
+    IdSequence ids;
+    for (std::size_t i = 0; i < n; ++i) {
+        queue->appendPatient(ids.next(), in.names[i % INPUT_POOL], "FEVER");
+    }
+    return queue;
+}
+
+std::unique_ptr<SupplyStack> filledStack(const Inputs& in, std::size_t n) {
+    std::unique_ptr<SupplyStack> stack(new SupplyStack());
+    for (std::size_t i = 0; i < n; ++i) {
+        stack->addSupplyStock("GAUZE", static_cast<int>(i % 100) + 1, in.batches[i % INPUT_POOL]);
+    }
+    return stack;
+}
+
+std::unique_ptr<EmergencyDepartmentSystem> filledTriage(const Inputs& in, std::size_t n) {
+    std::unique_ptr<EmergencyDepartmentSystem> triage(new EmergencyDepartmentSystem());
+    for (std::size_t i = 0; i < n; ++i) {
+        triage->enqueueCase(in.names[i % INPUT_POOL], "TRAUMA", static_cast<int>(i % 5) + 1);
+    }
+    return triage;
+}
+
+std::unique_ptr<AmbulanceScheduler> fullRotation() {
+    std::unique_ptr<AmbulanceScheduler> scheduler(new AmbulanceScheduler());
+    for (int i = 0; i < MAX_AMBULANCES; ++i) {
+        Ambulance ambulance{};
+        ambulance.driverName = "Driver " + std::to_string(i);
+        scheduler->registerAmbulance(ambulance);
+    }
+    return scheduler;
+}
+
+// Fleets beyond this are unrealistic and only slow the sweep down
+const std::size_t DISPATCH_MAX_UNITS = 100000;
+
+// Deterministic spread of points over the default service area (splitmix64)
+DispatchPoint scatter(std::uint64_t seed) {
+    std::uint64_t z = seed * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    const double scale = DEFAULT_SERVICE_AREA_KM / 4294967296.0;
+    return DispatchPoint{static_cast<double>(z >> 32) * scale, static_cast<double>(z & 0xFFFFFFFFULL) * scale};
+}
+
+std::unique_ptr<DispatchEngine> filledFleet(std::size_t units) {
+    std::unique_ptr<DispatchEngine> engine(new DispatchEngine());
+    for (std::size_t i = 0; i < units; ++i) {
+        Ambulance ambulance{};
+        DispatchPoint at = scatter(i);
+        ambulance.x = at.x;
+        ambulance.y = at.y;
+        engine->addUnit(ambulance);
+    }
+    return engine;
+}
+
+void dispatchBenchmarks(const Options& options, const Inputs& in, std::size_t n) {
+    if (n > DISPATCH_MAX_UNITS) {
+        return;
+    }
+    const std::size_t calls = 100000;
+
+    // Steady state: the unit takes the call, finishes it and stays there
+    run(options, "dispatch/assign_release", n,
+        [&] { return filledFleet(n); },
+        [&](DispatchEngine& engine) {
+            DispatchAssignment assignment{};
+            for (std::size_t i = 0; i < calls; ++i) {
+                DispatchPoint call = scatter(n + i);
+                engine.assign(call, assignment);
+                engine.moveUnit(assignment.unit, call.x, call.y);
+                engine.setAvailable(assignment.unit, true);
+            }
+            return calls;
+        });
+
+    // Drains a triage backlog as large as the fleet; free units thin out as it runs
+    struct Backlog {
+        std::unique_ptr<DispatchEngine> engine;
+        std::unique_ptr<EmergencyDepartmentSystem> triage;
+        std::vector<DispatchAssignment> assignments;
+    };
+    run(options, "dispatch/backlog", n,
+        [&] {
+            std::unique_ptr<Backlog> backlog(new Backlog{filledFleet(n), filledTriage(in, n), {}});
+            backlog->assignments.reserve(n);
+            return backlog;
+        },
+        [&](Backlog& backlog) {
+            CallLocator locate = [](const EmergencyCase& c) { return scatter(static_cast<std::uint64_t>(c.id) << 20); };
+            return backlog.engine->dispatchBacklog(*backlog.triage, locate, backlog.assignments);
+        });
+}
+
+// Archives are real files; beyond this the sweep mostly measures the disk
+const std::size_t ARCHIVE_MAX_RECORDS = 1000000;
+const std::size_t ARCHIVE_QUERY_WINDOW = 1000; // records per range query
+
+std::unique_ptr<DischargeArchive> filledArchive(const Inputs& in, std::size_t n) {
+    const std::filesystem::path dir = scratchDir() / "archive";
+    std::filesystem::remove_all(dir);
+    std::unique_ptr<DischargeArchive> archive(new DischargeArchive(dir.string()));
+    for (std::size_t i = 0; i < n; ++i) {
+        std::int64_t at = static_cast<std::int64_t>(i) * 60;
+        archive->append(DischargeRecord{at, at - 3600, in.ids[i % INPUT_POOL], (i % 4) ? "FEVER" : "FRACTURE"});
+    }
+    archive->flush();
+    return archive;
+}
+
+void archiveBenchmarks(const Options& options, const Inputs& in, std::size_t n) {
+    if (n > ARCHIVE_MAX_RECORDS) {
+        return;
+    }
+
+    run(options, "archive/append", n,
+        [&] { return filledArchive(in, 0); },
+        [&](DischargeArchive& archive) {
+            for (std::size_t i = 0; i < n; ++i) {
+                std::int64_t at = static_cast<std::int64_t>(i) * 60;
+                archive.append(DischargeRecord{at, at - 3600, in.ids[i % INPUT_POOL], "FEVER"});
+            }
+            archive.flush();
+            return n;
+        });
+
+    // One window of recent discharges; the cost should not grow with n
+    const std::size_t window = std::min(n, ARCHIVE_QUERY_WINDOW);
+    run(options, "archive/range_query", n,
+        [&] { return filledArchive(in, n); },
+        [&](DischargeArchive& archive) {
+            std::int64_t from = static_cast<std::int64_t>(n - window) * 60;
+            std::size_t rows = 0;
+            for (int repeat = 0; repeat < 10; ++repeat) {
+                rows += archive.query(from, from + static_cast<std::int64_t>(window) * 60, "FEVER",
+                                      [](const DischargeRecord&) {});
+            }
+            return rows;
+        });
+}
+
+const char* const ANALYTICS_CONDITIONS[] = {"FEVER", "FRACTURE", "CARDIAC", "BURN", "STROKE"};
+const char* const ANALYTICS_SUPPLIES[] = {"GAUZE", "SALINE", "SYRINGE", "GLOVES"};
+
+// n rows in total: half patients, a quarter each supplies and pending cases
+std::unique_ptr<StoreSnapshot> filledSnapshot(const Inputs& in, std::size_t n) {
+    std::unique_ptr<StoreSnapshot> snapshot(new StoreSnapshot());
+    StringArena& strings = snapshot->strings;
+    snapshot->patients.resize(n / 2);
+    for (std::size_t i = 0; i < snapshot->patients.size(); ++i) {
+        PatientRecord& record = snapshot->patients[i];
+        record.admittedAt = static_cast<std::int64_t>(i);
+        record.id.assign(in.ids[i % INPUT_POOL], strings);
+        record.name.assign(in.names[i % INPUT_POOL], strings);
+        record.conditionType.assign(ANALYTICS_CONDITIONS[i % 5], strings);
+    }
+    snapshot->supplies.resize(n / 4);
+    for (std::size_t i = 0; i < snapshot->supplies.size(); ++i) {
+        SupplyRecord& record = snapshot->supplies[i];
+        record.type.assign(ANALYTICS_SUPPLIES[i % 4], strings);
+        record.batch.assign(in.batches[i % INPUT_POOL], strings);
+        record.quantity = static_cast<std::int32_t>(i % 100 + 1);
+    }
+    snapshot->cases.resize(n - n / 2 - n / 4);
+    for (std::size_t i = 0; i < snapshot->cases.size(); ++i) {
+        CaseRecord& record = snapshot->cases[i];
+        record.loggedAtNs = static_cast<std::int64_t>(i);
+        record.id = static_cast<std::int32_t>(i + 1);
+        record.priority = static_cast<std::int32_t>(i % MAX_PRIORITY + 1);
+        record.patientName.assign(in.names[i % INPUT_POOL], strings);
+        record.emergencyType.assign(ANALYTICS_CONDITIONS[i % 5], strings);
+    }
+    return snapshot;
+}
+
+void analyticsBenchmarks(const Options& options, const Inputs& in, std::size_t n) {
+    // Row copy to columns, the work the snapshotter does before writing
+    run(options, "analytics/encode", n,
+        [&] { return filledSnapshot(in, n); },
+        [&](StoreSnapshot& snapshot) {
+            ColumnarSnapshot columns = encodeSnapshot(snapshot);
+            return columns.patients.id.size() + columns.supplies.quantity.size() + columns.triage.id.size();
+        });
+
+    // Every aggregate of the REPORT command over the encoded columns
+    run(options, "analytics/aggregate", n,
+        [&] {
+            std::unique_ptr<ColumnarSnapshot> columns(new ColumnarSnapshot(encodeSnapshot(*filledSnapshot(in, n))));
+            return columns;
+        },
+        [&](ColumnarSnapshot& columns) {
+            AnalyticsReport report = summarize(columns);
+            return columns.patients.conditionType.size() + columns.supplies.type.size() +
+                   columns.triage.priority.size() + (report.casesByPriority[0] ? 1 : 0);
+        });
+}
+
+void containerBenchmarks(const Options& options, const Inputs& in, std::size_t n) {
+    const std::string scratchQueue = (scratchDir() / "queue.csv").string();
+
+    run(options, "patient_queue/admit", n,
+        [&] { return filledQueue(in, scratchQueue, 0); },
+        [&](PatientQueue& q) {
+            IdSequence ids;
+            for (std::size_t i = 0; i < n; ++i) {
+                q.appendPatient(ids.next(), in.names[i % INPUT_POOL], "FEVER");
+            }
+            return n;
+        });
+
+    run(options, "patient_queue/discharge", n,
+        [&] { return filledQueue(in, scratchQueue, n); },
+        [&](PatientQueue& q) {
+            std::string id, name, condition;
+            std::size_t ops = 0;
+            while (q.removeFront(id, name, condition)) {
+                ++ops;
+            }
+            return ops;
+        });
+
+    run(options, "supply_stack/push", n,
+        [&] { return filledStack(in, 0); },
+        [&](SupplyStack& s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.addSupplyStock("GAUZE", static_cast<int>(i % 100) + 1, in.batches[i % INPUT_POOL]);
+            }
+            return n;
+        });
+
+    run(options, "supply_stack/pop", n,
+        [&] { return filledStack(in, n); },
+        [&](SupplyStack& s) {
+            std::size_t ops = 0;
+            while (!s.isEmpty()) {
+                s.useLastAddedSupply();
+                ++ops;
+            }
+            return ops;
+        });
+
+    run(options, "emergency/log", n,
+        [&] { return filledTriage(in, 0); },
+        [&](EmergencyDepartmentSystem& t) {
+            for (std::size_t i = 0; i < n; ++i) {
+                t.enqueueCase(in.names[i % INPUT_POOL], "TRAUMA", static_cast<int>(i % 5) + 1);
+            }
+            return n;
+        });
+
+    run(options, "emergency/process", n,
+        [&] { return filledTriage(in, n); },
+        [&](EmergencyDepartmentSystem& t) {
+            EmergencyCase c;
+            std::size_t ops = 0;
+            while (t.takeMostCriticalCase(c)) {
+                ++ops;
+            }
+            return ops;
+        });
+
+    run(options, "ambulance/rotate_shift", n,
+        [&] { return fullRotation(); },
+        [&](AmbulanceScheduler& s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.rotateShift();
+            }
+            return n;
+        });
+}
+
+void persistenceBenchmarks(const Options& options, const Inputs& in, std::size_t n) {
+    const std::string patientsFile = (scratchDir() / "patients.csv").string();
+    const std::string suppliesFile = (scratchDir() / "supplies.csv").string();
+
+    run(options, "csv/patients_save", n,
+        [&] { return filledQueue(in, patientsFile, n); },
+        [&](PatientQueue& q) {
+            q.saveToFile(patientsFile);
+            return n;
+        });
+
+    run(options, "csv/patients_load", n,
+        [&] {
+            filledQueue(in, patientsFile, n)->saveToFile(patientsFile);
+            return std::unique_ptr<PatientQueue>(new PatientQueue(patientsFile + ".unused"));
+        },
+        [&](PatientQueue& q) {
+            q.loadFromFile(patientsFile);
+            return static_cast<std::size_t>(q.getSize());
+        });
+
+    run(options, "csv/supplies_save", n,
+        [&] { return filledStack(in, n); },
+        [&](SupplyStack& s) {
+            s.saveToCsv(suppliesFile);
+            return n;
+        });
+
+    run(options, "csv/supplies_load", n,
+        [&] {
+            filledStack(in, n)->saveToCsv(suppliesFile);
+            return std::unique_ptr<SupplyStack>(new SupplyStack());
+        },
+        [&](SupplyStack& s) {
+            s.loadFromCsv(suppliesFile);
+            return n;
+        });
+
+    const std::string patientsBinary = (scratchDir() / "patients.bin").string();
+    const std::string suppliesBinary = (scratchDir() / "supplies.bin").string();
+
+    run(options, "binary/patients_save", n,
+        [&] { return filledQueue(in, patientsFile, n); },
+        [&](PatientQueue& q) {
+            q.saveToBinary(patientsBinary);
+            return n;
+        });
+
+    run(options, "binary/patients_load", n,
+        [&] {
+            filledQueue(in, patientsFile, n)->saveToBinary(patientsBinary);
+            return std::unique_ptr<PatientQueue>(new PatientQueue(patientsFile + ".unused"));
+        },
+        [&](PatientQueue& q) {
+            q.loadFromBinary(patientsBinary);
+            return static_cast<std::size_t>(q.getSize());
+        });
+
+    run(options, "binary/supplies_save", n,
+        [&] { return filledStack(in, n); },
+        [&](SupplyStack& s) {
+            s.saveToBinary(suppliesBinary);
+            return n;
+        });
+
+    run(options, "binary/supplies_load", n,
+        [&] {
+            filledStack(in, n)->saveToBinary(suppliesBinary);
+            return std::unique_ptr<SupplyStack>(new SupplyStack());
+        },
+        [&](SupplyStack& s) {
+            s.loadFromBinary(suppliesBinary);
+            return n;
+        });
+}
+
+// The rotation holds at most MAX_AMBULANCES rows, so the schedule file has one size
+void scheduleBenchmarks(const Options& options) {
+    const std::string scheduleFile = (scratchDir() / "schedule.csv").string();
+    const std::size_t rows = static_cast<std::size_t>(MAX_AMBULANCES);
+
+    run(options, "csv/schedule_save", rows,
+        [&] { return fullRotation(); },
+        [&](AmbulanceScheduler& s) {
+            s.saveScheduleToCsv(scheduleFile);
+            return rows;
+        });
+
+    run(options, "csv/schedule_load", rows,
+        [&] {
+            fullRotation()->saveScheduleToCsv(scheduleFile);
+            return std::unique_ptr<AmbulanceScheduler>(new AmbulanceScheduler());
+        },
+        [&](AmbulanceScheduler& s) {
+            s.loadScheduleFromCsv(scheduleFile);
+            return static_cast<std::size_t>(s.size());
+        });
+
+    // Month-long timeline, three crews with mixed shift lengths; the build is untimed
+    const std::size_t queries = 100000;
+    run(options, "schedule/on_duty_query", queries,
+        [&] {
+            std::unique_ptr<AmbulanceScheduler> scheduler(new AmbulanceScheduler());
+            for (int i = 0; i < MAX_AMBULANCES; ++i) {
+                Ambulance ambulance{};
+                ambulance.driverName = "Driver " + std::to_string(i);
+                ambulance.shiftHours = 6 + 2 * (i % 4);
+                scheduler->registerAmbulance(ambulance);
+            }
+            scheduler->setCrewsPerShift(3);
+            scheduler->dutyTimeline(0);
+            return scheduler;
+        },
+        [&](AmbulanceScheduler& s) {
+            const DutyTimeline& timeline = s.dutyTimeline(0);
+            const std::time_t span = timeline.horizon() - timeline.origin();
+            std::vector<DutyInterval> onDuty;
+            std::size_t found = 0;
+            for (std::size_t i = 0; i < queries; ++i) {
+                onDuty.clear();
+                timeline.onDutyAt(timeline.origin() + static_cast<std::time_t>((i * 7919) % static_cast<std::size_t>(span)), onDuty);
+                found += onDuty.size();
+            }
+            return found > 0 ? queries : 0;
+        });
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (arg == "--max-size") {
+            options.maxSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--filter") {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time") {
+            options.minTime = std::strtod(argv[++i], nullptr);
+        } else {
+            return false;
+        }
+    }
+    return options.maxSize >= 10;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: %s [--max-size N>=10] [--filter TEXT] [--min-time SECONDS]\n", argv[0]);
+        return 1;
+    }
+
+    Inputs inputs;
+    for (std::size_t n = 10; n <= options.maxSize; n *= 10) {
+        containerBenchmarks(options, inputs, n);
+        persistenceBenchmarks(options, inputs, n);
+        dispatchBenchmarks(options, inputs, n);
+        archiveBenchmarks(options, inputs, n);
+        analyticsBenchmarks(options, inputs, n);
+        if (n > options.maxSize / 10) {
+            break;
+        }
+    }
+    scheduleBenchmarks(options);
+
+    std::error_code ignored;
+    std::filesystem::remove_all(scratchDir(), ignored);
+    return 0;
+}
@@ -0,0 +1,888 @@
+/**
+ * Differential fuzz harness for the store fast paths.
+ *
+ * Every input is decoded into one scenario: either a random operation
+ * sequence run against a store and against a plain reference model
+ * (std::deque for the patient queue, std::vector for the supply stack, a
+ * linear scan for triage), or random bytes loaded as a CSV file and checked
+ * against a straightforward re-reading of the format. Any difference the
+ * caller could observe prints the scenario and aborts, so sanitizers and
+ * libFuzzer report it like a crash. Supply files the stack saved are also
+ * run back through the bulk importer, which must rebuild the same stack.
+ *
+ * The models encode the behavior the stores promise: patients leave in
+ * admission order, supplies are used last-added first, triage takes the
+ * highest aged priority with ties going to the lower case id, and CSV rows
+ * that do not parse are skipped rather than failing the load.
+ *
+ * Usage: hospital_fuzz [--runs N] [--seed S] [--max-len BYTES] [FILE...]
+ *   --runs     random inputs to try (default 10000)
+ *   --seed     seed of the input generator (default: random)
+ *   --max-len  longest generated input in bytes (default 4096)
+ *   FILE       run saved inputs instead, e.g. a libFuzzer crash file
+ *
+ * Built only with -DHOSPITAL_BUILD_FUZZ=ON; see CMakeLists.txt for the
+ * sanitizer and libFuzzer variants.
+ */
+
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "DuplicateFilter.hpp"
+#include "WorkStealingPool.hpp"
+#include "BulkImport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+enum class Scenario : std::uint8_t {
+    PatientOps,
+    SupplyOps,
+    TriageOps,
+    SupplyCsv,
+    PatientCsv,
+    DuplicateIds,
+    BackgroundWrites,
+    SupplyImport,
+    Count
+};
+
+const char* const SCENARIO_NAMES[] = {"patient operations", "supply operations", "triage operations",
+                                      "supply csv",         "patient csv",       "duplicate ids",
+                                      "background writes",  "supply import"};
+
+const char* currentScenario = "";
+
+[[noreturn]] void fail(const std::string& what) {
+    std::fprintf(stderr, "hospital_fuzz: %s: %s\n", currentScenario, what.c_str());
+    std::abort();
+}
+
+void expect(bool ok, const char* what) {
+    if (!ok) {
+        fail(what);
+    }
+}
+
+// One directory per process, so parallel fuzzing jobs do not share files.
+// It is removed on a normal exit and kept after a failure.
+struct ScratchDir {
+    std::filesystem::path path;
+
+    ScratchDir()
+        : path(std::filesystem::temp_directory_path() / ("hospital_fuzz-" + std::to_string(std::random_device()()))) {
+        std::filesystem::create_directories(path);
+    }
+
+    ~ScratchDir() {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+};
+
+std::string scratchFile(const char* name) {
+    static ScratchDir dir;
+    return (dir.path / name).string();
+}
+
+void writeBytes(const std::string& filename, const std::string& bytes) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+std::string readBytes(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Consumes the input front to back; reads past the end return zeros
+class FuzzInput {
+public:
+    FuzzInput(const std::uint8_t* data, std::size_t size) : data(data), size(size), offset(0) {}
+
+    bool exhausted() const { return offset >= size; }
+
+    std::uint8_t byte() { return offset < size ? data[offset++] : 0; }
+
+    std::uint32_t word() {
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value = (value << 8) | byte();
+        }
+        return value;
+    }
+
+    // Field text without commas, line breaks or edge spaces; over 23
+    // characters it spills out of the inline record strings
+    std::string text(std::size_t minLength, std::size_t maxLength) {
+        static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_";
+        std::size_t length = minLength + byte() % (maxLength - minLength + 1);
+        std::string result;
+        for (std::size_t i = 0; i < length; ++i) {
+            result += ALPHABET[byte() % (sizeof(ALPHABET) - 1)];
+        }
+        return result;
+    }
+
+    std::string rest() {
+        std::string result(reinterpret_cast<const char*>(data) + offset, size - std::min(offset, size));
+        offset = size;
+        return result;
+    }
+
+private:
+    const std::uint8_t* data;
+    std::size_t size;
+    std::size_t offset;
+};
+
+// Reference undo history: whole copies, newest depth + 1 kept (see VersionHistory.hpp)
+template <typename State>
+class ModelHistory {
+public:
+    ModelHistory(const State& base, std::size_t depth) : position(0), depth(depth) { versions.push_back(base); }
+
+    void record(const State& next) {
+        if (depth == 0) {
+            return;
+        }
+        versions.resize(position + 1);
+        versions.push_back(next);
+        if (versions.size() > depth + 1) {
+            versions.pop_front();
+        }
+        position = versions.size() - 1;
+    }
+
+    bool undo(State& state) {
+        if (depth == 0 || position == 0) {
+            return false;
+        }
+        state = versions[--position];
+        return true;
+    }
+
+    bool redo(State& state) {
+        if (depth == 0 || position + 1 == versions.size()) {
+            return false;
+        }
+        state = versions[++position];
+        return true;
+    }
+
+private:
+    std::deque<State> versions;
+    std::size_t position;
+    std::size_t depth;
+};
+
+// Splits like the loaders' getline calls: the text between commas, "" when missing
+std::vector<std::string> csvFields(const std::string& line, std::size_t count) {
+    std::vector<std::string> fields(count);
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < count && start < line.size(); ++i) {
+        std::size_t comma = line.find(',', start);
+        if (comma == std::string::npos) {
+            fields[i] = line.substr(start);
+            break;
+        }
+        fields[i] = line.substr(start, comma - start);
+        start = comma + 1;
+    }
+    return fields;
+}
+
+// Lines as getline returns them: a final line without '\n' counts, an empty one does not
+std::vector<std::string> csvLines(const std::string& bytes) {
+    std::vector<std::string> lines;
+    std::size_t start = 0;
+    while (start < bytes.size()) {
+        std::size_t end = bytes.find('\n', start);
+        if (end == std::string::npos) {
+            end = bytes.size();
+        }
+        lines.push_back(bytes.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+// ---------------------------------------------------------------------------
+// Patient queue: admission order, undo/redo, save and reload
+
+void expectPatients(PatientQueue& queue, const std::deque<PatientEntry>& model) {
+    std::vector<PatientRecord> records;
+    StringArena strings;
+    queue.snapshotRecords(records, strings);
+    expect(records.size() == model.size(), "patient count differs from the model");
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        expect(records[i].id.str() == model[i].id && records[i].name.str() == model[i].name &&
+                   records[i].conditionType.str() == model[i].conditionType &&
+                   records[i].admittedAt == model[i].admittedAt,
+               "patient differs from the model");
+    }
+}
+
+void patientOps(FuzzInput& in) {
+    const std::string file = scratchFile("patients.csv");
+    std::filesystem::remove(file);
+    PatientQueue queue(file);
+    std::size_t depth = in.byte() % 8;
+    queue.enableHistory(depth);
+
+    std::deque<PatientEntry> model;
+    ModelHistory<std::deque<PatientEntry>> history(model, depth);
+    int nextId = 1;
+
+    while (!in.exhausted()) {
+        switch (in.byte() % 6) {
+            case 0:
+            case 1: {
+                // Some ids come from small pools (numeric and string ones), so an
+                // id still waiting comes back and must be turned away
+                std::uint8_t kind = in.byte();
+                std::string id = (kind % 4 == 0)   ? "D" + std::to_string(kind % 32)
+                                 : (kind % 4 == 1) ? "S-" + std::to_string(kind % 16)
+                                                   : "P" + std::to_string(nextId++) + in.text(0, 20);
+                PatientEntry entry{id, in.text(1, 30), in.text(1, 20), static_cast<int64_t>(in.byte())};
+                bool waiting = std::any_of(model.begin(), model.end(),
+                                           [&id](const PatientEntry& other) { return other.id == id; });
+                bool admitted =
+                    queue.appendPatient(entry.id, entry.name, entry.conditionType, static_cast<time_t>(entry.admittedAt));
+                expect(admitted == !waiting, "admission of an id already waiting was not rejected, or a new id was");
+                if (admitted) {
+                    model.push_back(entry);
+                    history.record(model);
+                }
+                break;
+            }
+            case 2: {
+                std::string id, name, condition;
+                bool removed = queue.removeFront(id, name, condition);
+                expect(removed == !model.empty(), "removeFront disagrees on an empty queue");
+                if (removed) {
+                    expect(id == model.front().id && name == model.front().name &&
+                               condition == model.front().conditionType,
+                           "discharged patient is not the earliest admitted");
+                    model.pop_front();
+                    history.record(model);
+                }
+                break;
+            }
+            case 3:
+                expect(queue.undo() == history.undo(model), "patient undo availability differs");
+                break;
+            case 4:
+                expect(queue.redo() == history.redo(model), "patient redo availability differs");
+                break;
+            case 5:
+                expect(queue.persist(), "patient save failed"); // writes the empty-queue marker too
+                expect(queue.loadFromFile(file), "patient reload failed");
+                history.record(model); // a load is a version of its own
+                expectPatients(queue, model);
+                break;
+        }
+        expect(static_cast<std::size_t>(queue.getSize()) == model.size(), "patient count differs from the model");
+    }
+    expectPatients(queue, model);
+}
+
+// ---------------------------------------------------------------------------
+// Supply stack: last added first, undo/redo, delta saves against full rewrites
+
+void expectSupplies(const SupplyStack& stack, const std::vector<Supply>& model) {
+    std::vector<SupplyRecord> records;
+    StringArena strings;
+    stack.snapshotRecords(records, strings);
+    expect(records.size() == model.size(), "supply count differs from the model");
+    long long total = 0;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        expect(records[i].type.str() == model[i].type && records[i].quantity == model[i].quantity &&
+                   records[i].batch.str() == model[i].batch,
+               "supply differs from the model");
+        total += model[i].quantity;
+    }
+    expect(stack.totalQuantity() == total, "supply total differs from the model");
+}
+
+void supplyOps(FuzzInput& in) {
+    const std::string deltaFile = scratchFile("supplies.csv");
+    const std::string fullFile = scratchFile("supplies-full.csv");
+    std::filesystem::remove(deltaFile);
+    SupplyStack stack;
+    std::size_t depth = in.byte() % 8;
+    stack.enableHistory(depth);
+
+    std::vector<Supply> model;
+    ModelHistory<std::vector<Supply>> history(model, depth);
+
+    while (!in.exhausted()) {
+        switch (in.byte() % 7) {
+            case 0:
+            case 1: {
+                Supply item{in.text(1, 30), static_cast<int>(in.word() % 1000000) + 1, in.text(0, 20)};
+                if (in.byte() & 1) {
+                    stack.push(item);
+                } else {
+                    stack.addSupplyStock(item.type, item.quantity, item.batch);
+                }
+                model.push_back(item);
+                history.record(model);
+                break;
+            }
+            case 2: {
+                Supply used = stack.pop();
+                if (model.empty()) {
+                    expect(used.type.empty() && used.quantity == 0 && used.batch.empty(),
+                           "pop of an empty stack returned a supply");
+                } else {
+                    expect(used.type == model.back().type && used.quantity == model.back().quantity &&
+                               used.batch == model.back().batch,
+                           "used supply is not the last added");
+                    model.pop_back();
+                    history.record(model);
+                }
+                break;
+            }
+            case 3: {
+                Supply top = stack.peek();
+                expect(model.empty() ? top.type.empty() : top.type == model.back().type, "peek differs from the model");
+                break;
+            }
+            case 4:
+                expect(stack.undo() == history.undo(model), "supply undo availability differs");
+                break;
+            case 5:
+                expect(stack.redo() == history.redo(model), "supply redo availability differs");
+                break;
+            case 6: {
+                // The incremental save must leave exactly what a fresh full save writes
+                expect(stack.saveToCsv(deltaFile), "supply save failed");
+                SupplyStack fresh;
+                for (const Supply& item : model) {
+                    fresh.push(item);
+                }
+                expect(fresh.saveToCsv(fullFile), "supply full save failed");
+                expect(readBytes(deltaFile) == readBytes(fullFile), "incremental supply file differs from a full save");
+                if (in.byte() & 1) {
+                    expect(stack.loadFromCsv(deltaFile), "supply reload failed");
+                    history.record(model);
+                }
+                break;
+            }
+        }
+        expect(stack.isEmpty() == model.empty(), "supply emptiness differs from the model");
+    }
+    expectSupplies(stack, model);
+}
+
+// ---------------------------------------------------------------------------
+// Triage: aged priority, then the lower id, on a simulated clock
+
+std::int64_t fuzzNowNs = 0;
+
+std::int64_t fuzzClock() {
+    return fuzzNowNs;
+}
+
+struct ModelCase {
+    int id;
+    std::string patientName;
+    std::string emergencyType;
+    int priority;
+    std::int64_t loggedAtNs;
+    std::int64_t stepNs;
+};
+
+void triageOps(FuzzInput& in) {
+    static const char* const TYPES[] = {"TRAUMA", "BURN", "CARDIAC", "FLU"};
+    const std::int64_t STEP_UNIT_NS = 1000;
+
+    EmergencyDepartmentSystem triage;
+    fuzzNowNs = 0;
+    triage.setClock(fuzzClock);
+
+    // Policies are set before any case is logged; 0 disables aging
+    std::int64_t defaultStep = (in.byte() % 4) * STEP_UNIT_NS;
+    triage.setDefaultAgingStep(defaultStep);
+    std::int64_t steps[4];
+    for (int t = 0; t < 4; ++t) {
+        std::uint8_t choice = in.byte();
+        steps[t] = defaultStep;
+        if (choice % 3 != 0) {
+            steps[t] = (choice % 5) * STEP_UNIT_NS;
+            triage.setAgingStep(TYPES[t], steps[t]);
+        }
+    }
+
+    std::vector<ModelCase> model;
+    int nextId = 1;
+    while (!in.exhausted()) {
+        switch (in.byte() % 4) {
+            case 0:
+            case 1: {
+                int t = in.byte() % 4;
+                std::string type = TYPES[t];
+                std::uint8_t spelling = in.byte();
+                if (spelling & 1) {
+                    std::transform(type.begin(), type.end(), type.begin(), [](char c) { return static_cast<char>(c + 32); });
+                }
+                if (spelling & 2) {
+                    type = " " + type + "\t";
+                }
+                ModelCase c{nextId++, in.text(1, 40), type, in.byte() % (MAX_PRIORITY + 2), fuzzNowNs, steps[t]};
+                expect(triage.enqueueCase(c.patientName, c.emergencyType, c.priority) == c.id, "case ids out of sequence");
+                model.push_back(c);
+                break;
+            }
+            case 2:
+                fuzzNowNs += static_cast<std::int64_t>(in.byte()) * 100;
+                break;
+            case 3: {
+                EmergencyCase taken;
+                bool any = triage.takeMostCriticalCase(taken);
+                expect(any == !model.empty(), "takeMostCriticalCase disagrees on an empty queue");
+                if (!any) {
+                    break;
+                }
+                std::size_t best = 0;
+                int bestAged = 0;
+                for (std::size_t i = 0; i < model.size(); ++i) {
+                    const ModelCase& c = model[i];
+                    int level = std::min(std::max(c.priority, MIN_PRIORITY), MAX_PRIORITY);
+                    int aged = level;
+                    if (c.stepNs > 0 && fuzzNowNs > c.loggedAtNs) {
+                        aged = static_cast<int>(std::min<std::int64_t>(level + (fuzzNowNs - c.loggedAtNs) / c.stepNs, MAX_PRIORITY));
+                    }
+                    if (i == 0 || aged > bestAged || (aged == bestAged && c.id < model[best].id)) {
+                        best = i;
+                        bestAged = aged;
+                    }
+                }
+                const ModelCase& expected = model[best];
+                expect(taken.id == expected.id, "wrong case taken (aged priority, then lower id)");
+                expect(taken.patientName == expected.patientName && taken.emergencyType == expected.emergencyType &&
+                           taken.priority == expected.priority && taken.loggedAtNs == expected.loggedAtNs,
+                       "taken case fields differ from the model");
+                expect(taken.agedPriority == bestAged && taken.processedAtNs == fuzzNowNs,
+                       "aged priority or processing time differs from the model");
+                model.erase(model.begin() + static_cast<std::ptrdiff_t>(best));
+                break;
+            }
+        }
+        expect(triage.pendingCount() == model.size(), "pending count differs from the model");
+    }
+
+    std::vector<CaseRecord> pending;
+    StringArena strings;
+    triage.snapshotPending(pending, strings);
+    expect(pending.size() == model.size(), "pending snapshot size differs from the model");
+    std::unordered_set<int> ids;
+    for (const ModelCase& c : model) {
+        ids.insert(c.id);
+    }
+    for (const CaseRecord& record : pending) {
+        expect(ids.erase(record.id) == 1, "pending snapshot holds a case the model does not");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CSV loaders on arbitrary bytes
+
+void supplyCsv(FuzzInput& in) {
+    const std::string file = scratchFile("supplies-input.csv");
+    std::string bytes = in.rest();
+    writeBytes(file, bytes);
+
+    // Reference reading: skip unparsable rows; only the current header lists the bottom first
+    std::vector<std::string> lines = csvLines(bytes);
+    bool bottomFirst = !lines.empty() && lines[0].rfind("Depth,Type,Quantity,Batch", 0) == 0;
+    std::vector<Supply> model;
+    for (std::size_t i = 1; i < lines.size(); ++i) {
+        std::vector<std::string> fields = csvFields(lines[i], 4);
+        if (fields[1].empty()) {
+            continue;
+        }
+        try {
+            model.push_back(Supply{fields[1], std::stoi(fields[2]), fields[3]});
+        } catch (...) {
+        }
+    }
+    if (!bottomFirst) {
+        std::reverse(model.begin(), model.end());
+    }
+
+    SupplyStack stack;
+    expect(stack.loadFromCsv(file), "supply load failed");
+    expectSupplies(stack, model);
+
+    // A save after the load may append to the file as read; reading it back must agree
+    Supply added{"FUZZ", 1, "B"};
+    stack.push(added);
+    model.push_back(added);
+    if (in.byte() & 1) {
+        stack.pop();
+        model.pop_back();
+    }
+    expect(stack.saveToCsv(file), "supply save failed");
+    SupplyStack reloaded;
+    expect(reloaded.loadFromCsv(file), "supply reload failed");
+    expectSupplies(reloaded, model);
+}
+
+void patientCsv(FuzzInput& in) {
+    const std::string file = scratchFile("patients-input.csv");
+    std::string bytes = in.rest();
+    writeBytes(file, bytes);
+
+    // Reference reading: stop at the empty-queue marker, skip incomplete rows
+    // and keep the first row of a repeated id
+    std::vector<std::string> lines = csvLines(bytes);
+    std::deque<PatientEntry> model;
+    std::unordered_set<std::string> seen;
+    for (std::size_t i = 1; i < lines.size(); ++i) {
+        if (lines[i].find("No patients in queue") != std::string::npos) {
+            break;
+        }
+        std::vector<std::string> fields = csvFields(lines[i], 5);
+        std::string id = PatientQueue::trim(fields[1]);
+        std::string name = PatientQueue::trim(fields[2]);
+        std::string condition = PatientQueue::trim(fields[3]);
+        if (id.empty() || name.empty() || condition.empty() || !seen.insert(id).second) {
+            continue;
+        }
+        long long admittedAt = std::strtoll(fields[4].c_str(), nullptr, 10);
+        model.push_back(PatientEntry{id, name, condition, admittedAt > 0 ? admittedAt : 0});
+    }
+
+    PatientQueue queue(file);
+    expectPatients(queue, model);
+}
+
+// ---------------------------------------------------------------------------
+// DuplicateIdFilter against a hash set; a tiny expected count forces the
+// Bloom filter into false positives that the second pass has to settle
+
+void duplicateIds(FuzzInput& in) {
+    DuplicateIdFilter filter(in.byte() % 64);
+    std::vector<std::string> ids;
+    while (!in.exhausted()) {
+        std::uint8_t form = in.byte();
+        std::string id;
+        switch (form % 4) {
+            case 0: // letter prefix and digits, with leading zeros and mixed widths
+                id = std::string(1, static_cast<char>('A' + form / 4 % 3)) + std::string(in.byte() % 3, '0') +
+                     std::to_string(in.byte() % 50);
+                break;
+            case 1: // bare digits, some too long for the bitmaps
+                id = std::to_string(in.word() % 100) + std::string(in.byte() % 10, '7');
+                break;
+            case 2:
+                id = "ID-" + in.text(0, 3);
+                break;
+            default:
+                id = in.text(1, 30);
+                break;
+        }
+        ids.push_back(id);
+    }
+
+    std::vector<std::string> kept;
+    std::unordered_set<std::string> seen;
+    for (const std::string& id : ids) {
+        bool first = seen.insert(id).second;
+        bool sighting = filter.firstSighting(id);
+        expect(first || !sighting || filter.needsVerify(), "repeated id passed without a verify pass");
+        expect(sighting || !first, "first occurrence of an id was dropped");
+        if (sighting) {
+            kept.push_back(id);
+        }
+    }
+    if (filter.needsVerify()) {
+        std::vector<std::string> verified;
+        for (const std::string& id : kept) {
+            if (filter.verify(id)) {
+                verified.push_back(id);
+            }
+        }
+        kept.swap(verified);
+    }
+
+    seen.clear();
+    std::vector<std::string> expected;
+    for (const std::string& id : ids) {
+        if (seen.insert(id).second) {
+            expected.push_back(id);
+        }
+    }
+    expect(kept == expected, "filtered ids differ from first occurrences");
+}
+
+// ---------------------------------------------------------------------------
+// Queue, discharge archive and supply files written through the
+// work-stealing pool (meant for TSan builds). Supply deltas stay inline
+// between the queued full rewrites; archive queries run on the pool while
+// discharges keep being appended, and must count those before them.
+
+void backgroundWrites(FuzzInput& in) {
+    static WorkStealingPool pool(2);
+    const std::string file = scratchFile("patients-background.csv");
+    const std::string archiveDir = scratchFile("discharges-background");
+    const std::string supplyFile = scratchFile("supplies-background.csv");
+    const std::string fullFile = scratchFile("supplies-background-full.csv");
+    std::filesystem::remove(file);
+    std::filesystem::remove_all(archiveDir);
+    std::filesystem::remove(supplyFile);
+
+    std::deque<PatientEntry> model;
+    std::vector<Supply> supplyModel;
+    std::size_t discharged = 0;
+    std::shared_ptr<std::atomic<int>> wrongCounts = std::make_shared<std::atomic<int>>(0);
+    {
+        DischargeArchive archive(archiveDir);
+        PatientQueue queue(file);
+        queue.setDischargeArchive(&archive);
+        queue.setBackgroundWriter(&pool);
+        SupplyStack stack;
+        stack.setBackgroundWriter(&pool);
+        int nextId = 1;
+        while (!in.exhausted()) {
+            std::uint8_t op = in.byte();
+            if (op % 3 != 0) {
+                PatientEntry entry{"B" + std::to_string(nextId++), in.text(1, 30), in.text(1, 10),
+                                   static_cast<int64_t>(in.byte()) + 1};
+                queue.appendPatient(entry.id, entry.name, entry.conditionType, static_cast<time_t>(entry.admittedAt));
+                model.push_back(entry);
+                Supply item{entry.name, static_cast<int>(op), entry.conditionType};
+                stack.push(item);
+                supplyModel.push_back(item);
+            } else {
+                std::string id, name, condition;
+                if (queue.removeFront(id, name, condition)) {
+                    model.pop_front();
+                    ++discharged;
+                }
+                if (!supplyModel.empty()) {
+                    stack.pop();
+                    supplyModel.pop_back();
+                }
+            }
+            queue.persistLater();
+            if (op % 5 == 0) {
+                DischargeArchive::Query query = archive.prepareQuery(0, INT64_MAX, std::string());
+                pool.submit([query, wrongCounts, discharged] {
+                    if (query.run([](const DischargeRecord&) {}) != discharged) {
+                        ++*wrongCounts;
+                    }
+                });
+            }
+            if (op % 7 == 0) {
+                // A load rebuilds the stack, so the next save is a full rewrite again
+                expect(stack.saveToCsv(supplyFile), "supply save failed");
+                expect(stack.loadFromCsv(supplyFile), "supply reload failed");
+            } else {
+                stack.saveToCsvLater(supplyFile);
+            }
+        }
+        stack.saveToCsvLater(supplyFile); // the file exists even when no operation ran
+        pool.flush();
+    }
+
+    expect(*wrongCounts == 0, "archive query on the pool missed or added discharges");
+    DischargeArchive reopened(archiveDir);
+    expect(reopened.size() == discharged, "archive written through the pool lost discharges");
+    PatientQueue reloaded(file);
+    expectPatients(reloaded, model);
+    SupplyStack fresh;
+    for (const Supply& item : supplyModel) {
+        fresh.push(item);
+    }
+    expect(fresh.saveToCsv(fullFile), "supply full save failed");
+    expect(readBytes(supplyFile) == readBytes(fullFile), "supply file saved through the pool differs from a full save");
+}
+
+// ---------------------------------------------------------------------------
+// --import of a file the program saved itself, or of one in the older
+// top-first layout, must rebuild the same stack
+
+void supplyImport(FuzzInput& in) {
+    const std::string saved = scratchFile("supplies-saved.csv");
+    const std::string store = scratchFile("supplies-store.csv");
+    std::vector<Supply> model;
+    SupplyStack original;
+    while (!in.exhausted()) {
+        // The importer wants a batch; the store itself does not
+        Supply item{in.text(1, 30), static_cast<int>(in.word() % 1000000) + 1, in.text(1, 20)};
+        original.push(item);
+        model.push_back(item);
+    }
+    expect(original.saveToCsv(saved), "supply save failed");
+
+    SupplyStack imported;
+    ImportReport report;
+    expect(importSupplies(saved, imported, store, report), "supply import failed");
+    expect(report.recordsRead == model.size() && report.recordsImported == model.size() &&
+               report.recordsRejected == 0,
+           "import rejected rows of a saved supply file");
+    expect(report.committed == !model.empty(), "import did not commit the store file");
+    expectSupplies(imported, model);
+
+    // Files from before the Depth layout list the top first
+    std::string legacy = "Position,Type,Quantity,Batch\n";
+    for (std::size_t i = model.size(); i > 0; --i) {
+        const Supply& item = model[i - 1];
+        legacy += std::to_string(model.size() - i + 1) + "," + item.type + "," + std::to_string(item.quantity) + "," +
+                  item.batch + "\n";
+    }
+    writeBytes(saved, legacy);
+    SupplyStack importedLegacy;
+    ImportReport legacyReport;
+    expect(importSupplies(saved, importedLegacy, store, legacyReport), "legacy supply import failed");
+    expectSupplies(importedLegacy, model);
+}
+
+void runInput(const std::uint8_t* data, std::size_t size) {
+    FuzzInput in(data, size);
+    std::uint8_t pick = in.byte() % static_cast<std::uint8_t>(Scenario::Count);
+    currentScenario = SCENARIO_NAMES[pick];
+    switch (static_cast<Scenario>(pick)) {
+        case Scenario::PatientOps: patientOps(in); break;
+        case Scenario::SupplyOps: supplyOps(in); break;
+        case Scenario::TriageOps: triageOps(in); break;
+        case Scenario::SupplyCsv: supplyCsv(in); break;
+        case Scenario::PatientCsv: patientCsv(in); break;
+        case Scenario::DuplicateIds: duplicateIds(in); break;
+        case Scenario::BackgroundWrites: backgroundWrites(in); break;
+        case Scenario::SupplyImport: supplyImport(in); break;
+        case Scenario::Count: break;
+    }
+}
+
+// The stores report problems on the console; the harness only needs return values
+void silenceStores() {
+    static std::ostringstream sink;
+    std::cout.rdbuf(sink.rdbuf());
+    std::cerr.rdbuf(sink.rdbuf());
+    sink.str(std::string());
+}
+
+} // namespace
+
+#ifdef HOSPITAL_LIBFUZZER
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    silenceStores();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    silenceStores(); // also drops what the previous input printed
+    runInput(data, size);
+    return 0;
+}
+
+#else
+
+namespace {
+
+// CSV-looking bytes: uniform random bytes rarely form a row the loaders keep
+std::string csvLikeBytes(std::mt19937_64& rng, std::size_t length) {
+    static const char* const TOKENS[] = {",", ",", ",", "\n", "\n", "\r\n", " ", "\t", "-", "0", "7", "42",
+                                         "99999999999", "A", "P001", "MASK", "x", "",
+                                         "Depth,Type,Quantity,Batch\n", "Position,Type,Quantity,Batch\n",
+                                         "No patients in queue"};
+    std::string bytes;
+    while (bytes.size() < length) {
+        if (rng() % 16 == 0) {
+            bytes += static_cast<char>(rng() % 256);
+        } else {
+            bytes += TOKENS[rng() % (sizeof(TOKENS) / sizeof(TOKENS[0]))];
+        }
+    }
+    return bytes;
+}
+
+int usage(const char* program) {
+    std::fprintf(stderr, "Usage: %s [--runs N] [--seed S] [--max-len BYTES] [FILE...]\n", program);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long long runs = 10000;
+    unsigned long long seed = std::random_device()();
+    std::size_t maxLength = 4096;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--runs" || arg == "--seed" || arg == "--max-len") && i + 1 < argc) {
+            unsigned long long value = std::strtoull(argv[++i], nullptr, 10);
+            if (arg == "--runs") {
+                runs = value;
+            } else if (arg == "--seed") {
+                seed = value;
+            } else {
+                maxLength = static_cast<std::size_t>(std::max(value, 1ULL));
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    silenceStores();
+    if (!files.empty()) {
+        for (const std::string& file : files) {
+            std::string bytes = readBytes(file);
+            runInput(reinterpret_cast<const std::uint8_t*>(bytes.data()), bytes.size());
+            silenceStores();
+        }
+        std::printf("hospital_fuzz: %zu input(s), no differences\n", files.size());
+        return 0;
+    }
+
+    std::mt19937_64 rng(seed);
+    unsigned long long perScenario[static_cast<int>(Scenario::Count)] = {};
+    for (unsigned long long run = 0; run < runs; ++run) {
+        std::uint8_t pick = static_cast<std::uint8_t>(rng() % static_cast<int>(Scenario::Count));
+        std::size_t length = static_cast<std::size_t>(rng() % maxLength);
+        std::string bytes(1, static_cast<char>(pick));
+        if (static_cast<Scenario>(pick) == Scenario::SupplyCsv || static_cast<Scenario>(pick) == Scenario::PatientCsv) {
+            bytes += csvLikeBytes(rng, length);
+        } else {
+            for (std::size_t i = 0; i < length; ++i) {
+                bytes += static_cast<char>(rng() % 256);
+            }
+        }
+        runInput(reinterpret_cast<const std::uint8_t*>(bytes.data()), bytes.size());
+        silenceStores();
+        ++perScenario[pick];
+    }
+
+    std::printf("hospital_fuzz: %llu inputs from seed %llu, no differences\n", runs, seed);
+    for (int i = 0; i < static_cast<int>(Scenario::Count); ++i) {
+        std::printf("  %-20s %llu\n", SCENARIO_NAMES[i], perScenario[i]);
+    }
+    return 0;
+}
+
+#endif // HOSPITAL_LIBFUZZER
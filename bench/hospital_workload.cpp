@@ -0,0 +1,477 @@
+/**
+ * Synthetic hospital workload generator and replay harness.
+ *
+ * generate: writes a mixed trace in the command-mode protocol (see
+ *   CommandMode.hpp), so a trace can also be fed to "program --script" or
+ *   to a running server.
+ *     hospital_workload generate [--ops N] [--seed S] [--ambulances K]
+ *         [--rates admit=20,discharge=18,log=20,process=18,add=10,use=9,rotate=5]
+ *         [--priorities 30,30,20,12,8] [--skew S] [--save-every N] [--out FILE]
+ *   --rates       relative frequency of each operation type
+ *   --priorities  relative frequency of triage priorities 1..5
+ *   --skew        Zipf exponent for conditions, emergency and supply types
+ *                 (0 = uniform, larger = a few hot values dominate)
+ *   Removals are only generated when the simulated store is non-empty.
+ *
+ * replay: parses a trace up front, then drives it through fresh in-memory
+ *   PatientQueue / SupplyStack / EmergencyDepartmentSystem /
+ *   AmbulanceScheduler instances, timing every operation. Prints one JSON
+ *   line per operation type (count, ops/sec, p50/p99/p99.9/max ns) and a
+ *   total line.
+ *     hospital_workload replay TRACE
+ *
+ * simulate: runs the triage queue against a virtual clock, one service slot
+ *   per simulated minute, with Poisson case arrivals, and prints the wait
+ *   statistics per priority for each aging step. With aging disabled the
+ *   lowest priority absorbs all queueing delay under sustained load and its
+ *   worst-case wait keeps growing with the run length; with aging it is
+ *   bounded by roughly four aging steps plus the top-priority backlog.
+ *     hospital_workload simulate [--hours H] [--load L] [--seed S]
+ *         [--priorities 30,30,20,12,8] [--aging-minutes 0,10,30] [--aging-file CSV]
+ *   --load           mean arrivals per service slot (below 1 keeps the queue stable)
+ *   --aging-minutes  default aging steps to compare (0 = no aging)
+ *   --aging-file     per-type aging policies, as in data/TriageAging.csv
+ */
+
+#include "PatientAdmission.hpp"
+#include "SupplyStack.hpp"
+#include "functionality.hpp"
+#include "ambulance_dispatcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum OpType { OP_ADMIT, OP_DISCHARGE, OP_LOG, OP_PROCESS, OP_ADD, OP_USE, OP_ROTATE, OP_REGISTER, OP_SAVE, OP_COUNT };
+
+const char* const OP_COMMANDS[OP_COUNT] = {"ADMIT", "DISCHARGE", "LOG", "PROCESS", "ADD", "USE", "ROTATE", "REGISTER", "SAVE"};
+const char* const OP_NAMES[OP_COUNT] = {"admit", "discharge", "log", "process", "add", "use", "rotate", "register", "save"};
+
+const std::vector<std::string> CONDITIONS = {"FEVER", "FRACTURE", "CHEST PAIN", "ASTHMA", "DIABETES",
+                                             "LACERATION", "MIGRAINE", "PNEUMONIA", "STROKE", "BURN"};
+const std::vector<std::string> EMERGENCY_TYPES = {"TRAUMA", "CARDIAC", "RESPIRATORY", "NEURO", "BURN",
+                                                  "POISONING", "OBSTETRIC", "PEDIATRIC"};
+const std::vector<std::string> SUPPLY_TYPES = {"GAUZE", "SYRINGE", "GLOVES", "SALINE", "MASK",
+                                               "BANDAGE", "CATHETER", "IV SET", "SUTURE", "ALCOHOL SWAB"};
+
+// ---------------------------------------------------------------------------
+// Generation
+
+struct GenerateOptions {
+    std::size_t ops = 1000000;
+    unsigned seed = 42;
+    int ambulances = 6;
+    std::array<double, 7> rates = {{20, 18, 20, 18, 10, 9, 5}}; // ADMIT..ROTATE
+    std::array<double, 5> priorities = {{30, 30, 20, 12, 8}};
+    double skew = 1.0;
+    std::size_t saveEvery = 0;
+    std::string out;
+};
+
+// Discrete Zipf-like distribution over n values with exponent s
+std::discrete_distribution<int> zipf(std::size_t n, double s) {
+    std::vector<double> weights;
+    for (std::size_t k = 1; k <= n; ++k) {
+        weights.push_back(1.0 / std::pow(static_cast<double>(k), s));
+    }
+    return std::discrete_distribution<int>(weights.begin(), weights.end());
+}
+
+int generate(const GenerateOptions& options) {
+    std::ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file) {
+            std::cerr << "Error: unable to write '" << options.out << "'.\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.out.empty() ? std::cout : file;
+
+    std::mt19937_64 rng(options.seed);
+    std::discrete_distribution<int> pickOp(options.rates.begin(), options.rates.end());
+    std::discrete_distribution<int> pickPriority(options.priorities.begin(), options.priorities.end());
+    std::discrete_distribution<int> pickCondition = zipf(CONDITIONS.size(), options.skew);
+    std::discrete_distribution<int> pickEmergency = zipf(EMERGENCY_TYPES.size(), options.skew);
+    std::discrete_distribution<int> pickSupply = zipf(SUPPLY_TYPES.size(), options.skew);
+    std::uniform_int_distribution<int> pickQuantity(1, 200);
+
+    out << "# hospital_workload trace: ops=" << options.ops << " seed=" << options.seed
+        << " skew=" << options.skew << "\n";
+    int ambulances = std::min(options.ambulances, MAX_AMBULANCES);
+    for (int i = 0; i < ambulances; ++i) {
+        out << "REGISTER DRIVER " << (i + 1) << "\n";
+    }
+
+    std::size_t queued = 0, pending = 0, stocked = 0;
+    std::size_t nextPatient = 1, nextBatch = 1;
+    std::string line;
+    for (std::size_t i = 0; i < options.ops; ++i) {
+        int op = pickOp(rng);
+        // Keep removals valid: an empty store gets an insertion instead
+        if (op == OP_DISCHARGE && queued == 0) op = OP_ADMIT;
+        if (op == OP_PROCESS && pending == 0) op = OP_LOG;
+        if (op == OP_USE && stocked == 0) op = OP_ADD;
+
+        switch (op) {
+            case OP_ADMIT:
+                out << "ADMIT P" << nextPatient << ",PATIENT " << nextPatient << ','
+                    << CONDITIONS[static_cast<std::size_t>(pickCondition(rng))] << '\n';
+                ++nextPatient;
+                ++queued;
+                break;
+            case OP_DISCHARGE:
+                out << "DISCHARGE\n";
+                --queued;
+                break;
+            case OP_LOG:
+                out << "LOG CASE " << i << ',' << EMERGENCY_TYPES[static_cast<std::size_t>(pickEmergency(rng))]
+                    << ',' << (pickPriority(rng) + 1) << '\n';
+                ++pending;
+                break;
+            case OP_PROCESS:
+                out << "PROCESS\n";
+                --pending;
+                break;
+            case OP_ADD:
+                out << "ADD " << SUPPLY_TYPES[static_cast<std::size_t>(pickSupply(rng))] << ','
+                    << pickQuantity(rng) << ",B" << nextBatch++ << '\n';
+                ++stocked;
+                break;
+            case OP_USE:
+                out << "USE\n";
+                --stocked;
+                break;
+            default:
+                out << "ROTATE\n";
+                break;
+        }
+        if (options.saveEvery != 0 && (i + 1) % options.saveEvery == 0) {
+            out << "SAVE\n";
+        }
+    }
+    return out ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Replay
+
+struct TraceOp {
+    OpType type;
+    std::string a, b, c;
+    int number;
+};
+
+// Parse "COMMAND a,b,c" lines; unknown or malformed lines are reported and skipped
+bool loadTrace(const std::string& filename, std::vector<TraceOp>& ops) {
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Error: unable to read trace '" << filename << "'.\n";
+        return false;
+    }
+    std::string line;
+    std::size_t lineNumber = 0, skipped = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        line = PatientQueue::trim(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        std::size_t space = line.find(' ');
+        std::string command = line.substr(0, space);
+        std::string rest = (space == std::string::npos) ? "" : line.substr(space + 1);
+        std::string fields[3];
+        std::stringstream ss(rest);
+        for (std::string& f : fields) {
+            std::getline(ss, f, ',');
+        }
+
+        TraceOp op{OP_COUNT, fields[0], fields[1], fields[2], 0};
+        for (int t = 0; t < OP_COUNT; ++t) {
+            if (command == OP_COMMANDS[t]) op.type = static_cast<OpType>(t);
+        }
+        if (op.type == OP_ADD || op.type == OP_LOG) {
+            op.number = std::atoi((op.type == OP_ADD ? fields[1] : fields[2]).c_str());
+        }
+        if (op.type == OP_COUNT) {
+            ++skipped;
+            continue;
+        }
+        ops.push_back(op);
+    }
+    if (skipped > 0) {
+        std::cerr << "Warning: skipped " << skipped << " unrecognised trace lines.\n";
+    }
+    return true;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    return sorted[static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1))];
+}
+
+int replay(const std::string& filename) {
+    std::vector<TraceOp> ops;
+    if (!loadTrace(filename, ops)) {
+        return 1;
+    }
+
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / "hospital_replay";
+    std::filesystem::create_directories(scratch);
+    const std::string patientsFile = (scratch / "patients.csv").string();
+    const std::string suppliesFile = (scratch / "supplies.csv").string();
+    const std::string scheduleFile = (scratch / "schedule.csv").string();
+    std::filesystem::remove(patientsFile);
+
+    PatientQueue patients(patientsFile);
+    SupplyStack supplies;
+    EmergencyDepartmentSystem triage;
+    AmbulanceScheduler scheduler;
+
+    std::vector<std::vector<double>> latencies(OP_COUNT);
+    std::size_t failures = 0;
+    std::string id, name, condition;
+    EmergencyCase taken;
+
+    auto replayStarted = std::chrono::steady_clock::now();
+    for (const TraceOp& op : ops) {
+        bool ok = true;
+        auto started = std::chrono::steady_clock::now();
+        switch (op.type) {
+            case OP_ADMIT:
+                ok = patients.appendPatient(op.a, op.b, op.c);
+                break;
+            case OP_DISCHARGE:
+                ok = patients.removeFront(id, name, condition);
+                break;
+            case OP_LOG:
+                triage.enqueueCase(op.a, op.b, op.number);
+                break;
+            case OP_PROCESS:
+                ok = triage.takeMostCriticalCase(taken);
+                break;
+            case OP_ADD:
+                supplies.addSupplyStock(op.a, op.number, op.c);
+                break;
+            case OP_USE:
+                ok = !supplies.isEmpty();
+                supplies.useLastAddedSupply();
+                break;
+            case OP_ROTATE:
+                ok = scheduler.rotateShift();
+                break;
+            case OP_REGISTER: {
+                Ambulance ambulance{};
+                ambulance.driverName = op.a;
+                ok = !scheduler.registerAmbulance(ambulance).empty();
+                break;
+            }
+            case OP_SAVE:
+                ok = patients.persist() && supplies.saveToCsv(suppliesFile) &&
+                     scheduler.saveScheduleToCsv(scheduleFile);
+                break;
+            default:
+                break;
+        }
+        auto finished = std::chrono::steady_clock::now();
+        latencies[op.type].push_back(std::chrono::duration<double, std::nano>(finished - started).count());
+        if (!ok) ++failures;
+    }
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStarted).count();
+
+    for (int t = 0; t < OP_COUNT; ++t) {
+        std::vector<double>& samples = latencies[static_cast<std::size_t>(t)];
+        if (samples.empty()) continue;
+        double busyNs = 0.0;
+        for (double ns : samples) busyNs += ns;
+        std::sort(samples.begin(), samples.end());
+        std::printf("{\"op\":\"%s\",\"count\":%zu,\"ops_per_sec\":%.0f,\"p50_ns\":%.0f,"
+                    "\"p99_ns\":%.0f,\"p999_ns\":%.0f,\"max_ns\":%.0f}\n",
+                    OP_NAMES[t], samples.size(), busyNs > 0 ? samples.size() / (busyNs * 1e-9) : 0.0,
+                    percentile(samples, 0.50), percentile(samples, 0.99), percentile(samples, 0.999),
+                    samples.back());
+    }
+    std::printf("{\"op\":\"total\",\"count\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"failed\":%zu}\n",
+                ops.size(), totalSeconds, totalSeconds > 0 ? ops.size() / totalSeconds : 0.0, failures);
+
+    std::error_code ignored;
+    std::filesystem::remove_all(scratch, ignored);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Triage aging simulation
+
+struct SimulateOptions {
+    double hours = 24.0 * 7;
+    double load = 0.95;
+    unsigned seed = 42;
+    std::array<double, 5> priorities = {{30, 30, 20, 12, 8}};
+    std::vector<double> agingMinutes = {0, 10, 30};
+    std::string agingFile;
+};
+
+const std::int64_t SIM_MINUTE_NS = 60LL * 1000 * 1000 * 1000;
+
+std::int64_t simulatedNow = 0;
+
+std::int64_t simulatedClock() {
+    return simulatedNow;
+}
+
+int simulate(const SimulateOptions& options) {
+    long long minutes = static_cast<long long>(options.hours * 60.0);
+    for (double aging : options.agingMinutes) {
+        EmergencyDepartmentSystem triage;
+        triage.setClock(simulatedClock);
+        triage.setDefaultAgingStep(static_cast<std::int64_t>(aging * SIM_MINUTE_NS));
+        if (!options.agingFile.empty() && !triage.loadAgingPolicies(options.agingFile)) {
+            std::cerr << "Error: unable to read '" << options.agingFile << "'.\n";
+            return 1;
+        }
+
+        // Same seed for every step, so each run sees the same arrivals
+        std::mt19937_64 rng(options.seed);
+        std::poisson_distribution<int> arrivals(options.load);
+        std::discrete_distribution<int> pickPriority(options.priorities.begin(), options.priorities.end());
+        std::uniform_int_distribution<std::size_t> pickType(0, EMERGENCY_TYPES.size() - 1);
+        EmergencyCase taken;
+
+        simulatedNow = 0;
+        for (long long minute = 0; minute < minutes; ++minute) {
+            simulatedNow = minute * SIM_MINUTE_NS;
+            for (int n = arrivals(rng); n > 0; --n) {
+                triage.enqueueCase("SIM", EMERGENCY_TYPES[pickType(rng)], pickPriority(rng) + 1);
+            }
+            triage.takeMostCriticalCase(taken);
+        }
+
+        for (int priority = MAX_PRIORITY; priority >= MIN_PRIORITY; --priority) {
+            WaitTimeStats s = triage.waitTimeStats(priority);
+            std::printf("{\"aging_minutes\":%g,\"priority\":%d,\"processed\":%llu,\"waiting\":%zu,"
+                        "\"mean_wait_min\":%.1f,\"p95_wait_min\":%.1f,\"max_wait_min\":%.1f,"
+                        "\"oldest_waiting_min\":%.1f}\n",
+                        aging, priority, static_cast<unsigned long long>(s.processed), s.waiting,
+                        s.meanWait / 60.0, s.p95Wait / 60.0, s.maxWait / 60.0, s.oldestWaiting / 60.0);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Command line
+
+template <std::size_t N>
+bool parseWeights(const std::string& text, std::array<double, N>& weights) {
+    std::stringstream ss(text);
+    std::string item;
+    for (std::size_t i = 0; i < N; ++i) {
+        if (!std::getline(ss, item, ',')) return false;
+        weights[i] = std::strtod(item.c_str(), nullptr);
+        if (weights[i] < 0) return false;
+    }
+    return true;
+}
+
+// "0,10,30" -> values; at least one, none negative
+bool parseList(const std::string& text, std::vector<double>& values) {
+    values.clear();
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::strtod(item.c_str(), nullptr));
+        if (values.back() < 0) return false;
+    }
+    return !values.empty();
+}
+
+// "admit=20,discharge=18,..." -> rates; unspecified types keep their default
+bool parseRates(const std::string& text, std::array<double, 7>& rates) {
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = item.substr(0, eq);
+        int index = -1;
+        for (int t = 0; t <= OP_ROTATE; ++t) {
+            if (key == OP_NAMES[t]) index = t;
+        }
+        double value = std::strtod(item.c_str() + eq + 1, nullptr);
+        if (index < 0 || value < 0) return false;
+        rates[static_cast<std::size_t>(index)] = value;
+    }
+    return true;
+}
+
+int usage(const char* program) {
+    std::cerr << "Usage: " << program << " generate [--ops N] [--seed S] [--ambulances K] [--rates admit=W,...]\n"
+              << "           [--priorities W1,W2,W3,W4,W5] [--skew S] [--save-every N] [--out FILE]\n"
+              << "       " << program << " replay TRACE\n"
+              << "       " << program << " simulate [--hours H] [--load L] [--seed S] [--priorities W1,...,W5]\n"
+              << "           [--aging-minutes M1,M2,...] [--aging-file CSV]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    std::string mode = argv[1];
+    if (mode == "replay") {
+        return (argc == 3) ? replay(argv[2]) : usage(argv[0]);
+    }
+    if (mode == "simulate") {
+        SimulateOptions options;
+        for (int i = 2; i < argc; i += 2) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) return usage(argv[0]);
+            std::string value = argv[i + 1];
+            bool ok = true;
+            if (flag == "--hours") options.hours = std::strtod(value.c_str(), nullptr);
+            else if (flag == "--load") options.load = std::strtod(value.c_str(), nullptr);
+            else if (flag == "--seed") options.seed = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+            else if (flag == "--priorities") ok = parseWeights(value, options.priorities);
+            else if (flag == "--aging-minutes") ok = parseList(value, options.agingMinutes);
+            else if (flag == "--aging-file") options.agingFile = value;
+            else ok = false;
+            if (!ok || options.load <= 0) return usage(argv[0]);
+        }
+        return simulate(options);
+    }
+    if (mode != "generate") {
+        return usage(argv[0]);
+    }
+
+    GenerateOptions options;
+    for (int i = 2; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) return usage(argv[0]);
+        std::string value = argv[i + 1];
+        bool ok = true;
+        if (flag == "--ops") options.ops = std::strtoull(value.c_str(), nullptr, 10);
+        else if (flag == "--seed") options.seed = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (flag == "--ambulances") options.ambulances = std::atoi(value.c_str());
+        else if (flag == "--rates") ok = parseRates(value, options.rates);
+        else if (flag == "--priorities") ok = parseWeights(value, options.priorities);
+        else if (flag == "--skew") options.skew = std::strtod(value.c_str(), nullptr);
+        else if (flag == "--save-every") options.saveEvery = std::strtoull(value.c_str(), nullptr, 10);
+        else if (flag == "--out") options.out = value;
+        else ok = false;
+        if (!ok) return usage(argv[0]);
+    }
+    return generate(options);
+}
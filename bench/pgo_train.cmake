@@ -0,0 +1,22 @@
+# PGO training run (target pgo-train): replays a generated trace through the
+# stores, feeds the same trace through the command protocol, and runs the
+# triage simulation. Invoked with -DPROGRAM=... -DWORKLOAD=... -DRUN_DIR=...
+
+file(REMOVE_RECURSE ${RUN_DIR})
+file(MAKE_DIRECTORY ${RUN_DIR}/data)
+
+function(run)
+    execute_process(COMMAND ${ARGN}
+                    WORKING_DIRECTORY ${RUN_DIR}
+                    OUTPUT_FILE ${RUN_DIR}/train.log
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO training step failed (${result}): ${ARGN}")
+    endif()
+endfunction()
+
+run(${WORKLOAD} generate --ops 2000000 --save-every 200000 --out ${RUN_DIR}/trace.txt)
+run(${WORKLOAD} replay ${RUN_DIR}/trace.txt)
+run(${PROGRAM} --script ${RUN_DIR}/trace.txt)
+run(${WORKLOAD} simulate --hours 168)
+message(STATUS "PGO training finished; reconfigure with -DHOSPITAL_PGO=USE and rebuild")
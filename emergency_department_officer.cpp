@@ -1,47 +1,324 @@
 #include "functionality.hpp"
+#include "TableRenderer.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <sstream>
 
-bool EmergencyCaseComparator::operator()(const EmergencyCase &a, const EmergencyCase &b) const {
-	if (a.priority != b.priority) return a.priority < b.priority; // lower priority goes after
-	return a.id > b.id; // later arrivals go after earlier ones
+namespace {
+
+const std::int64_t NS_PER_MINUTE = 60LL * 1000 * 1000 * 1000;
+const std::int64_t MAX_AGING_MINUTES = std::numeric_limits<std::int64_t>::max() / NS_PER_MINUTE;
+
+std::int64_t steadyNowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int waitsIndex(int priority) {
+	return std::min(std::max(priority, MIN_PRIORITY), MAX_PRIORITY);
+}
+
+// Base priority plus one level per completed aging step, capped at MAX_PRIORITY
+int agedPriority(int level, std::int64_t loggedAtNs, std::int64_t stepNs, std::int64_t now) {
+	if (stepNs <= 0 || now <= loggedAtNs) return level;
+	std::int64_t steps = (now - loggedAtNs) / stepNs;
+	return static_cast<int>(std::min<std::int64_t>(level + steps, MAX_PRIORITY));
+}
+
+// Processing order packed in one integer, highest first: aged priority in the
+// top bits, then the lower id (stored inverted). The slab slot rides in the
+// low bits and never decides, since ids are unique; it allows 2^30 pending
+// cases, far past what the 64-byte records would fit in memory.
+const int KEY_AGED_SHIFT = 61;
+const int KEY_ID_SHIFT = 30;
+const std::uint64_t KEY_SLOT_MASK = (std::uint64_t(1) << KEY_ID_SHIFT) - 1;
+
+std::uint64_t processingKey(int aged, std::int32_t id, std::uint32_t slot) {
+	return (static_cast<std::uint64_t>(aged) << KEY_AGED_SHIFT) |
+	       (static_cast<std::uint64_t>(INT32_MAX - id) << KEY_ID_SHIFT) | slot;
+}
+
+std::string normalizedType(const std::string &text) {
+	std::size_t start = text.find_first_not_of(" \t\r\n");
+	if (start == std::string::npos) return "";
+	std::size_t end = text.find_last_not_of(" \t\r\n");
+	std::string result = text.substr(start, end - start + 1);
+	for (char &c : result) {
+		c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	}
+	return result;
+}
+
+} // namespace
+
+EmergencyDepartmentSystem::EmergencyDepartmentSystem()
+	: nextId(1), pending(0), clock(steadyNowNs),
+	  agingSteps(1, DEFAULT_AGING_MINUTES * NS_PER_MINUTE), buckets(1) {
+	for (PriorityWaits &w : waits) {
+		w.histogram.assign(LATENCY_BUCKET_COUNT, 0);
+	}
+}
+
+std::size_t EmergencyDepartmentSystem::policyFor(const std::string &emergencyType) {
+	if (policyByType.empty()) return 0;
+	std::unordered_map<std::string, std::size_t>::const_iterator found = policyByType.find(normalizedType(emergencyType));
+	return found == policyByType.end() ? 0 : found->second;
+}
+
+void EmergencyDepartmentSystem::setAgingStep(const std::string &emergencyType, std::int64_t stepNs) {
+	stepNs = std::max<std::int64_t>(stepNs, 0);
+	// Types sharing a step share buckets, so dequeue cost follows the number of distinct steps
+	std::size_t policy = 1;
+	while (policy < agingSteps.size() && agingSteps[policy] != stepNs) ++policy;
+	if (policy == agingSteps.size()) {
+		agingSteps.push_back(stepNs);
+		buckets.emplace_back();
+	}
+	policyByType[normalizedType(emergencyType)] = policy;
 }
 
-EmergencyDepartmentSystem::EmergencyDepartmentSystem() : nextId(1) {}
+void EmergencyDepartmentSystem::setDefaultAgingStep(std::int64_t stepNs) {
+	agingSteps[0] = std::max<std::int64_t>(stepNs, 0);
+}
+
+bool EmergencyDepartmentSystem::loadAgingPolicies(const std::string &filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) return false;
+	std::string line;
+	std::getline(file, line); // header
+	while (std::getline(file, line)) {
+		std::stringstream ss(line);
+		std::string type, minutes;
+		if (!std::getline(ss, type, ',') || !std::getline(ss, minutes)) continue;
+		if (normalizedType(type).empty()) continue;
+		char *end = nullptr;
+		double value = std::strtod(minutes.c_str(), &end);
+		if (end == minutes.c_str() || !std::isfinite(value) || value < 0) continue;
+		// Longer steps than int64 nanoseconds can hold never complete anyway
+		value = std::min(value, static_cast<double>(MAX_AGING_MINUTES));
+		setAgingStep(type, static_cast<std::int64_t>(value * static_cast<double>(NS_PER_MINUTE)));
+	}
+	return true;
+}
+
+void EmergencyDepartmentSystem::setClock(TriageClock newClock) {
+	clock = newClock ? newClock : steadyNowNs;
+}
+
+int EmergencyDepartmentSystem::enqueueCase(const std::string &patientName, const std::string &emergencyType, int priority) {
+	std::int64_t now = clock();
+	std::uint32_t slot = records.allocate();
+	buckets[policyFor(emergencyType)][static_cast<std::size_t>(waitsIndex(priority))].push_back(PendingCase{now, nextId, slot});
+	CaseRecord &record = records[slot];
+	record.loggedAtNs = now;
+	record.id = nextId;
+	record.priority = priority;
+	record.patientName.assign(patientName, arena);
+	record.emergencyType.assign(emergencyType, arena);
+	++pending;
+	return nextId++;
+}
+
+// processMostCriticalCase and the command protocol both land here, so it is timed once
+bool EmergencyDepartmentSystem::takeMostCriticalCase(EmergencyCase &out) {
+	HOSPITAL_METRIC_SCOPE(MetricId::TriageProcess);
+	if (pending == 0) return false;
+
+	// Highest aged priority wins; ties go to the earliest logged case
+	std::int64_t now = clock();
+	Queue<PendingCase> *best = nullptr;
+	std::uint64_t bestKey = 0;
+	for (std::size_t policy = 0; policy < buckets.size(); ++policy) {
+		for (int level = MAX_PRIORITY; level >= MIN_PRIORITY; --level) {
+			Queue<PendingCase> &bucket = buckets[policy][static_cast<std::size_t>(level)];
+			if (bucket.empty()) continue;
+			const PendingCase &front = bucket.front();
+			std::uint64_t key = processingKey(agedPriority(level, front.loggedAtNs, agingSteps[policy], now), front.id, front.slot);
+			if (key > bestKey) {
+				best = &bucket;
+				bestKey = key;
+			}
+		}
+	}
+	int bestPriority = static_cast<int>(bestKey >> KEY_AGED_SHIFT);
+	std::uint32_t slot = best->front().slot;
+	best->pop_front();
+	CaseRecord &taken = records[slot];
+	out.id = taken.id;
+	out.patientName.assign(taken.patientName.data(), taken.patientName.size());
+	out.emergencyType.assign(taken.emergencyType.data(), taken.emergencyType.size());
+	out.priority = taken.priority;
+	out.loggedAtNs = taken.loggedAtNs;
+	taken.forEachString([this](const auto &field) { field.release(arena); });
+	taken.id = 0;
+	records.release(slot);
+	--pending;
+	reclaimSpilled();
+
+	out.processedAtNs = now;
+	out.agedPriority = bestPriority;
+	std::uint64_t waited = static_cast<std::uint64_t>(std::max<std::int64_t>(out.processedAtNs - out.loggedAtNs, 0));
+	PriorityWaits &w = waits[waitsIndex(out.priority)];
+	w.processed++;
+	w.totalWaitNs += waited;
+	w.maxWaitNs = std::max(w.maxWaitNs, waited);
+	// Microsecond resolution keeps waits of days inside the histogram range
+	w.histogram[static_cast<std::size_t>(latencyBucketFor(waited / 1000))]++;
+	return true;
+}
+
+// Spilled strings of processed cases stay in the arena until it is cleared
+// (no pending cases) or rebuilt from the pending ones (mostly dead)
+void EmergencyDepartmentSystem::reclaimSpilled() {
+	if (pending == 0) {
+		arena.clear();
+		records.clear();
+	} else if (arena.wantsCompaction()) {
+		StringArena fresh;
+		for (std::uint32_t slot = 0; slot < records.extent(); ++slot) {
+			if (records[slot].id != 0) {
+				records[slot].forEachString([&fresh](auto &field) { field.moveTo(fresh); });
+			}
+		}
+		arena.swap(fresh);
+	}
+}
+
+WaitTimeStats EmergencyDepartmentSystem::waitTimeStats(int priority) const {
+	const PriorityWaits &w = waits[waitsIndex(priority)];
+	std::size_t level = static_cast<std::size_t>(waitsIndex(priority));
+	std::size_t waiting = 0;
+	const PendingCase *oldest = nullptr;
+	for (const PriorityBuckets &policyBuckets : buckets) {
+		const Queue<PendingCase> &bucket = policyBuckets[level];
+		waiting += bucket.size();
+		if (!bucket.empty() && (oldest == nullptr || bucket.front().id < oldest->id)) {
+			oldest = &bucket.front();
+		}
+	}
+	WaitTimeStats stats{w.processed, waiting, 0.0, 0.0, 0.0, 0.0};
+	if (w.processed > 0) {
+		stats.meanWait = static_cast<double>(w.totalWaitNs) / static_cast<double>(w.processed) * 1e-9;
+		stats.maxWait = static_cast<double>(w.maxWaitNs) * 1e-9;
+		// The histogram has a fixed bucket count, so this does not grow with the queue
+		std::uint64_t rank = static_cast<std::uint64_t>(0.95 * static_cast<double>(w.processed - 1)) + 1;
+		std::uint64_t seen = 0;
+		for (int b = 0; b < LATENCY_BUCKET_COUNT; ++b) {
+			seen += w.histogram[static_cast<std::size_t>(b)];
+			if (seen >= rank) {
+				stats.p95Wait = std::min(latencyBucketValue(b) * 1e3, static_cast<double>(w.maxWaitNs)) * 1e-9;
+				break;
+			}
+		}
+	}
+	if (oldest != nullptr) {
+		stats.oldestWaiting = static_cast<double>(std::max<std::int64_t>(clock() - oldest->loggedAtNs, 0)) * 1e-9;
+	}
+	return stats;
+}
+
+void EmergencyDepartmentSystem::viewWaitTimeStats() const {
+	TableRenderer table({{"Priority", 10}, {"Processed", 12}, {"Waiting", 10}, {"Mean (s)", 12},
+	                     {"P95 (s)", 12}, {"Max (s)", 12}, {"Oldest waiting (s)", 20}});
+	table.line("Triage Wait Times (logged -> processed):");
+	table.header();
+	char number[32];
+	auto seconds = [&number](double value) {
+		std::snprintf(number, sizeof(number), "%.3f", value);
+		return std::string(number);
+	};
+	for (int priority = MAX_PRIORITY; priority >= MIN_PRIORITY; --priority) {
+		WaitTimeStats s = waitTimeStats(priority);
+		table.cell(priority).cell(static_cast<long long>(s.processed)).cell(static_cast<long long>(s.waiting))
+		     .cell(seconds(s.meanWait)).cell(seconds(s.p95Wait)).cell(seconds(s.maxWait))
+		     .cell(seconds(s.oldestWaiting));
+		table.endRow();
+	}
+}
+
+void EmergencyDepartmentSystem::snapshotPending(std::vector<CaseRecord> &out, StringArena &strings) const {
+	out.reserve(out.size() + pending);
+	for (const PriorityBuckets &policyBuckets : buckets) {
+		for (const Queue<PendingCase> &bucket : policyBuckets) {
+			for (std::size_t i = 0; i < bucket.size(); ++i) {
+				out.push_back(records[bucket[i].slot]);
+				out.back().forEachString([&strings](auto &field) { field.moveTo(strings); });
+			}
+		}
+	}
+}
+
+std::size_t EmergencyDepartmentSystem::pendingCount() const {
+	return pending;
+}
 
 void EmergencyDepartmentSystem::logEmergencyCase(const std::string &patientName, const std::string &emergencyType, int priority) {
-	EmergencyCase c{nextId++, patientName, emergencyType, priority};
-	cases.push(c);
+	EmergencyCase c{enqueueCase(patientName, emergencyType, priority), patientName, emergencyType, priority, 0, 0, priority};
 	std::cout << "Case logged: [ID " << c.id << "] " << c.patientName
 		  << " | Type: " << c.emergencyType << " | Priority: " << c.priority << "\n";
 }
 
 bool EmergencyDepartmentSystem::processMostCriticalCase() {
-	if (cases.empty()) {
+	EmergencyCase c;
+	if (!takeMostCriticalCase(c)) {
 		std::cout << "No pending emergency cases.\n";
 		return false;
 	}
-	EmergencyCase c = cases.top();
-	cases.pop();
 	std::cout << "Processing most critical case -> [ID " << c.id << "] "
 		  << c.patientName << " | Type: " << c.emergencyType
-		  << " | Priority: " << c.priority << "\n";
+		  << " | Priority: " << c.priority;
+	if (c.agedPriority != c.priority) {
+		std::cout << " (aged to " << c.agedPriority << ")";
+	}
+	std::cout << "\n";
 	return true;
 }
 
 void EmergencyDepartmentSystem::viewPendingCases() const {
-	if (cases.empty()) {
+	if (pending == 0) {
 		std::cout << "No pending emergency cases.\n";
 		return;
 	}
-	std::priority_queue<EmergencyCase, std::deque<EmergencyCase>, EmergencyCaseComparator> temp = cases;
-	std::cout << "Pending Emergency Cases (highest priority first):\n";
-	while (!temp.empty()) {
-		const EmergencyCase &c = temp.top();
-		std::cout << "  [ID " << c.id << "] " << c.patientName
-			  << " | Type: " << c.emergencyType
-			  << " | Priority: " << c.priority << "\n";
-		temp.pop();
+	const ListingPage &page = listingPage();
+	TableRenderer table({{"Case ID", 10}, {"Patient", 25}, {"Type", 20}, {"Priority", 10}, {"Aged", 6}});
+	table.line("Pending Emergency Cases (processing order):");
+	table.header();
+
+	std::vector<std::uint64_t> keys;
+	keys.reserve(pending);
+	std::int64_t now = clock();
+	for (std::size_t policy = 0; policy < buckets.size(); ++policy) {
+		for (int level = MIN_PRIORITY; level <= MAX_PRIORITY; ++level) {
+			const Queue<PendingCase> &bucket = buckets[policy][static_cast<std::size_t>(level)];
+			for (std::size_t i = 0; i < bucket.size(); ++i) {
+				const PendingCase &entry = bucket[i];
+				keys.push_back(processingKey(agedPriority(level, entry.loggedAtNs, agingSteps[policy], now), entry.id, entry.slot));
+			}
+		}
+	}
+	// Heapify in O(n), then pop only until the page is full
+	PriorityQueue<std::uint64_t> order(std::move(keys));
+	for (std::size_t index = 0; !order.empty() && !page.pastEnd(index); ++index) {
+		if (page.contains(index)) {
+			const CaseRecord &c = records[static_cast<std::uint32_t>(order.top() & KEY_SLOT_MASK)];
+			table.cell(c.id)
+			     .cell(c.patientName.data(), c.patientName.size())
+			     .cell(c.emergencyType.data(), c.emergencyType.size())
+			     .cell(c.priority)
+			     .cell(static_cast<int>(order.top() >> KEY_AGED_SHIFT));
+			table.endRow();
+		}
+		order.pop();
 	}
+	table.pageSummary(page, pending);
 }
 
 
@@ -1,20 +1,61 @@
 #pragma once
 
-#include <queue>
+#include <array>
 #include <string>
-#include <deque>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Containers.hpp"
+#include "CompactRecords.hpp"
+
+const int MIN_PRIORITY = 1;
+const int MAX_PRIORITY = 5;
+
+// Aging: a pending case gains one priority level for every step it waits.
+// Aged cases compete with genuinely critical ones, so shorter steps trade
+// top-priority wait for fairness. Emergency types without an entry in
+// AGING_FILENAME use the default step.
+const int DEFAULT_AGING_MINUTES = 30;
+const char* const AGING_FILENAME = "data/TriageAging.csv";
 
 struct EmergencyCase {
 	int id;
 	std::string patientName;
 	std::string emergencyType;
 	int priority; // higher number = more critical
+	std::int64_t loggedAtNs;    // triage clock when the case was logged
+	std::int64_t processedAtNs; // triage clock when it was processed (0 while pending)
+	int agedPriority;           // effective priority when processed (after aging)
 };
 
-struct EmergencyCaseComparator {
-	bool operator()(const EmergencyCase &a, const EmergencyCase &b) const;
+// Pending case as stored in the triage slab (64 bytes, one cache line)
+struct CaseRecord {
+	std::int64_t loggedAtNs;
+	std::int32_t id;
+	std::int32_t priority;
+	InlineString<24> patientName;
+	InlineString<24> emergencyType;
+
+	template <typename F>
+	void forEachString(F &&f) {
+		f(patientName);
+		f(emergencyType);
+	}
 };
 
+// Wait-time statistics for one priority level (seconds)
+struct WaitTimeStats {
+	std::uint64_t processed;  // cases of this priority processed so far
+	std::size_t waiting;      // cases of this priority still pending
+	double meanWait;
+	double p95Wait;           // from a log-linear histogram, ~12% precision
+	double maxWait;
+	double oldestWaiting;     // age of the longest-waiting pending case, 0 if none
+};
+
+// Source of triage timestamps in nanoseconds (steady_clock unless replaced)
+typedef std::int64_t (*TriageClock)();
+
 class EmergencyDepartmentSystem {
 public:
 	EmergencyDepartmentSystem();
@@ -23,9 +64,59 @@ public:
 	bool processMostCriticalCase();
 	void viewPendingCases() const;
 
+	// Quiet variants used by non-interactive callers (no console output)
+	int enqueueCase(const std::string &patientName, const std::string &emergencyType, int priority);
+	bool takeMostCriticalCase(EmergencyCase &out);
+	std::size_t pendingCount() const;
+	// Appends a copy of every pending case (by policy, then priority, then age)
+	// with spilled strings re-homed in strings
+	void snapshotPending(std::vector<CaseRecord> &out, StringArena &strings) const;
+
+	// Wait-time analytics, maintained in O(1) per logged/processed case
+	WaitTimeStats waitTimeStats(int priority) const;
+	void viewWaitTimeStats() const;
+	void setClock(TriageClock clock); // e.g. a simulated clock in benchmarks
+
+	// Aging policy; a step of 0 disables aging. Applies to cases logged afterwards.
+	void setAgingStep(const std::string &emergencyType, std::int64_t stepNs);
+	void setDefaultAgingStep(std::int64_t stepNs);
+	// Reads "Emergency Type,Minutes Per Level" rows; returns false if the file is missing
+	bool loadAgingPolicies(const std::string &filename);
+
 private:
+	// Running wait statistics for one priority level
+	struct PriorityWaits {
+		std::uint64_t processed = 0;
+		std::uint64_t totalWaitNs = 0;
+		std::uint64_t maxWaitNs = 0;
+		std::vector<std::uint64_t> histogram; // LATENCY_BUCKET_COUNT buckets, in microseconds
+	};
+
+	// Bucket entry: what a dequeue compares, plus the slab slot of the full
+	// record, so the buckets move 16 bytes per case instead of 64
+	struct PendingCase {
+		std::int64_t loggedAtNs;
+		std::int32_t id;
+		std::uint32_t slot; // index into records
+	};
+
+	// FIFO per (aging policy, base priority). Every case in a bucket ages at the
+	// same rate, so the front is always the bucket's most urgent case and a
+	// dequeue only compares bucket fronts; nothing is re-sorted as time passes.
+	typedef std::array<Queue<PendingCase>, MAX_PRIORITY + 1> PriorityBuckets;
+
+	std::size_t policyFor(const std::string &emergencyType);
+	void reclaimSpilled(); // drop or compact the arena after a case leaves
+
 	int nextId;
-	std::priority_queue<EmergencyCase, std::deque<EmergencyCase>, EmergencyCaseComparator> cases;
+	std::size_t pending;
+	TriageClock clock;
+	PriorityWaits waits[MAX_PRIORITY + 1];           // indexed by clamped priority
+	std::vector<std::int64_t> agingSteps;            // per policy; [0] is the default
+	std::vector<PriorityBuckets> buckets;            // per policy
+	Slab<CaseRecord> records;                        // full pending cases; id 0 marks a released slot
+	StringArena arena;                               // long names and types
+	std::unordered_map<std::string, std::size_t> policyByType; // upper-cased type -> policy
 };
 
 
@@ -1,8 +1,16 @@
 #include "functionality.hpp"
 #include "PatientAdmission.hpp"
 #include "SupplyStack.hpp"
+#include "BulkImport.hpp"
+#include "CommandMode.hpp"
+#include "IpcServer.hpp"
+#include "HospitalState.hpp"
+#include "TableRenderer.hpp"
+#include "Metrics.hpp"
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <limits>
 
 // Forward declarations for other role modules
@@ -48,6 +56,7 @@ static void showMenu() {
 	std::cout << "1. Log Emergency Case\n";
 	std::cout << "2. Process Most Critical Case\n";
 	std::cout << "3. View Pending Emergency Cases\n";
+	std::cout << "4. View Wait-Time Statistics\n";
 	std::cout << "0. Exit\n";
 }
 
@@ -56,15 +65,18 @@ static void showMenu() {
  * Integrates the PatientQueue role with its own submenu.
  */
 int runPatientAdmissionClerk() {
-	PatientQueue queue;
+	PatientQueue &queue = HospitalState::instance().patients();
 	while (true) {
 		std::cout << "\n=== Patient Admission Clerk Menu ===\n";
 		std::cout << "1. Admit patient\n";
 		std::cout << "2. Discharge earliest admitted patient\n";
 		std::cout << "3. View patient queue\n";
+		std::cout << "4. Search discharge history\n";
+		std::cout << "5. Undo last change\n";
+		std::cout << "6. Redo undone change\n";
 		std::cout << "0. Return to central menu\n";
 
-		int choice = readIntInRange("Select an option: ", 0, 3);
+		int choice = readIntInRange("Select an option: ", 0, 6);
 		switch (choice) {
 			case 1: {
 				std::string id = readNonEmptyLine("Enter patient ID: ");
@@ -81,6 +93,26 @@ int runPatientAdmissionClerk() {
 				queue.viewPatientQueue();
 				break;
 			}
+			case 4: {
+				std::string condition;
+				std::cout << "Enter condition type (blank for all): ";
+				std::getline(std::cin, condition);
+				int days = readIntInRange("Search the last how many days (1-3650)? ", 1, 3650);
+				queue.viewDischargeHistory(PatientQueue::toUpperCase(PatientQueue::trim(condition)), days);
+				break;
+			}
+			case 5:
+			case 6: {
+				bool changed = (choice == 5) ? queue.undo() : queue.redo();
+				if (!changed) {
+					std::cout << (choice == 5 ? "Nothing to undo.\n" : "Nothing to redo.\n");
+					break;
+				}
+				queue.persistLater();
+				std::cout << (choice == 5 ? "Last change undone" : "Change redone")
+				          << " (" << queue.getSize() << " patient(s) in queue).\n";
+				break;
+			}
 			case 0:
 				std::cout << "Returning to central menu...\n";
 				return 0;
@@ -93,11 +125,11 @@ int runPatientAdmissionClerk() {
  * Integrates the SupplyStack role with its own submenu.
  */
 int runMedicalSupplyManager() {
-	SupplyStack stack;
-	const std::string csvFilename = "data/MedicalSupplies.csv";
+	SupplyStack &stack = HospitalState::instance().supplies();
+	const std::string csvFilename = SUPPLIES_FILENAME;
 
-	// Attempt to load existing supplies from CSV
-	if (stack.loadFromCsv(csvFilename)) {
+	// Supplies were loaded once by the state registry
+	if (HospitalState::instance().suppliesFileFound()) {
 		std::cout << "Loaded existing supplies from '" << csvFilename << "'.\n";
 	} else {
 		std::cout << "No existing supplies file found. Starting with empty inventory.\n";
@@ -107,9 +139,11 @@ int runMedicalSupplyManager() {
 		std::cout << "1. Add supply stock\n";
 		std::cout << "2. Use last added supply\n";
 		std::cout << "3. View current supplies\n";
+		std::cout << "4. Undo last change\n";
+		std::cout << "5. Redo undone change\n";
 		std::cout << "0. Return to central menu\n";
 
-		int choice = readIntInRange("Select an option: ", 0, 3);
+		int choice = readIntInRange("Select an option: ", 0, 5);
 		switch (choice) {
 			case 1: {
 				std::string type = readNonEmptyLine("Enter supply type: ");
@@ -117,7 +151,7 @@ int runMedicalSupplyManager() {
 				std::string batch = readNonEmptyLine("Enter batch identifier: ");
 				stack.addSupplyStock(type, quantity, batch);
 				std::cout << "Supply stock added.\n";
-				stack.saveToCsv(csvFilename);
+				stack.saveToCsvLater(csvFilename);
 				break;
 			}
 			case 2: {
@@ -128,7 +162,7 @@ int runMedicalSupplyManager() {
 					std::cout << "Using supply -> Type: " << used.type
 					          << " | Quantity: " << used.quantity
 					          << " | Batch: " << used.batch << "\n";
-					stack.saveToCsv(csvFilename);
+					stack.saveToCsvLater(csvFilename);
 				}
 				break;
 			}
@@ -136,6 +170,17 @@ int runMedicalSupplyManager() {
 				stack.viewCurrentSupplies();
 				break;
 			}
+			case 4:
+			case 5: {
+				bool changed = (choice == 4) ? stack.undo() : stack.redo();
+				if (!changed) {
+					std::cout << (choice == 4 ? "Nothing to undo.\n" : "Nothing to redo.\n");
+					break;
+				}
+				std::cout << (choice == 4 ? "Last change undone.\n" : "Change redone.\n");
+				stack.saveToCsvLater(csvFilename);
+				break;
+			}
 			case 0:
 				std::cout << "Returning to central menu...\n";
 				return 0;
@@ -147,15 +192,15 @@ int runMedicalSupplyManager() {
  * Runs the emergency department officer module.
  */
 int runEmergencyDepartmentOfficer() {
-	EmergencyDepartmentSystem system;
+	EmergencyDepartmentSystem &system = HospitalState::instance().emergencies();
 	while (true) {
 		showMenu();
-		int choice = readIntInRange("Select an option: ", 0, 3);
+		int choice = readIntInRange("Select an option: ", 0, 4);
 		switch (choice) {
 			case 1: {
 				std::string name = readNonEmptyLine("Enter patient name: ");
 				std::string type = readNonEmptyLine("Enter type of emergency: ");
-				int priority = readIntInRange("Enter priority (1=low, 5=critical): ", 1, 5);
+				int priority = readIntInRange("Enter priority (1=low, 5=critical): ", MIN_PRIORITY, MAX_PRIORITY);
 				system.logEmergencyCase(name, type, priority);
 				break;
 			}
@@ -165,6 +210,9 @@ int runEmergencyDepartmentOfficer() {
 			case 3:
 				system.viewPendingCases();
 				break;
+			case 4:
+				system.viewWaitTimeStats();
+				break;
 			case 0:
 				std::cout << "Goodbye!\n";
 				return 0;
@@ -184,10 +232,126 @@ static void showCentralMenu() {
 	std::cout << "0. Exit\n";
 }
 
-*/
+/**
+ * Prints the supported command line options.
+ */
+static void printUsage(const char *programName) {
+	std::cout << "Usage: " << programName << " [--import <file.csv>]... | --script <file|-> | --serve | --loadgen\n";
+	std::cout << "  --import <file.csv>  Bulk import patients or supplies (detected from the CSV header)\n";
+	std::cout << "  --script <file|->    Run line commands (ADMIT, DISCHARGE, HISTORY, ADD, USE, LOG, PROCESS,\n";
+	std::cout << "                       REGISTER, ROTATE, CREWS, ONDUTY, GAPS, SNAPSHOT, REPORT, UNDO,\n";
+	std::cout << "                       REDO, ASOF, SITE, SITES, SAVE, QUIT) from a file or stdin;\n";
+	std::cout << "                       \"@id command\" runs one command at site id (data/sites/<id>)\n";
+	std::cout << "  --limit N, --offset N  Page queue, supply, case and schedule listings\n";
+	std::cout << "  --undo-depth N       Changes each store can undo (default " << DEFAULT_UNDO_DEPTH << ", 0 = off)\n";
+	std::cout << "  --metrics-out <file> Write operation metrics at exit (.json for JSON, otherwise\n";
+	std::cout << "                       Prometheus text); METRICS / SIGUSR1 write it on demand\n";
+	std::cout << "  --serve [socket]     Serve the command protocol over a Unix domain socket\n";
+	std::cout << "  --loadgen [socket] [--clients N] [--requests N] [--pipeline N]\n";
+	std::cout << "                       Measure a running server's throughput and latency\n";
+	std::cout << "Without options the interactive central menu is started.\n";
+}
+
+/**
+ * Applies options that affect every mode (paging, metrics, undo) and removes
+ * them from args. Returns false on a malformed value.
+ */
+static bool applyGlobalOptions(std::vector<std::string> &args) {
+	std::vector<std::string> rest;
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		const std::string &arg = args[i];
+		bool takesValue = arg == "--limit" || arg == "--offset" || arg == "--metrics-out" || arg == "--undo-depth";
+		if (!takesValue) {
+			rest.push_back(arg);
+			continue;
+		}
+		if (i + 1 >= args.size()) return false;
+		const std::string &value = args[++i];
+		if (arg == "--metrics-out") {
+			setMetricsOutput(value);
+			continue;
+		}
+		try {
+			long long number = std::stoll(value);
+			if (number < 0) return false;
+			if (arg == "--undo-depth") {
+				HospitalState::instance().setUndoDepth(static_cast<std::size_t>(number));
+				continue;
+			}
+			(arg == "--limit" ? listingPage().limit : listingPage().offset) = static_cast<std::size_t>(number);
+		} catch (...) {
+			return false;
+		}
+	}
+	args.swap(rest);
+	return true;
+}
 
 // Integrated main() function with central menu
-int main() {
+int main(int argc, char *argv[]) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	if (!applyGlobalOptions(args)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	bool batchMode = false;
+	int exitCode = 0;
+	const int count = static_cast<int>(args.size());
+	for (int i = 0; i < count; ++i) {
+		const std::string &arg = args[i];
+		if (arg == "--import" && i + 1 < count) {
+			if (!batchMode) {
+				HospitalState::instance().setUndoDepth(0); // nothing to undo in a one-shot import
+			}
+			batchMode = true;
+			if (runBulkImport(args[++i]) != 0) exitCode = 1;
+		} else if (arg == "--script" && i + 1 < count && !batchMode) {
+			std::string source = args[++i];
+			if (source == "-") return runCommandMode(std::cin);
+			std::ifstream script(source);
+			if (!script) {
+				std::cout << "Error: Unable to open script '" << source << "'.\n";
+				return 1;
+			}
+			return runCommandMode(script);
+		} else if (arg == "--serve" && !batchMode) {
+			std::string socketPath = (i + 1 < count && args[i + 1][0] != '-') ? args[++i] : DEFAULT_SOCKET_PATH;
+			return runServer(socketPath);
+		} else if (arg == "--loadgen" && !batchMode) {
+			LoadGenOptions options;
+			if (i + 1 < count && args[i + 1][0] != '-') options.socketPath = args[++i];
+			while (i + 2 < count) {
+				const std::string &flag = args[i + 1];
+				int *target = (flag == "--clients") ? &options.clients
+				            : (flag == "--requests") ? &options.requestsPerClient
+				            : (flag == "--pipeline") ? &options.pipelineDepth : nullptr;
+				if (target == nullptr) break;
+				try {
+					*target = std::stoi(args[i + 2]);
+				} catch (...) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				i += 2;
+			}
+			if (i + 1 < count) {
+				printUsage(argv[0]);
+				return 1;
+			}
+			return runLoadGenerator(options);
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (batchMode) return exitCode;
+
+	// Load every store while the operator reads the menu; menu saves are
+	// written in the background so the operator never waits on the disk
+	HospitalState::instance().enableBackgroundWrites();
+	HospitalState::instance().preloadInBackground();
+
 	while (true) {
 		showCentralMenu();
 		int choice = readIntInRange("Select a module: ", 0, 4);
@@ -205,6 +369,7 @@ int main() {
 				runAmbulanceDispatcher();
 				break;
 			case 0:
+				HospitalState::instance().flushBackground(); // every save reaches the disk before exit
 				std::cout << "Exiting system. Goodbye!\n";
 				return 0;
 			default: